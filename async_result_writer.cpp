@@ -0,0 +1,167 @@
+#include "async_result_writer.h"
+
+/**
+ * Starts the writer thread.
+ *
+ * @param writeBatch - Writes a batch of window results, in window order.
+ *                     Called on the writer thread only.
+ * @param capacity - The number of windows that may be queued, rounded up
+ *                   to a power of two.
+ **/
+AsyncResultWriter::AsyncResultWriter(function<void(vector<BacktestWindowResults> &)> writeBatch, int capacity) : head(0), tail(0), isWriterWaiting(false), isProducerWaiting(false), isClosed(false)
+{
+    this->writeBatch = writeBatch;
+    this->numOfStalls = 0;
+
+    uint64_t numOfSlots = 1;
+
+    while (numOfSlots < capacity)
+    {
+        numOfSlots *= 2;
+    }
+
+    slots.resize(numOfSlots);
+    slotMask = numOfSlots - 1;
+
+    writer = thread(&AsyncResultWriter::runWriter, this);
+}
+
+/**
+ * Writes any queued results, then stops the writer thread.
+ **/
+AsyncResultWriter::~AsyncResultWriter()
+{
+    close();
+}
+
+/**
+ * Queues the results of the next window for writing, blocking while the
+ * queue is full. Must only be called from one thread.
+ *
+ * @param results - The window results, which are moved from.
+ **/
+void AsyncResultWriter::push(BacktestWindowResults &results)
+{
+    uint64_t nextTail = tail.load(memory_order_relaxed);
+
+    if (nextTail - head.load(memory_order_acquire) == slots.size())
+    {
+        numOfStalls++;
+        waitUntil(isProducerWaiting, spaceAvailable, [&]() { return nextTail - head.load() < slots.size(); });
+    }
+
+    slots[nextTail & slotMask] = move(results);
+    tail.store(nextTail + 1);
+
+    notify(isWriterWaiting, resultsAvailable);
+}
+
+/**
+ * Blocks until every queued result has been written, then stops the
+ * writer thread. No results may be pushed afterwards.
+ **/
+void AsyncResultWriter::close()
+{
+    if (!writer.joinable())
+    {
+        return;
+    }
+
+    isClosed.store(true);
+    notify(isWriterWaiting, resultsAvailable);
+
+    writer.join();
+}
+
+/**
+ * Returns the number of times `push` had to wait for the writer.
+ *
+ * @return The number of stalls.
+ **/
+long AsyncResultWriter::getNumOfStalls() const
+{
+    return numOfStalls;
+}
+
+/**
+ * The loop run by the writer thread.
+ **/
+void AsyncResultWriter::runWriter()
+{
+    vector<BacktestWindowResults> batch;
+
+    while (true)
+    {
+        uint64_t nextHead = head.load(memory_order_relaxed);
+        uint64_t endTail = tail.load(memory_order_acquire);
+
+        if (nextHead == endTail)
+        {
+            // Everything pushed before closing has been seen once the queue
+            // is found empty after the close.
+            if (isClosed.load() && tail.load() == nextHead)
+            {
+                return;
+            }
+
+            waitUntil(isWriterWaiting, resultsAvailable, [&]() { return tail.load() != nextHead || isClosed.load(); });
+            continue;
+        }
+
+        batch.clear();
+
+        for (; nextHead != endTail; nextHead++)
+        {
+            batch.push_back(move(slots[nextHead & slotMask]));
+        }
+
+        // The slots are free as soon as their results are moved out, so the
+        // producer can refill them while the batch is written.
+        head.store(nextHead);
+        notify(isProducerWaiting, spaceAvailable);
+
+        writeBatch(batch);
+    }
+}
+
+/**
+ * Blocks the calling thread until the given condition holds.
+ *
+ * @param isWaiting - The flag announcing that the thread is waiting.
+ * @param wake - The condition variable the thread is woken through.
+ * @param isReady - The condition.
+ **/
+void AsyncResultWriter::waitUntil(atomic<bool> &isWaiting, condition_variable &wake, function<bool()> isReady)
+{
+    // The flag is raised before the condition is rechecked, so the other
+    // thread either sees the flag and wakes this one, or its update is seen
+    // by the recheck.
+    isWaiting.store(true);
+
+    if (!isReady())
+    {
+        unique_lock<mutex> lock(wakeMutex);
+
+        while (!isReady())
+        {
+            wake.wait(lock);
+        }
+    }
+
+    isWaiting.store(false);
+}
+
+/**
+ * Wakes the other thread if it is waiting.
+ *
+ * @param isWaiting - The flag announcing that the other thread is waiting.
+ * @param wake - The condition variable the other thread is woken through.
+ **/
+void AsyncResultWriter::notify(atomic<bool> &isWaiting, condition_variable &wake)
+{
+    if (isWaiting.load())
+    {
+        lock_guard<mutex> lock(wakeMutex);
+        wake.notify_one();
+    }
+}
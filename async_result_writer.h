@@ -0,0 +1,128 @@
+#ifndef AsyncResultWriter_h
+#define AsyncResultWriter_h
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <stdint.h>
+#include <thread>
+#include <vector>
+#include "performance_metrics.h"
+#include "portfolio_optimisation_model.h"
+#include "walk_forward_schedule.h"
+
+using namespace std;
+
+/**
+ * The results of one window of a backtest, as handed to the writer.
+ **/
+struct BacktestWindowResults
+{
+    BacktestWindow window;
+    vector<PortfolioPerformance> performances;
+    vector<double> turnovers;
+    vector<vector<double> > weights;
+    vector<SolverStatistics> solverStatistics;
+
+    // Whether the results were restored from a checkpoint rather than computed.
+    bool isRestored;
+};
+
+/**
+ * Writes the results of backtest windows on a background thread, so that
+ * output overlaps with the computation of later windows.
+ *
+ * Results are passed from the backtest thread to the writer thread through a
+ * bounded, lock free, single producer single consumer ring buffer. The writer
+ * drains every queued window at once and hands them to `writeBatch` as one
+ * batch. When the ring is full the backtest thread blocks until the writer
+ * catches up, which bounds the memory held by results not yet written.
+ **/
+class AsyncResultWriter
+{
+public:
+    /**
+     * Starts the writer thread.
+     *
+     * @param writeBatch - Writes a batch of window results, in window order.
+     *                     Called on the writer thread only.
+     * @param capacity - The number of windows that may be queued, rounded up
+     *                   to a power of two.
+     **/
+    AsyncResultWriter(function<void(vector<BacktestWindowResults> &)> writeBatch, int capacity = 64);
+
+    /**
+     * Writes any queued results, then stops the writer thread.
+     **/
+    ~AsyncResultWriter();
+
+    /**
+     * Queues the results of the next window for writing, blocking while the
+     * queue is full. Must only be called from one thread.
+     *
+     * @param results - The window results, which are moved from.
+     **/
+    void push(BacktestWindowResults &results);
+
+    /**
+     * Blocks until every queued result has been written, then stops the
+     * writer thread. No results may be pushed afterwards.
+     **/
+    void close();
+
+    /**
+     * Returns the number of times `push` had to wait for the writer.
+     *
+     * @return The number of stalls.
+     **/
+    long getNumOfStalls() const;
+
+private:
+    function<void(vector<BacktestWindowResults> &)> writeBatch;
+
+    vector<BacktestWindowResults> slots;
+    uint64_t slotMask;
+
+    // The next slot to be read, owned by the writer, and the next slot to be
+    // written, owned by the producer, on separate cache lines.
+    alignas(64) atomic<uint64_t> head;
+    alignas(64) atomic<uint64_t> tail;
+
+    // Whether the writer is waiting for results, or the producer for space.
+    // A waiting thread sleeps on its condition variable, and the other thread
+    // only takes the mutex to wake it when the flag is set.
+    atomic<bool> isWriterWaiting;
+    atomic<bool> isProducerWaiting;
+    atomic<bool> isClosed;
+    mutex wakeMutex;
+    condition_variable resultsAvailable;
+    condition_variable spaceAvailable;
+
+    long numOfStalls;
+    thread writer;
+
+    /**
+     * The loop run by the writer thread.
+     **/
+    void runWriter();
+
+    /**
+     * Blocks the calling thread until the given condition holds.
+     *
+     * @param isWaiting - The flag announcing that the thread is waiting.
+     * @param wake - The condition variable the thread is woken through.
+     * @param isReady - The condition.
+     **/
+    void waitUntil(atomic<bool> &isWaiting, condition_variable &wake, function<bool()> isReady);
+
+    /**
+     * Wakes the other thread if it is waiting.
+     *
+     * @param isWaiting - The flag announcing that the other thread is waiting.
+     * @param wake - The condition variable the other thread is woken through.
+     **/
+    void notify(atomic<bool> &isWaiting, condition_variable &wake);
+};
+
+#endif
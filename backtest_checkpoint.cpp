@@ -0,0 +1,201 @@
+#include "backtest_checkpoint.h"
+
+// Identifies checkpoint files written by `BacktestCheckpoint`.
+static const char checkpointMagic[8] = {'B', 'T', 'S', 'T', 'C', 'K', 'P', 'T'};
+static const int checkpointVersion = 1;
+
+/**
+ * Opens the checkpoint file, loading the records of any earlier run.
+ * The file is created if it does not exist, unless it is opened read only.
+ *
+ * @param fileName - The name of the checkpoint file.
+ * @param fingerprint - A hash of the configuration and data of the backtest.
+ * @param isReadOnly - Whether the file is only read, e.g. to merge shards.
+ *                     The file must then exist, and may not be appended to.
+ **/
+BacktestCheckpoint::BacktestCheckpoint(const string &fileName, uint64_t fingerprint, bool isReadOnly)
+{
+    this->fileName = fileName;
+
+    long validLength = load(fingerprint);
+
+    if (isReadOnly)
+    {
+        if (validLength < 0)
+        {
+            cout << "Could not open " << fileName << " to read the checkpoint." << endl;
+            exit(EXIT_FAILURE);
+        }
+
+        return;
+    }
+
+    if (validLength < 0)
+    {
+        file.open(fileName.c_str(), ios::binary | ios::trunc);
+        file.write(checkpointMagic, sizeof(checkpointMagic));
+        file.write((const char *)&checkpointVersion, sizeof(checkpointVersion));
+        file.write((const char *)&fingerprint, sizeof(fingerprint));
+        file.flush();
+    }
+    else
+    {
+        // Drop any record left incomplete by a crash before appending.
+        if (truncate(fileName.c_str(), validLength) != 0)
+        {
+            cout << "Could not truncate " << fileName << " to its last complete record." << endl;
+            exit(EXIT_FAILURE);
+        }
+
+        file.open(fileName.c_str(), ios::binary | ios::app);
+    }
+
+    if (!file.is_open() || !file)
+    {
+        cout << "Could not open " << fileName << " to checkpoint the backtest." << endl;
+        exit(EXIT_FAILURE);
+    }
+}
+
+/**
+ * Returns the results recorded for the given task.
+ *
+ * @param taskIdx - The index of the task.
+ * @return The results, or NULL if the task has not been completed.
+ **/
+const vector<double> *BacktestCheckpoint::getRecord(int taskIdx) const
+{
+    map<int, vector<double> >::const_iterator it = records.find(taskIdx);
+
+    return it != records.end() ? &it->second : NULL;
+}
+
+/**
+ * Returns the number of completed tasks.
+ *
+ * @return The number of completed tasks.
+ **/
+int BacktestCheckpoint::getNumOfRecords() const
+{
+    return records.size();
+}
+
+/**
+ * Appends the results of a completed task to the file, and flushes
+ * them to disk. Safe to call concurrently from several threads.
+ *
+ * @param taskIdx - The index of the task.
+ * @param values - The results of the task.
+ **/
+void BacktestCheckpoint::append(int taskIdx, const vector<double> &values)
+{
+    int numOfValues = values.size();
+    uint64_t checksum = calculateChecksum(taskIdx, values);
+
+    lock_guard<mutex> lock(fileMutex);
+
+    if (!file.is_open())
+    {
+        cout << "The checkpoint file " << fileName << " is read only." << endl;
+        exit(EXIT_FAILURE);
+    }
+
+    file.write((const char *)&taskIdx, sizeof(taskIdx));
+    file.write((const char *)&numOfValues, sizeof(numOfValues));
+    file.write((const char *)values.data(), numOfValues * sizeof(double));
+    file.write((const char *)&checksum, sizeof(checksum));
+    file.flush();
+
+    if (!file)
+    {
+        cout << "Could not write to the checkpoint file " << fileName << "." << endl;
+        exit(EXIT_FAILURE);
+    }
+}
+
+/**
+ * Loads the records of an existing checkpoint file.
+ *
+ * @param fingerprint - The fingerprint the file must have been written with.
+ * @return The length of the file up to the end of its last valid record,
+ *         or -1 if the file does not exist.
+ **/
+long BacktestCheckpoint::load(uint64_t fingerprint)
+{
+    ifstream existingFile(fileName.c_str(), ios::binary);
+
+    if (!existingFile.is_open())
+    {
+        return -1;
+    }
+
+    char magic[sizeof(checkpointMagic)];
+    int version = 0;
+    uint64_t savedFingerprint = 0;
+
+    existingFile.read(magic, sizeof(magic));
+    existingFile.read((char *)&version, sizeof(version));
+    existingFile.read((char *)&savedFingerprint, sizeof(savedFingerprint));
+
+    if (!existingFile || !equal(magic, magic + sizeof(magic), checkpointMagic) || version != checkpointVersion)
+    {
+        cout << fileName << " is not a valid backtest checkpoint." << endl;
+        exit(EXIT_FAILURE);
+    }
+
+    if (savedFingerprint != fingerprint)
+    {
+        cout << fileName << " was checkpointed by a different backtest or data set. Delete it to start afresh." << endl;
+        exit(EXIT_FAILURE);
+    }
+
+    long validLength = existingFile.tellg();
+
+    existingFile.seekg(0, ios::end);
+    long fileLength = existingFile.tellg();
+    existingFile.seekg(validLength);
+
+    while (true)
+    {
+        int taskIdx = 0;
+        int numOfValues = 0;
+        uint64_t checksum = 0;
+
+        existingFile.read((char *)&taskIdx, sizeof(taskIdx));
+        existingFile.read((char *)&numOfValues, sizeof(numOfValues));
+
+        // A corrupt count could otherwise ask for more values than the file holds.
+        if (!existingFile || numOfValues < 0 || numOfValues > (fileLength - validLength) / (long)sizeof(double))
+        {
+            break;
+        }
+
+        vector<double> values(numOfValues);
+        existingFile.read((char *)values.data(), numOfValues * sizeof(double));
+        existingFile.read((char *)&checksum, sizeof(checksum));
+
+        if (!existingFile || checksum != calculateChecksum(taskIdx, values))
+        {
+            break;
+        }
+
+        records[taskIdx] = values;
+        validLength = existingFile.tellg();
+    }
+
+    return validLength;
+}
+
+/**
+ * Returns the checksum of a record.
+ *
+ * @param taskIdx - The index of the task.
+ * @param values - The results of the task.
+ * @return The checksum.
+ **/
+uint64_t BacktestCheckpoint::calculateChecksum(int taskIdx, const vector<double> &values)
+{
+    uint64_t checksum = calculateFnv1aHash(&taskIdx, sizeof(taskIdx));
+
+    return calculateFnv1aHash(values.data(), values.size() * sizeof(double), checksum);
+}
@@ -0,0 +1,93 @@
+#ifndef BacktestCheckpoint_h
+#define BacktestCheckpoint_h
+
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <unistd.h>
+#include <vector>
+#include "utils.h"
+
+using namespace std;
+
+/**
+ * An append only binary file of the completed tasks of a long running
+ * backtest, so that a run that is killed can be resumed without redoing
+ * them. Each record holds a task's index and its results as doubles,
+ * followed by a checksum; a record cut short by a crash is discarded on
+ * loading.
+ *
+ * The file starts with a fingerprint of the backtest configuration and
+ * data, and a checkpoint is only ever resumed by the same backtest.
+ **/
+class BacktestCheckpoint
+{
+public:
+    /**
+     * Opens the checkpoint file, loading the records of any earlier run.
+     * The file is created if it does not exist, unless it is opened read only.
+     *
+     * @param fileName - The name of the checkpoint file.
+     * @param fingerprint - A hash of the configuration and data of the backtest.
+     * @param isReadOnly - Whether the file is only read, e.g. to merge shards.
+     *                     The file must then exist, and may not be appended to.
+     **/
+    BacktestCheckpoint(const string &fileName, uint64_t fingerprint, bool isReadOnly = false);
+
+    /**
+     * Returns the results recorded for the given task.
+     *
+     * @param taskIdx - The index of the task.
+     * @return The results, or NULL if the task has not been completed.
+     **/
+    const vector<double> *getRecord(int taskIdx) const;
+
+    /**
+     * Returns the number of completed tasks.
+     *
+     * @return The number of completed tasks.
+     **/
+    int getNumOfRecords() const;
+
+    /**
+     * Appends the results of a completed task to the file, and flushes
+     * them to disk. Safe to call concurrently from several threads.
+     *
+     * @param taskIdx - The index of the task.
+     * @param values - The results of the task.
+     **/
+    void append(int taskIdx, const vector<double> &values);
+
+private:
+    string fileName;
+    ofstream file;
+    map<int, vector<double> > records;
+
+    // Serialises appends from several threads.
+    mutex fileMutex;
+
+    /**
+     * Loads the records of an existing checkpoint file.
+     *
+     * @param fingerprint - The fingerprint the file must have been written with.
+     * @return The length of the file up to the end of its last valid record,
+     *         or -1 if the file does not exist.
+     **/
+    long load(uint64_t fingerprint);
+
+    /**
+     * Returns the checksum of a record.
+     *
+     * @param taskIdx - The index of the task.
+     * @param values - The results of the task.
+     * @return The checksum.
+     **/
+    static uint64_t calculateChecksum(int taskIdx, const vector<double> &values);
+};
+
+#endif
@@ -0,0 +1,518 @@
+#include "backtest_sweep.h"
+
+/**
+ * Constructs a sweep.
+ *
+ * @param numOfThreads - The number of threads to run the sweep on. Above one, the
+ *                       model's `calculatePortfolioWeights` must be reentrant.
+ *                       Non-positive values mean one thread per hardware thread.
+ **/
+BacktestSweep::BacktestSweep(int numOfThreads)
+{
+    this->numOfThreads = ThreadPool::resolveNumOfThreads(numOfThreads);
+    this->shardIdx = 0;
+    this->numOfShards = 1;
+    this->evaluationReturnsPanel = NULL;
+}
+
+/**
+ * Checkpoints every completed in sample group to the given file. A later
+ * run of the same sweep on the same data skips the groups in the file. The
+ * shard files of a sharded sweep are named after the file, see
+ * `getShardFileName`, so that its shards resume too.
+ *
+ * @param fileName - The name of the checkpoint file.
+ **/
+void BacktestSweep::enableCheckpointing(const string &fileName)
+{
+    this->checkpointFileName = fileName;
+}
+
+/**
+ * Runs only one shard of the in sample groups, e.g. in one of several
+ * processes. The shard's groups are recorded to its shard file, which is
+ * also its checkpoint, instead of to the CSV file; `mergeShards` then
+ * combines the shard files.
+ *
+ * @param shardIdx - The index of the shard, in [0, numOfShards).
+ * @param numOfShards - The number of shards.
+ **/
+void BacktestSweep::enableSharding(int shardIdx, int numOfShards)
+{
+    this->shardIdx = shardIdx;
+    this->numOfShards = numOfShards;
+}
+
+/**
+ * Returns every combination of the given in sample sizes, out of sample
+ * sizes, step sizes and grids of target returns.
+ *
+ * @param inSampleSizes - The window sizes of the insample.
+ * @param outOfSampleSizes - The window sizes of the out of sample.
+ * @param stepSizes - The numbers of days between consecutive windows. Non-positive
+ *                    values mean the configuration's out of sample size.
+ * @param targetReturnGrids - The grids of target returns.
+ * @param scheme - How the in sample period moves between windows.
+ * @return The configurations.
+ **/
+vector<SweepConfig> BacktestSweep::createGrid(const vector<int> &inSampleSizes, const vector<int> &outOfSampleSizes, const vector<int> &stepSizes, const vector<vector<double> > &targetReturnGrids, WalkForwardScheme scheme)
+{
+    vector<SweepConfig> configs;
+
+    for (int i = 0; i < inSampleSizes.size(); i++)
+    {
+        for (int j = 0; j < outOfSampleSizes.size(); j++)
+        {
+            for (int k = 0; k < stepSizes.size(); k++)
+            {
+                for (int l = 0; l < targetReturnGrids.size(); l++)
+                {
+                    SweepConfig config;
+                    config.inSampleSize = inSampleSizes[i];
+                    config.outOfSampleSize = outOfSampleSizes[j];
+                    config.scheme = scheme;
+                    config.stepSize = stepSizes[k];
+                    config.targetReturns = targetReturnGrids[l];
+
+                    configs.push_back(config);
+                }
+            }
+        }
+    }
+
+    return configs;
+}
+
+/**
+ * Backtests the model under every configuration and writes one row per
+ * (configuration, window, target return) to the given CSV file.
+ *
+ * @param returnsMatrix - The matrix of returns.
+ * @param model - The portfolio optimisation model.
+ * @param configs - The configurations.
+ * @param fileName - The name of the CSV file.
+ **/
+void BacktestSweep::run(const ReturnsView &returnsMatrix, PortfolioOptimisationModel &model, const vector<SweepConfig> &configs, string fileName)
+{
+    cout << "Running backtest sweep over " << configs.size() << " configurations" << endl;
+
+    int numOfReturns = returnsMatrix.getNumOfReturns();
+
+    vector<InSampleGroup> groups = groupWindows(configs, numOfReturns);
+    vector<vector<PortfolioPerformance> > performances = allocatePerformances(configs, numOfReturns);
+
+    // A shard runs its own range of groups, always checkpointed to its shard file.
+    bool isShard = numOfShards > 1;
+    string recordFileName = isShard ? getShardFileName(shardIdx, numOfShards) : checkpointFileName;
+    int firstGroupIdx = 0;
+    int endGroupIdx = groups.size();
+
+    if (isShard)
+    {
+        getShardRange(groups.size(), shardIdx, numOfShards, firstGroupIdx, endGroupIdx);
+    }
+
+    BacktestCheckpoint *checkpoint = NULL;
+    vector<int> pendingGroupIdxs;
+
+    if (!recordFileName.empty())
+    {
+        checkpoint = new BacktestCheckpoint(recordFileName, calculateFingerprint(returnsMatrix, model, configs));
+    }
+
+    for (int i = firstGroupIdx; i < endGroupIdx; i++)
+    {
+        const vector<double> *record = checkpoint != NULL ? checkpoint->getRecord(i) : NULL;
+
+        if (record != NULL)
+        {
+            restoreGroupRecord(*record, configs, groups[i], performances);
+        }
+        else
+        {
+            pendingGroupIdxs.push_back(i);
+        }
+    }
+
+    if (pendingGroupIdxs.size() < endGroupIdx - firstGroupIdx)
+    {
+        cout << "Resuming sweep after " << endGroupIdx - firstGroupIdx - pendingGroupIdxs.size() << " checkpointed in sample periods" << endl;
+    }
+
+    // Every group is a task. Tasks write only the slots of their own windows,
+    // so the output does not depend on the number of threads.
+    function<void(int)> runGroup = [&](int i) {
+        const InSampleGroup &group = groups[pendingGroupIdxs[i]];
+
+        runInSampleGroup(returnsMatrix, model, configs, group, performances);
+
+        if (checkpoint != NULL)
+        {
+            checkpoint->append(pendingGroupIdxs[i], createGroupRecord(configs, group, performances));
+        }
+    };
+
+    if (numOfThreads > 1)
+    {
+        ThreadPool threadPool(numOfThreads);
+        threadPool.parallelFor(pendingGroupIdxs.size(), runGroup);
+    }
+    else
+    {
+        for (int i = 0; i < pendingGroupIdxs.size(); i++)
+        {
+            runGroup(i);
+        }
+    }
+
+    delete checkpoint;
+
+    if (isShard)
+    {
+        cout << "Recorded shard " << shardIdx << " of " << numOfShards << " to " << recordFileName << endl;
+        return;
+    }
+
+    writeToCsv(configs, numOfReturns, performances, fileName);
+}
+
+/**
+ * Backtests the model under every configuration on the given asset
+ * major or time major panel of returns, which is read in place, without
+ * a copy. The portfolios of a panel in `portfolioReturnSeriesLayout` are
+ * evaluated a day at a time, and those of any other an asset at a time.
+ *
+ * @param returnsPanel - The panel of returns.
+ * @param model - The portfolio optimisation model.
+ * @param configs - The configurations.
+ * @param fileName - The name of the CSV file.
+ **/
+void BacktestSweep::run(const ReturnsPanel &returnsPanel, PortfolioOptimisationModel &model, const vector<SweepConfig> &configs, string fileName)
+{
+    this->evaluationReturnsPanel = returnsPanel.getLayout() == portfolioReturnSeriesLayout ? &returnsPanel : NULL;
+    run(returnsPanel.getView(), model, configs, fileName);
+    this->evaluationReturnsPanel = NULL;
+}
+
+/**
+ * Combines the shard files written by the shards of a sweep into the CSV
+ * file that a single run of the sweep writes. The shard files are then
+ * deleted, unless they are checkpoints kept by request.
+ *
+ * @param returnsMatrix - The matrix of returns.
+ * @param model - The portfolio optimisation model that the shards ran.
+ * @param configs - The configurations.
+ * @param numOfShards - The number of shards.
+ * @param fileName - The name of the CSV file.
+ **/
+void BacktestSweep::mergeShards(const ReturnsView &returnsMatrix, const PortfolioOptimisationModel &model, const vector<SweepConfig> &configs, int numOfShards, string fileName)
+{
+    cout << "Merging " << numOfShards << " sweep shards" << endl;
+
+    int numOfReturns = returnsMatrix.getNumOfReturns();
+    uint64_t fingerprint = calculateFingerprint(returnsMatrix, model, configs);
+
+    vector<InSampleGroup> groups = groupWindows(configs, numOfReturns);
+    vector<vector<PortfolioPerformance> > performances = allocatePerformances(configs, numOfReturns);
+
+    for (int i = 0; i < numOfShards; i++)
+    {
+        int firstGroupIdx = 0;
+        int endGroupIdx = 0;
+        getShardRange(groups.size(), i, numOfShards, firstGroupIdx, endGroupIdx);
+
+        BacktestCheckpoint shard(getShardFileName(i, numOfShards), fingerprint, true);
+
+        for (int groupIdx = firstGroupIdx; groupIdx < endGroupIdx; groupIdx++)
+        {
+            const vector<double> *record = shard.getRecord(groupIdx);
+
+            if (record == NULL)
+            {
+                cout << "Shard " << i << " of " << numOfShards << " has not completed in sample period " << groupIdx << "." << endl;
+                exit(EXIT_FAILURE);
+            }
+
+            restoreGroupRecord(*record, configs, groups[groupIdx], performances);
+        }
+    }
+
+    writeToCsv(configs, numOfReturns, performances, fileName);
+
+    // Without checkpointing, the shard files were only the shards' output.
+    for (int i = 0; i < numOfShards && checkpointFileName.empty(); i++)
+    {
+        remove(getShardFileName(i, numOfShards).c_str());
+    }
+}
+
+/**
+ * Returns the name of the file that the given shard of a sweep records to:
+ * the checkpoint file's name with the shard appended, if checkpointing is
+ * enabled, or otherwise a name in the working directory.
+ *
+ * @param shardIdx - The index of the shard.
+ * @param numOfShards - The number of shards.
+ * @return The name of the shard file.
+ **/
+string BacktestSweep::getShardFileName(int shardIdx, int numOfShards) const
+{
+    if (!checkpointFileName.empty())
+    {
+        return checkpointFileName + ".shard_" + to_string(shardIdx) + "_of_" + to_string(numOfShards);
+    }
+
+    return "backtest_sweep_shard_" + to_string(shardIdx) + "_of_" + to_string(numOfShards) + ".ckpt";
+}
+
+/**
+ * Allocates the results of every configuration: a performance per (window,
+ * target return), indexed by windowIdx * no_of_target_returns + targetReturnIdx.
+ *
+ * @param configs - The configurations.
+ * @param numOfReturns - The number of returns in the data.
+ * @return The results, per configuration.
+ **/
+vector<vector<PortfolioPerformance> > BacktestSweep::allocatePerformances(const vector<SweepConfig> &configs, int numOfReturns)
+{
+    vector<vector<PortfolioPerformance> > performances(configs.size());
+
+    for (int configIdx = 0; configIdx < configs.size(); configIdx++)
+    {
+        const SweepConfig &config = configs[configIdx];
+        WalkForwardSchedule schedule(numOfReturns, config.inSampleSize, config.outOfSampleSize, config.scheme, config.stepSize);
+
+        performances[configIdx].resize(schedule.getNumOfWindows() * config.targetReturns.size());
+    }
+
+    return performances;
+}
+
+/**
+ * Groups the windows of every configuration by their in sample period.
+ *
+ * @param configs - The configurations.
+ * @param numOfReturns - The number of returns in the data.
+ * @return The groups, ordered by in sample period.
+ **/
+vector<BacktestSweep::InSampleGroup> BacktestSweep::groupWindows(const vector<SweepConfig> &configs, int numOfReturns)
+{
+    map<pair<int, int>, InSampleGroup> groupsByInSample;
+
+    for (int configIdx = 0; configIdx < configs.size(); configIdx++)
+    {
+        const SweepConfig &config = configs[configIdx];
+        WalkForwardSchedule schedule(numOfReturns, config.inSampleSize, config.outOfSampleSize, config.scheme, config.stepSize);
+
+        SweepWindow sweepWindow;
+        sweepWindow.configIdx = configIdx;
+
+        while (schedule.next(sweepWindow.window))
+        {
+            InSampleGroup &group = groupsByInSample[make_pair(sweepWindow.window.firstInSampleDay, sweepWindow.window.lastInSampleDay)];
+            group.firstInSampleDay = sweepWindow.window.firstInSampleDay;
+            group.lastInSampleDay = sweepWindow.window.lastInSampleDay;
+            group.windows.push_back(sweepWindow);
+            group.targetReturns.insert(group.targetReturns.end(), config.targetReturns.begin(), config.targetReturns.end());
+        }
+    }
+
+    vector<InSampleGroup> groups;
+
+    for (map<pair<int, int>, InSampleGroup>::iterator it = groupsByInSample.begin(); it != groupsByInSample.end(); ++it)
+    {
+        // Each distinct target return is solved for once per group.
+        vector<double> &targetReturns = it->second.targetReturns;
+        sort(targetReturns.begin(), targetReturns.end());
+        targetReturns.erase(unique(targetReturns.begin(), targetReturns.end()), targetReturns.end());
+
+        groups.push_back(it->second);
+    }
+
+    return groups;
+}
+
+/**
+ * Optimises the portfolios of one in sample group and evaluates every
+ * window of the group out of sample.
+ *
+ * @param returnsMatrix - The matrix of returns.
+ * @param model - The portfolio optimisation model.
+ * @param configs - The configurations.
+ * @param group - The in sample group.
+ * @param performances - Per configuration, the performance of each (window, target
+ *                       return), populated for the windows of the group.
+ **/
+void BacktestSweep::runInSampleGroup(const ReturnsView &returnsMatrix, PortfolioOptimisationModel &model, const vector<SweepConfig> &configs, const InSampleGroup &group, vector<vector<PortfolioPerformance> > &performances)
+{
+    vector<vector<double> > groupWeights = model.calculatePortfolioWeights(returnsMatrix, group.firstInSampleDay, group.lastInSampleDay, group.targetReturns);
+
+    for (int i = 0; i < group.windows.size(); i++)
+    {
+        const SweepWindow &sweepWindow = group.windows[i];
+        const vector<double> &targetReturns = configs[sweepWindow.configIdx].targetReturns;
+        int numOfTargetReturns = targetReturns.size();
+
+        // Pick out the configuration's portfolios from those of the group.
+        vector<vector<double> > weights(numOfTargetReturns);
+
+        for (int targetReturnIdx = 0; targetReturnIdx < numOfTargetReturns; targetReturnIdx++)
+        {
+            int groupTargetReturnIdx = lower_bound(group.targetReturns.begin(), group.targetReturns.end(), targetReturns[targetReturnIdx]) - group.targetReturns.begin();
+            weights[targetReturnIdx] = groupWeights[groupTargetReturnIdx];
+        }
+
+        vector<vector<double> > portfolioReturns;
+
+        if (evaluationReturnsPanel != NULL)
+        {
+            portfolioReturns = calculatePortfolioReturnSeries(*evaluationReturnsPanel, sweepWindow.window.firstOutOfSampleDay, sweepWindow.window.lastOutOfSampleDay, weights);
+        }
+        else
+        {
+            portfolioReturns = calculatePortfolioReturnSeries(returnsMatrix, sweepWindow.window.firstOutOfSampleDay, sweepWindow.window.lastOutOfSampleDay, weights);
+        }
+
+        vector<PortfolioPerformance> windowPerformances = evaluatePortfolioReturnSeries(portfolioReturns, riskFreeRate);
+
+        copy(windowPerformances.begin(), windowPerformances.end(), performances[sweepWindow.configIdx].begin() + sweepWindow.window.windowIdx * numOfTargetReturns);
+    }
+}
+
+/**
+ * Packs the results of an in sample group into a checkpoint record: the
+ * performance of each target return of each window of the group, in order.
+ *
+ * @param configs - The configurations.
+ * @param group - The in sample group.
+ * @param performances - Per configuration, the performance of each (window, target return).
+ * @return The record.
+ **/
+vector<double> BacktestSweep::createGroupRecord(const vector<SweepConfig> &configs, const InSampleGroup &group, const vector<vector<PortfolioPerformance> > &performances)
+{
+    vector<double> record;
+
+    for (int i = 0; i < group.windows.size(); i++)
+    {
+        const SweepWindow &sweepWindow = group.windows[i];
+        int numOfTargetReturns = configs[sweepWindow.configIdx].targetReturns.size();
+        const PortfolioPerformance *windowPerformances = &performances[sweepWindow.configIdx][sweepWindow.window.windowIdx * numOfTargetReturns];
+
+        for (int targetReturnIdx = 0; targetReturnIdx < numOfTargetReturns; targetReturnIdx++)
+        {
+            record.push_back(windowPerformances[targetReturnIdx].meanReturn);
+            record.push_back(windowPerformances[targetReturnIdx].standardDeviation);
+            record.push_back(windowPerformances[targetReturnIdx].sharpeRatio);
+            record.push_back(windowPerformances[targetReturnIdx].maxDrawdown);
+        }
+    }
+
+    return record;
+}
+
+/**
+ * Unpacks the results of an in sample group from a checkpoint record.
+ *
+ * @param record - The record.
+ * @param configs - The configurations.
+ * @param group - The in sample group.
+ * @param performances - Per configuration, the performance of each (window, target
+ *                       return), populated for the windows of the group.
+ **/
+void BacktestSweep::restoreGroupRecord(const vector<double> &record, const vector<SweepConfig> &configs, const InSampleGroup &group, vector<vector<PortfolioPerformance> > &performances)
+{
+    int recordIdx = 0;
+
+    for (int i = 0; i < group.windows.size(); i++)
+    {
+        const SweepWindow &sweepWindow = group.windows[i];
+        int numOfTargetReturns = configs[sweepWindow.configIdx].targetReturns.size();
+        PortfolioPerformance *windowPerformances = &performances[sweepWindow.configIdx][sweepWindow.window.windowIdx * numOfTargetReturns];
+
+        for (int targetReturnIdx = 0; targetReturnIdx < numOfTargetReturns; targetReturnIdx++)
+        {
+            if (recordIdx + 4 > record.size())
+            {
+                cout << "Checkpoint record does not match the in sample periods of the sweep." << endl;
+                exit(EXIT_FAILURE);
+            }
+
+            windowPerformances[targetReturnIdx].meanReturn = record[recordIdx++];
+            windowPerformances[targetReturnIdx].standardDeviation = record[recordIdx++];
+            windowPerformances[targetReturnIdx].sharpeRatio = record[recordIdx++];
+            windowPerformances[targetReturnIdx].maxDrawdown = record[recordIdx++];
+        }
+    }
+}
+
+/**
+ * Returns a fingerprint of the configurations and the data, which identifies
+ * the sweep that wrote a checkpoint.
+ *
+ * @param returnsMatrix - The matrix of returns.
+ * @param model - The portfolio optimisation model.
+ * @param configs - The configurations.
+ * @return The fingerprint.
+ **/
+uint64_t BacktestSweep::calculateFingerprint(const ReturnsView &returnsMatrix, const PortfolioOptimisationModel &model, const vector<SweepConfig> &configs)
+{
+    // A checkpoint is only resumed by the same model with the same parameters.
+    const char *modelTypeName = typeid(model).name();
+
+    uint64_t fingerprint = model.hashParameters(calculateFnv1aHash(modelTypeName, strlen(modelTypeName)));
+    fingerprint = calculateFnv1aHash(returnsMatrix, fingerprint);
+
+    for (int configIdx = 0; configIdx < configs.size(); configIdx++)
+    {
+        const SweepConfig &config = configs[configIdx];
+        int parameters[] = {config.inSampleSize, config.outOfSampleSize, config.scheme, config.stepSize};
+
+        fingerprint = calculateFnv1aHash(parameters, sizeof(parameters), fingerprint);
+        fingerprint = calculateFnv1aHash(config.targetReturns.data(), config.targetReturns.size() * sizeof(double), fingerprint);
+    }
+
+    return fingerprint;
+}
+
+/**
+ * Writes the results of the sweep to CSV corresponding to the given filename.
+ *
+ * @param configs - The configurations.
+ * @param numOfReturns - The number of returns in the data.
+ * @param performances - Per configuration, the performance of each (window, target return).
+ * @param fileName - The name of the CSV file.
+ **/
+void BacktestSweep::writeToCsv(const vector<SweepConfig> &configs, int numOfReturns, const vector<vector<PortfolioPerformance> > &performances, string fileName)
+{
+    const char *schemeNames[] = {"Rolling", "Expanding", "Anchored"};
+
+    ofstream resultsFile;
+    resultsFile.open(fileName);
+    resultsFile << "Config,In Sample Size,Out Of Sample Size,Scheme,Step Size,Window,First Out Of Sample Day,Target Return,Mean Return,Standard Deviation,Sharpe Ratio,Max Drawdown" << "\n";
+
+    for (int configIdx = 0; configIdx < configs.size(); configIdx++)
+    {
+        const SweepConfig &config = configs[configIdx];
+        WalkForwardSchedule schedule(numOfReturns, config.inSampleSize, config.outOfSampleSize, config.scheme, config.stepSize);
+        int numOfTargetReturns = config.targetReturns.size();
+        int stepSize = config.stepSize > 0 ? config.stepSize : config.outOfSampleSize;
+
+        BacktestWindow window;
+
+        while (schedule.next(window))
+        {
+            for (int targetReturnIdx = 0; targetReturnIdx < numOfTargetReturns; targetReturnIdx++)
+            {
+                const PortfolioPerformance &performance = performances[configIdx][window.windowIdx * numOfTargetReturns + targetReturnIdx];
+
+                resultsFile << configIdx << "," << config.inSampleSize << "," << config.outOfSampleSize << ","
+                            << schemeNames[config.scheme] << "," << stepSize << "," << window.windowIdx + 1 << ","
+                            << window.firstOutOfSampleDay << "," << config.targetReturns[targetReturnIdx] << ","
+                            << performance.meanReturn << "," << performance.standardDeviation << ","
+                            << performance.sharpeRatio << "," << performance.maxDrawdown << "\n";
+            }
+        }
+    }
+
+    resultsFile.close();
+}
@@ -0,0 +1,258 @@
+#ifndef BacktestSweep_h
+#define BacktestSweep_h
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <typeinfo>
+#include <utility>
+#include <vector>
+#include "backtest_checkpoint.h"
+#include "performance_metrics.h"
+#include "portfolio_optimisation_model.h"
+#include "thread_pool.h"
+#include "utils.h"
+#include "walk_forward_schedule.h"
+
+using namespace std;
+
+/**
+ * One configuration of a walk forward backtest within a sweep.
+ **/
+struct SweepConfig
+{
+    int inSampleSize;
+    int outOfSampleSize;
+    WalkForwardScheme scheme;
+
+    // Non-positive values mean `outOfSampleSize`.
+    int stepSize;
+
+    vector<double> targetReturns;
+};
+
+/**
+ * Runs the walk forward backtests of many configurations together, as one
+ * set of tasks on a shared thread pool. Windows of any configurations that
+ * share an in sample period are optimised together, so the sample statistics
+ * of that period are estimated once, and every distinct target return is
+ * solved for once. All results go to a single CSV file.
+ *
+ * Completed in sample periods can be checkpointed, so that a killed sweep
+ * resumes where it left off, and the groups can be split into shards run
+ * by separate processes.
+ **/
+class BacktestSweep
+{
+public:
+    /**
+     * Constructs a sweep.
+     *
+     * @param numOfThreads - The number of threads to run the sweep on. Above one, the
+     *                       model's `calculatePortfolioWeights` must be reentrant.
+     *                       Non-positive values mean one thread per hardware thread.
+     **/
+    BacktestSweep(int numOfThreads = 0);
+
+    /**
+     * Returns every combination of the given in sample sizes, out of sample
+     * sizes, step sizes and grids of target returns.
+     *
+     * @param inSampleSizes - The window sizes of the insample.
+     * @param outOfSampleSizes - The window sizes of the out of sample.
+     * @param stepSizes - The numbers of days between consecutive windows. Non-positive
+     *                    values mean the configuration's out of sample size.
+     * @param targetReturnGrids - The grids of target returns.
+     * @param scheme - How the in sample period moves between windows.
+     * @return The configurations.
+     **/
+    static vector<SweepConfig> createGrid(const vector<int> &inSampleSizes, const vector<int> &outOfSampleSizes, const vector<int> &stepSizes, const vector<vector<double> > &targetReturnGrids, WalkForwardScheme scheme = ROLLING);
+
+    /**
+     * Checkpoints every completed in sample group to the given file. A later
+     * run of the same sweep on the same data skips the groups in the file. The
+     * shard files of a sharded sweep are named after the file, see
+     * `getShardFileName`, so that its shards resume too.
+     *
+     * @param fileName - The name of the checkpoint file.
+     **/
+    void enableCheckpointing(const string &fileName);
+
+    /**
+     * Runs only one shard of the in sample groups, e.g. in one of several
+     * processes. The shard's groups are recorded to its shard file, which is
+     * also its checkpoint, instead of to the CSV file; `mergeShards` then
+     * combines the shard files.
+     *
+     * @param shardIdx - The index of the shard, in [0, numOfShards).
+     * @param numOfShards - The number of shards.
+     **/
+    void enableSharding(int shardIdx, int numOfShards);
+
+    /**
+     * Backtests the model under every configuration and writes one row per
+     * (configuration, window, target return) to the given CSV file.
+     *
+     * @param returnsMatrix - The matrix of returns.
+     * @param model - The portfolio optimisation model.
+     * @param configs - The configurations.
+     * @param fileName - The name of the CSV file.
+     **/
+    void run(const ReturnsView &returnsMatrix, PortfolioOptimisationModel &model, const vector<SweepConfig> &configs, string fileName);
+
+    /**
+     * Backtests the model under every configuration on the given asset
+     * major or time major panel of returns, which is read in place, without
+     * a copy. The portfolios of a panel in `portfolioReturnSeriesLayout` are
+     * evaluated a day at a time, and those of any other an asset at a time.
+     *
+     * @param returnsPanel - The panel of returns.
+     * @param model - The portfolio optimisation model.
+     * @param configs - The configurations.
+     * @param fileName - The name of the CSV file.
+     **/
+    void run(const ReturnsPanel &returnsPanel, PortfolioOptimisationModel &model, const vector<SweepConfig> &configs, string fileName);
+
+    /**
+     * Combines the shard files written by the shards of a sweep into the CSV
+     * file that a single run of the sweep writes. The shard files are then
+     * deleted, unless they are checkpoints kept by request.
+     *
+     * @param returnsMatrix - The matrix of returns.
+     * @param model - The portfolio optimisation model that the shards ran.
+     * @param configs - The configurations.
+     * @param numOfShards - The number of shards.
+     * @param fileName - The name of the CSV file.
+     **/
+    void mergeShards(const ReturnsView &returnsMatrix, const PortfolioOptimisationModel &model, const vector<SweepConfig> &configs, int numOfShards, string fileName);
+
+    /**
+     * Returns the name of the file that the given shard of a sweep records to:
+     * the checkpoint file's name with the shard appended, if checkpointing is
+     * enabled, or otherwise a name in the working directory.
+     *
+     * @param shardIdx - The index of the shard.
+     * @param numOfShards - The number of shards.
+     * @return The name of the shard file.
+     **/
+    string getShardFileName(int shardIdx, int numOfShards) const;
+
+private:
+    // A window of one configuration.
+    struct SweepWindow
+    {
+        int configIdx;
+        BacktestWindow window;
+    };
+
+    // The windows, across all configurations, that share an in sample period,
+    // and the union of their target returns.
+    struct InSampleGroup
+    {
+        int firstInSampleDay;
+        int lastInSampleDay;
+        vector<SweepWindow> windows;
+        vector<double> targetReturns;
+    };
+
+    // The number of threads to run the sweep on.
+    int numOfThreads;
+
+    // The checkpoint file, if checkpointing is enabled.
+    string checkpointFileName;
+
+    // The shard of the in sample groups to run, when split over several processes.
+    int shardIdx;
+    int numOfShards;
+
+    // The returns to evaluate portfolios on, in `portfolioReturnSeriesLayout`,
+    // or NULL to evaluate them on the matrix of returns.
+    const ReturnsPanel *evaluationReturnsPanel;
+
+    // The risk free rate used to calculate sharpe ratios.
+    // Sources from UK risk free rate data between 2015 and 2019.
+    const double riskFreeRate = 0.021;
+
+    /**
+     * Groups the windows of every configuration by their in sample period.
+     *
+     * @param configs - The configurations.
+     * @param numOfReturns - The number of returns in the data.
+     * @return The groups, ordered by in sample period.
+     **/
+    vector<InSampleGroup> groupWindows(const vector<SweepConfig> &configs, int numOfReturns);
+
+    /**
+     * Allocates the results of every configuration: a performance per (window,
+     * target return), indexed by windowIdx * no_of_target_returns + targetReturnIdx.
+     *
+     * @param configs - The configurations.
+     * @param numOfReturns - The number of returns in the data.
+     * @return The results, per configuration.
+     **/
+    vector<vector<PortfolioPerformance> > allocatePerformances(const vector<SweepConfig> &configs, int numOfReturns);
+
+    /**
+     * Optimises the portfolios of one in sample group and evaluates every
+     * window of the group out of sample.
+     *
+     * @param returnsMatrix - The matrix of returns.
+     * @param model - The portfolio optimisation model.
+     * @param configs - The configurations.
+     * @param group - The in sample group.
+     * @param performances - Per configuration, the performance of each (window, target
+     *                       return), populated for the windows of the group.
+     **/
+    void runInSampleGroup(const ReturnsView &returnsMatrix, PortfolioOptimisationModel &model, const vector<SweepConfig> &configs, const InSampleGroup &group, vector<vector<PortfolioPerformance> > &performances);
+
+    /**
+     * Packs the results of an in sample group into a checkpoint record: the
+     * performance of each target return of each window of the group, in order.
+     *
+     * @param configs - The configurations.
+     * @param group - The in sample group.
+     * @param performances - Per configuration, the performance of each (window, target return).
+     * @return The record.
+     **/
+    vector<double> createGroupRecord(const vector<SweepConfig> &configs, const InSampleGroup &group, const vector<vector<PortfolioPerformance> > &performances);
+
+    /**
+     * Unpacks the results of an in sample group from a checkpoint record.
+     *
+     * @param record - The record.
+     * @param configs - The configurations.
+     * @param group - The in sample group.
+     * @param performances - Per configuration, the performance of each (window, target
+     *                       return), populated for the windows of the group.
+     **/
+    void restoreGroupRecord(const vector<double> &record, const vector<SweepConfig> &configs, const InSampleGroup &group, vector<vector<PortfolioPerformance> > &performances);
+
+    /**
+     * Returns a fingerprint of the configurations and the data, which identifies
+     * the sweep that wrote a checkpoint.
+     *
+     * @param returnsMatrix - The matrix of returns.
+     * @param model - The portfolio optimisation model.
+     * @param configs - The configurations.
+     * @return The fingerprint.
+     **/
+    uint64_t calculateFingerprint(const ReturnsView &returnsMatrix, const PortfolioOptimisationModel &model, const vector<SweepConfig> &configs);
+
+    /**
+     * Writes the results of the sweep to CSV corresponding to the given filename.
+     *
+     * @param configs - The configurations.
+     * @param numOfReturns - The number of returns in the data.
+     * @param performances - Per configuration, the performance of each (window, target return).
+     * @param fileName - The name of the CSV file.
+     **/
+    void writeToCsv(const vector<SweepConfig> &configs, int numOfReturns, const vector<vector<PortfolioPerformance> > &performances, string fileName);
+};
+
+#endif
@@ -21,7 +21,7 @@ public:
      * @param inSampleSize - The window size of the insample.
      * @param outOfSampleSize - The window size of the out of sample.
      **/
-    virtual void evaluatePerformance(const vector<vector<double> > &returnsMatrix, PortfolioOptimisationModel &model, int inSampleSize, int outOfSampleSize) = 0;
+    virtual void evaluatePerformance(const ReturnsView &returnsMatrix, PortfolioOptimisationModel &model, int inSampleSize, int outOfSampleSize) = 0;
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,436 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <new>
+#include <sstream>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <vector>
+#include "markowitz_model.h"
+#include "matrix.h"
+#include "random_stream.h"
+#include "utils.h"
+
+using namespace std;
+
+/**
+ * Micro-benchmarks of the matrix, estimator and solver kernels, swept over
+ * numbers of assets and window lengths, reported as JSON.
+ *
+ * Each benchmark is warmed up, then repeated until it has run for a minimum
+ * time. Its floating point operations and the bytes it must read and write
+ * are counted analytically, and its heap allocations are counted by the
+ * replacement operators new and new[] below.
+ *
+ * Usage: benchmark [--assets n,...] [--windows n,...] [--min-time seconds]
+ *                  [--max-flop n] [--output file]
+ **/
+
+static atomic<uint64_t> numOfAllocations(0);
+static atomic<uint64_t> numOfAllocatedBytes(0);
+
+void *operator new(size_t size)
+{
+    numOfAllocations++;
+    numOfAllocatedBytes += size;
+
+    void *memory = malloc(size == 0 ? 1 : size);
+
+    if (memory == NULL)
+    {
+        throw bad_alloc();
+    }
+
+    return memory;
+}
+
+void *operator new[](size_t size)
+{
+    return operator new(size);
+}
+
+// Not inlined into the callers of delete, where the compiler would pair the
+// free with their new rather than with the malloc above, and warn.
+__attribute__((noinline)) void operator delete(void *memory) noexcept
+{
+    free(memory);
+}
+
+void operator delete(void *memory, size_t) noexcept
+{
+    operator delete(memory);
+}
+
+void operator delete[](void *memory) noexcept
+{
+    operator delete(memory);
+}
+
+void operator delete[](void *memory, size_t) noexcept
+{
+    operator delete(memory);
+}
+
+// Consumes the results of the kernels, so that they cannot be optimised away.
+static volatile double resultSink = 0;
+
+/**
+ * The measurements of one kernel on one problem size.
+ **/
+struct BenchmarkResult
+{
+    string kernel;
+    int numOfAssets;
+
+    // The number of days in the window, or 0 if the kernel has none.
+    int windowSize;
+
+    int numOfRepetitions;
+    double medianNanoseconds;
+    double minNanoseconds;
+
+    double flopPerOp;
+    double bytesPerOp;
+    double allocationsPerOp;
+    double allocatedBytesPerOp;
+
+    // The iterations of the conjugate gradient method, or -1 if the kernel does not solve.
+    int numOfSolverIterations;
+
+    // Whether the solve stopped at the model's iteration limit before converging.
+    bool hasReachedIterationLimit;
+
+    // Why the kernel was not run, or empty if it was.
+    string skippedReason;
+};
+
+/**
+ * Parses a comma separated list of positive integers.
+ *
+ * @param list - The list.
+ * @return The integers, or none if any is not positive.
+ **/
+vector<int> parseSizes(const string &list)
+{
+    vector<int> sizes;
+    stringstream stream(list);
+    string size;
+
+    while (getline(stream, size, ','))
+    {
+        int value = atoi(size.c_str());
+
+        if (value < 1)
+        {
+            return vector<int>();
+        }
+
+        sizes.push_back(value);
+    }
+
+    return sizes;
+}
+
+/**
+ * Returns a matrix of reproducible pseudo random values, uniform in
+ * [-0.05, 0.05) plus a small drift per row, like daily returns.
+ *
+ * @param numOfRows - The number of rows, e.g. assets.
+ * @param numOfColumns - The number of columns, e.g. days.
+ * @return The matrix.
+ **/
+vector<vector<double> > createRandomMatrix(int numOfRows, int numOfColumns)
+{
+    vector<vector<double> > matrix(numOfRows, vector<double>(numOfColumns));
+
+    for (int i = 0; i < numOfRows; i++)
+    {
+        RandomStream stream(42, i);
+        double drift = 0.001 * (i % 10);
+
+        for (int j = 0; j < numOfColumns; j++)
+        {
+            matrix[i][j] = drift + 0.1 * (stream.nextUniform() - 0.5);
+        }
+    }
+
+    return matrix;
+}
+
+/**
+ * Times a kernel: runs it once to warm up and once to count its allocations,
+ * then repeatedly until it has run for at least `minSeconds` and at least
+ * three times, or once if a single run takes longer than `minSeconds`.
+ *
+ * @param kernel - The kernel, which returns a value derived from its result.
+ * @param minSeconds - The minimum time to repeat the kernel for.
+ * @param result - Populated with the repetitions, times and allocations.
+ **/
+void timeKernel(const function<double()> &kernel, double minSeconds, BenchmarkResult &result)
+{
+    resultSink = resultSink + kernel();
+
+    // The allocations are counted over one run, apart from the timed runs,
+    // whose times are themselves allocated.
+    uint64_t firstNumOfAllocations = numOfAllocations;
+    uint64_t firstNumOfAllocatedBytes = numOfAllocatedBytes;
+
+    resultSink = resultSink + kernel();
+
+    result.allocationsPerOp = numOfAllocations - firstNumOfAllocations;
+    result.allocatedBytesPerOp = numOfAllocatedBytes - firstNumOfAllocatedBytes;
+
+    vector<double> nanoseconds;
+    double totalSeconds = 0;
+
+    // A kernel slower than the minimum time is only run once.
+    do
+    {
+        chrono::steady_clock::time_point startTime = chrono::steady_clock::now();
+        resultSink = resultSink + kernel();
+        double elapsedNanoseconds = chrono::duration<double, nano>(chrono::steady_clock::now() - startTime).count();
+
+        nanoseconds.push_back(elapsedNanoseconds);
+        totalSeconds += elapsedNanoseconds * 1e-9;
+    }
+    while (nanoseconds[0] * 1e-9 < minSeconds && (totalSeconds < minSeconds || nanoseconds.size() < 3));
+
+    result.numOfRepetitions = nanoseconds.size();
+
+    sort(nanoseconds.begin(), nanoseconds.end());
+    result.medianNanoseconds = nanoseconds[nanoseconds.size() / 2];
+    result.minNanoseconds = nanoseconds[0];
+}
+
+/**
+ * Runs a kernel unless it would take more than `maxFlop` floating point
+ * operations, and records its result.
+ *
+ * @param kernelName - The name of the kernel.
+ * @param numOfAssets - The number of assets.
+ * @param windowSize - The number of days in the window, or 0 if the kernel has none.
+ * @param flopPerOp - The floating point operations of one run.
+ * @param bytesPerOp - The bytes that one run must read and write.
+ * @param kernel - The kernel.
+ * @param minSeconds - The minimum time to repeat the kernel for.
+ * @param maxFlop - The most floating point operations a run may take.
+ * @param results - The results, which the kernel's result is appended to.
+ **/
+void runKernel(const string &kernelName, int numOfAssets, int windowSize, double flopPerOp, double bytesPerOp, const function<double()> &kernel, double minSeconds, double maxFlop, vector<BenchmarkResult> &results)
+{
+    BenchmarkResult result = {kernelName, numOfAssets, windowSize, 0, 0, 0, flopPerOp, bytesPerOp, 0, 0, -1, false, ""};
+
+    cerr << kernelName << " assets=" << numOfAssets << " window=" << windowSize << endl;
+
+    if (flopPerOp > maxFlop)
+    {
+        result.skippedReason = "more than --max-flop floating point operations";
+    }
+    else
+    {
+        timeKernel(kernel, minSeconds, result);
+    }
+
+    results.push_back(result);
+}
+
+/**
+ * Writes the results as JSON.
+ *
+ * @param results - The results.
+ * @param minSeconds - The minimum time each kernel was repeated for.
+ * @param output - The stream to write to.
+ **/
+void writeJson(const vector<BenchmarkResult> &results, double minSeconds, ostream &output)
+{
+#ifdef __OPTIMIZE__
+    bool isOptimised = true;
+#else
+    bool isOptimised = false;
+#endif
+
+    output.precision(6);
+    output << "{\n";
+    output << "  \"optimised\": " << (isOptimised ? "true" : "false") << ",\n";
+    output << "  \"min_time_seconds\": " << minSeconds << ",\n";
+    output << "  \"results\": [";
+
+    for (int i = 0; i < results.size(); i++)
+    {
+        const BenchmarkResult &result = results[i];
+
+        output << (i == 0 ? "\n" : ",\n") << "    {\"kernel\": \"" << result.kernel << "\", \"num_of_assets\": " << result.numOfAssets << ", \"window_size\": " << result.windowSize;
+
+        if (!result.skippedReason.empty())
+        {
+            output << ", \"skipped\": \"" << result.skippedReason << "\"}";
+            continue;
+        }
+
+        double gflops = result.flopPerOp / result.medianNanoseconds;
+
+        output << ", \"repetitions\": " << result.numOfRepetitions;
+        output << ", \"ns_per_op\": " << result.medianNanoseconds << ", \"min_ns_per_op\": " << result.minNanoseconds;
+        output << ", \"flop_per_op\": " << result.flopPerOp << ", \"gflops\": " << gflops;
+        output << ", \"bytes_per_op\": " << result.bytesPerOp << ", \"gbytes_per_second\": " << result.bytesPerOp / result.medianNanoseconds;
+        output << ", \"allocations_per_op\": " << result.allocationsPerOp << ", \"allocated_bytes_per_op\": " << result.allocatedBytesPerOp;
+
+        if (result.numOfSolverIterations >= 0)
+        {
+            output << ", \"solver_iterations\": " << result.numOfSolverIterations;
+            output << ", \"solver_reached_iteration_limit\": " << (result.hasReachedIterationLimit ? "true" : "false");
+        }
+
+        output << "}";
+    }
+
+    output << "\n  ]\n}\n";
+}
+
+int main(int argc, char *argv[])
+{
+    vector<int> assetCounts = {5, 50, 500, 5000};
+    vector<int> windowSizes = {60, 250, 1000};
+    double minSeconds = 0.2;
+
+    // Kernels that would take more floating point operations than this, e.g.
+    // multiplying two 5000 x 5000 matrices, are skipped. Solves are budgeted
+    // for the model's iteration limit, so those of 5000 assets need about 3e12.
+    double maxFlop = 1e10;
+
+    string outputFileName = "";
+
+    for (int i = 1; i < argc; i++)
+    {
+        string argument = argv[i];
+        bool hasValue = i + 1 < argc;
+
+        if (argument == "--assets" && hasValue && !(assetCounts = parseSizes(argv[++i])).empty())
+        {
+            continue;
+        }
+        else if (argument == "--windows" && hasValue && !(windowSizes = parseSizes(argv[++i])).empty())
+        {
+            continue;
+        }
+        else if (argument == "--min-time" && hasValue && (minSeconds = atof(argv[++i])) > 0)
+        {
+            continue;
+        }
+        else if (argument == "--max-flop" && hasValue && (maxFlop = atof(argv[++i])) > 0)
+        {
+            continue;
+        }
+        else if (argument == "--output" && hasValue)
+        {
+            outputFileName = argv[++i];
+        }
+        else
+        {
+            cout << "Usage: " << argv[0] << " [--assets n,...] [--windows n,...] [--min-time seconds] [--max-flop n] [--output file]" << endl;
+            return EXIT_FAILURE;
+        }
+    }
+
+    vector<BenchmarkResult> results;
+
+    for (int a = 0; a < assetCounts.size(); a++)
+    {
+        int n = assetCounts[a];
+        double n2 = (double)n * n;
+
+        // The kernels of matrix.cpp, on an (n x n) matrix and (n x 1) vector.
+        vector<vector<double> > matrix = createRandomMatrix(n, n);
+        vector<vector<double> > otherMatrix = createRandomMatrix(n, n);
+        vector<vector<double> > columnVector = createRandomMatrix(n, 1);
+
+        runKernel("multiplyMatrices/matrix_vector", n, 0, 2 * n2, 8 * (n2 + 2 * n), [&]() {
+            return multiplyMatrices(matrix, columnVector)[0][0];
+        }, minSeconds, maxFlop, results);
+
+        runKernel("multiplyMatrices/matrix_matrix", n, 0, 2 * n2 * n, 8 * 3 * n2, [&]() {
+            return multiplyMatrices(matrix, otherMatrix)[0][0];
+        }, minSeconds, maxFlop, results);
+
+        runKernel("getMatrixTranspose", n, 0, 0, 8 * 2 * n2, [&]() {
+            return getMatrixTranspose(matrix)[0][0];
+        }, minSeconds, maxFlop, results);
+
+        runKernel("addMatrices", n, 0, n2, 8 * 3 * n2, [&]() {
+            return addMatrices(matrix, otherMatrix)[0][0];
+        }, minSeconds, maxFlop, results);
+
+        runKernel("multiplyMatrixWithConstant", n, 0, n2, 8 * 2 * n2, [&]() {
+            return multiplyMatrixWithConstant(matrix, 0.5)[0][0];
+        }, minSeconds, maxFlop, results);
+
+        matrix.clear();
+        otherMatrix.clear();
+
+        // The estimators and the solver, on a window of w days of returns.
+        for (int b = 0; b < windowSizes.size(); b++)
+        {
+            int w = windowSizes[b];
+            vector<vector<double> > returnsMatrix = createRandomMatrix(n, w);
+
+            runKernel("calculateMeanReturns", n, w, (double)n * w, 8 * ((double)n * w + n), [&]() {
+                return calculateMeanReturns(returnsMatrix, 0, w - 1)[0][0];
+            }, minSeconds, maxFlop, results);
+
+            // Centring each return, then a multiply and add per pair of assets per day.
+            double covarianceFlop = 2 * (double)n * w + (n2 + n) * w;
+
+            runKernel("estimateCovarianceMatrix", n, w, covarianceFlop, 8 * ((double)n * w + n2), [&]() {
+                return estimateCovarianceMatrix(returnsMatrix, 0, w - 1)[0][0];
+            }, minSeconds, maxFlop, results);
+
+            // The covariance of a window no longer than the number of assets
+            // is singular, so the solve may run to the model's iteration limit;
+            // it is still benchmarked, as such windows are common with many assets.
+            MarkowitzModel model;
+            vector<double> targetReturns(1, 0.005);
+            vector<SolverStatistics> solverStatistics;
+
+            // The number of iterations is only known after a solve, so the
+            // budget assumes the most that the model lets conjugate gradients take.
+            int rank = n + 2;
+            double iterationFlop = 2.0 * rank * rank + 10.0 * rank;
+            double maxSolverFlop = covarianceFlop + (double)model.getMaxNumOfIterationsPerRow() * rank * iterationFlop;
+
+            if (maxSolverFlop > maxFlop)
+            {
+                BenchmarkResult result = {"MarkowitzModel::calculatePortfolioWeights", n, w, 0, 0, 0, maxSolverFlop, 0, 0, 0, -1, false, "more than --max-flop floating point operations"};
+                results.push_back(result);
+                continue;
+            }
+
+            model.calculatePortfolioWeights(returnsMatrix, 0, w - 1, targetReturns, &solverStatistics);
+            int numOfIterations = solverStatistics[0].numOfIterations;
+
+            runKernel("MarkowitzModel::calculatePortfolioWeights", n, w, covarianceFlop + numOfIterations * iterationFlop, 8 * ((double)n * w + n2 + (double)numOfIterations * rank * rank), [&]() {
+                return model.calculatePortfolioWeights(returnsMatrix, 0, w - 1, targetReturns)[0][0];
+            }, minSeconds, maxFlop, results);
+
+            results.back().numOfSolverIterations = numOfIterations;
+            results.back().hasReachedIterationLimit = solverStatistics[0].hasReachedIterationLimit;
+        }
+    }
+
+    if (outputFileName.empty())
+    {
+        writeJson(results, minSeconds, cout);
+    }
+    else
+    {
+        ofstream outputFile(outputFileName);
+        writeJson(results, minSeconds, outputFile);
+        cerr << "Wrote the results to " << outputFileName << endl;
+    }
+
+    return 0;
+}
@@ -0,0 +1,377 @@
+#include "cached_portfolio_optimisation_model.h"
+
+static const char cacheMagic[8] = {'M', 'K', 'W', 'C', 'A', 'C', 'H', 'E'};
+static const int cacheVersion = 2;
+
+// The file starts with the magic, the version and 4 reserved bytes.
+static const size_t cacheHeaderSize = 16;
+
+// A record is the key, the number of weights, the number of iterations, the
+// residual norm, whether the iteration limit was reached and the number of
+// excluded assets, then the weights, then the checksum of all of these.
+static const size_t recordHeaderSize = sizeof(uint64_t) + 2 * sizeof(int32_t) + sizeof(double) + 2 * sizeof(int32_t);
+
+// The offset of the iteration limit flag and the number of excluded assets in a record.
+static const size_t recordFlagsOffset = sizeof(uint64_t) + 2 * sizeof(int32_t) + sizeof(double);
+
+/***************** Public Methods *****************/
+
+/**
+ * Constructs a cached model, loading the portfolios already in the
+ * file, which is created if it does not exist.
+ *
+ * @param model - The model to calculate missing portfolios with. Must outlive the cache.
+ * @param fileName - The name of the cache file.
+ **/
+CachedPortfolioOptimisationModel::CachedPortfolioOptimisationModel(PortfolioOptimisationModel &model, const string &fileName) : model(model)
+{
+    this->fileName = fileName;
+    this->numOfHits = 0;
+    this->numOfMisses = 0;
+
+    const char *modelTypeName = typeid(model).name();
+    modelHash = model.hashParameters(calculateFnv1aHash(modelTypeName, strlen(modelTypeName)));
+
+    fileDescriptor = open(fileName.c_str(), O_RDWR | O_CREAT | O_APPEND, 0644);
+
+    if (fileDescriptor < 0)
+    {
+        cout << "Could not open " << fileName << " to cache portfolios." << endl;
+        exit(EXIT_FAILURE);
+    }
+
+    load();
+}
+
+/**
+ * Closes the cache file.
+ **/
+CachedPortfolioOptimisationModel::~CachedPortfolioOptimisationModel()
+{
+    close(fileDescriptor);
+}
+
+/**
+ * Returns the cached optimal portfolio weights for the given subsection
+ * of time-indexed returns, calculating and caching them if they are not
+ * cached.
+ *
+ * @param returnsMatrix - The matrix of time-indexed returns.
+ * @param returnsStartIdx - The "first day" of the sample of returns.
+ * @param returnsEndIdx - The "last day" of the sample of returns.
+ * @param targetReturn - The desired return to be attained by the optimal portfolio.
+ * @return The optimal portfolio weights.
+ **/
+vector<double> CachedPortfolioOptimisationModel::calculatePortfolioWeights(const ReturnsView &returnsMatrix, int returnsStartIdx, int returnsEndIdx, double targetReturn)
+{
+    return calculatePortfolioWeights(returnsMatrix, returnsStartIdx, returnsEndIdx, vector<double>(1, targetReturn))[0];
+}
+
+/**
+ * Returns the cached optimal portfolio weights for each of the given
+ * target returns. The targets that are not cached are calculated
+ * together, in one call to the model, and cached.
+ *
+ * @param returnsMatrix - The matrix of time-indexed returns.
+ * @param returnsStartIdx - The "first day" of the sample of returns.
+ * @param returnsEndIdx - The "last day" of the sample of returns.
+ * @param targetReturns - The desired returns to be attained by the optimal portfolios.
+ * @param solverStatistics - Optionally populated with the statistics of the solve
+ *                           for each target return, as cached.
+ * @return The optimal portfolio weights, one row per target return.
+ **/
+vector<vector<double> > CachedPortfolioOptimisationModel::calculatePortfolioWeights(const ReturnsView &returnsMatrix, int returnsStartIdx, int returnsEndIdx, const vector<double> &targetReturns, vector<SolverStatistics> *solverStatistics)
+{
+    uint64_t windowHash = hashWindow(returnsMatrix, returnsStartIdx, returnsEndIdx);
+
+    vector<vector<double> > portfolioWeights(targetReturns.size());
+    vector<SolverStatistics> statistics(targetReturns.size());
+
+    vector<uint64_t> keys(targetReturns.size());
+    vector<int> missingTargetIdxs;
+    vector<double> missingTargetReturns;
+
+    {
+        lock_guard<mutex> lock(cacheMutex);
+
+        for (int i = 0; i < targetReturns.size(); i++)
+        {
+            keys[i] = calculateFnv1aHash(&targetReturns[i], sizeof(double), windowHash);
+
+            unordered_map<uint64_t, CachedPortfolio>::const_iterator portfolio = portfolios.find(keys[i]);
+
+            if (portfolio != portfolios.end())
+            {
+                portfolioWeights[i] = portfolio->second.weights;
+                statistics[i] = portfolio->second.statistics;
+                numOfHits++;
+            }
+            else
+            {
+                missingTargetIdxs.push_back(i);
+                missingTargetReturns.push_back(targetReturns[i]);
+            }
+        }
+    }
+
+    // The missing portfolios are solved outside the lock, so that threads
+    // solving different windows do not wait on each other.
+    if (!missingTargetIdxs.empty())
+    {
+        vector<SolverStatistics> missingStatistics;
+        vector<vector<double> > missingWeights = model.calculatePortfolioWeights(returnsMatrix, returnsStartIdx, returnsEndIdx, missingTargetReturns, &missingStatistics);
+
+        lock_guard<mutex> lock(cacheMutex);
+
+        for (int j = 0; j < missingTargetIdxs.size(); j++)
+        {
+            int i = missingTargetIdxs[j];
+            CachedPortfolio portfolio = {missingWeights[j], missingStatistics[j]};
+
+            portfolioWeights[i] = portfolio.weights;
+            statistics[i] = portfolio.statistics;
+
+            // Another thread may have solved the same window meanwhile.
+            if (portfolios.insert(make_pair(keys[i], portfolio)).second)
+            {
+                append(keys[i], portfolio);
+            }
+
+            numOfMisses++;
+        }
+    }
+
+    if (solverStatistics != NULL)
+    {
+        *solverStatistics = statistics;
+    }
+
+    return portfolioWeights;
+}
+
+/**
+ * Mixes the parameters of the cached model into the given hash.
+ *
+ * @param hash - The hash to continue from.
+ * @return The hash.
+ **/
+uint64_t CachedPortfolioOptimisationModel::hashParameters(uint64_t hash) const
+{
+    return model.hashParameters(hash);
+}
+
+/**
+ * Returns the number of portfolios found in the cache.
+ *
+ * @return The number of hits.
+ **/
+int CachedPortfolioOptimisationModel::getNumOfHits() const
+{
+    lock_guard<mutex> lock(cacheMutex);
+
+    return numOfHits;
+}
+
+/**
+ * Returns the number of portfolios that had to be calculated.
+ *
+ * @return The number of misses.
+ **/
+int CachedPortfolioOptimisationModel::getNumOfMisses() const
+{
+    lock_guard<mutex> lock(cacheMutex);
+
+    return numOfMisses;
+}
+
+/**
+ * Prints the number of hits and misses, and the number of portfolios
+ * cached.
+ **/
+void CachedPortfolioOptimisationModel::printStatistics() const
+{
+    lock_guard<mutex> lock(cacheMutex);
+
+    int numOfLookups = numOfHits + numOfMisses;
+    double hitRate = numOfLookups > 0 ? 100.0 * numOfHits / numOfLookups : 0;
+
+    cout << "Portfolio cache " << fileName << ": " << numOfHits << " hits, " << numOfMisses << " misses (" << hitRate << "% hit rate), " << portfolios.size() << " portfolios cached" << endl;
+}
+
+/***************** Private Methods *****************/
+
+/**
+ * Returns the hash of the returns of every asset over the given
+ * subsection of time-indexed returns, continuing the model's hash.
+ *
+ * @param returnsMatrix - The matrix of time-indexed returns.
+ * @param returnsStartIdx - The "first day" of the sample of returns.
+ * @param returnsEndIdx - The "last day" of the sample of returns.
+ * @return The hash of the window.
+ **/
+uint64_t CachedPortfolioOptimisationModel::hashWindow(const ReturnsView &returnsMatrix, int returnsStartIdx, int returnsEndIdx) const
+{
+    int32_t shape[] = {(int32_t)returnsMatrix.getNumOfAssets(), returnsEndIdx + 1 - returnsStartIdx};
+    uint64_t hash = calculateFnv1aHash(shape, sizeof(shape), modelHash);
+    vector<double> windowReturns;
+
+    // The returns are hashed as doubles, so a window's hash does not depend
+    // on how its panel is stored.
+    for (int i = 0; i < returnsMatrix.getNumOfAssets(); i++)
+    {
+        hash = calculateFnv1aHash(returnsMatrix.readAssetReturns(i, returnsStartIdx, returnsEndIdx, windowReturns), shape[1] * sizeof(double), hash);
+    }
+
+    return hash;
+}
+
+/**
+ * Reads every complete record of the cache file into the portfolios,
+ * writing the file's header if it is empty, and cutting off any torn
+ * record at its end. Holds the file's lock throughout.
+ **/
+void CachedPortfolioOptimisationModel::load()
+{
+    flock(fileDescriptor, LOCK_EX);
+
+    struct stat fileStatus;
+    fstat(fileDescriptor, &fileStatus);
+
+    vector<char> contents(fileStatus.st_size);
+
+    if (pread(fileDescriptor, contents.data(), contents.size(), 0) != (ssize_t)contents.size())
+    {
+        cout << "Could not read " << fileName << "." << endl;
+        exit(EXIT_FAILURE);
+    }
+
+    if (contents.empty())
+    {
+        char header[cacheHeaderSize] = {0};
+        memcpy(header, cacheMagic, sizeof(cacheMagic));
+        memcpy(header + sizeof(cacheMagic), &cacheVersion, sizeof(cacheVersion));
+
+        if (write(fileDescriptor, header, sizeof(header)) != sizeof(header))
+        {
+            cout << "Could not write " << fileName << "." << endl;
+            exit(EXIT_FAILURE);
+        }
+
+        flock(fileDescriptor, LOCK_UN);
+        return;
+    }
+
+    int version = 0;
+
+    if (contents.size() >= cacheHeaderSize)
+    {
+        memcpy(&version, &contents[sizeof(cacheMagic)], sizeof(version));
+    }
+
+    if (contents.size() < cacheHeaderSize || memcmp(contents.data(), cacheMagic, sizeof(cacheMagic)) != 0 || version != cacheVersion)
+    {
+        cout << fileName << " is not a valid portfolio cache." << endl;
+        exit(EXIT_FAILURE);
+    }
+
+    size_t offset = cacheHeaderSize;
+
+    while (contents.size() - offset >= recordHeaderSize)
+    {
+        const char *record = &contents[offset];
+
+        uint64_t key;
+        int32_t numOfWeights;
+        CachedPortfolio portfolio;
+
+        memcpy(&key, record, sizeof(key));
+        memcpy(&numOfWeights, record + sizeof(key), sizeof(numOfWeights));
+        memcpy(&portfolio.statistics.numOfIterations, record + sizeof(key) + sizeof(numOfWeights), sizeof(int32_t));
+        memcpy(&portfolio.statistics.residualNorm, record + sizeof(key) + 2 * sizeof(int32_t), sizeof(double));
+
+        int32_t hasReachedIterationLimit;
+        memcpy(&hasReachedIterationLimit, record + recordFlagsOffset, sizeof(int32_t));
+        memcpy(&portfolio.statistics.numOfExcludedAssets, record + recordFlagsOffset + sizeof(int32_t), sizeof(int32_t));
+        portfolio.statistics.hasReachedIterationLimit = hasReachedIterationLimit != 0;
+
+        size_t recordSize = recordHeaderSize + (size_t)max(numOfWeights, 0) * sizeof(double) + sizeof(uint64_t);
+
+        if (numOfWeights < 0 || contents.size() - offset < recordSize)
+        {
+            break;
+        }
+
+        uint64_t checksum;
+        memcpy(&checksum, record + recordSize - sizeof(checksum), sizeof(checksum));
+
+        if (checksum != calculateFnv1aHash(record, recordSize - sizeof(checksum)))
+        {
+            break;
+        }
+
+        portfolio.weights.resize(numOfWeights);
+        memcpy(portfolio.weights.data(), record + recordHeaderSize, numOfWeights * sizeof(double));
+        portfolios[key] = portfolio;
+
+        offset += recordSize;
+    }
+
+    // Nothing is appended while the lock is held, so anything after the
+    // last complete record was torn by a crash, and would hide the records
+    // appended after it.
+    if (offset < contents.size() && ftruncate(fileDescriptor, offset) != 0)
+    {
+        cout << "Could not cut the torn record off " << fileName << "." << endl;
+        exit(EXIT_FAILURE);
+    }
+
+    flock(fileDescriptor, LOCK_UN);
+}
+
+/**
+ * Appends a record of the given portfolio to the cache file.
+ *
+ * @param key - The key of the portfolio.
+ * @param portfolio - The portfolio.
+ **/
+void CachedPortfolioOptimisationModel::append(uint64_t key, const CachedPortfolio &portfolio)
+{
+    int32_t numOfWeights = portfolio.weights.size();
+    int32_t numOfIterations = portfolio.statistics.numOfIterations;
+    int32_t hasReachedIterationLimit = portfolio.statistics.hasReachedIterationLimit;
+    int32_t numOfExcludedAssets = portfolio.statistics.numOfExcludedAssets;
+
+    vector<char> record(recordHeaderSize + numOfWeights * sizeof(double) + sizeof(uint64_t));
+
+    memcpy(&record[0], &key, sizeof(key));
+    memcpy(&record[sizeof(key)], &numOfWeights, sizeof(numOfWeights));
+    memcpy(&record[sizeof(key) + sizeof(numOfWeights)], &numOfIterations, sizeof(numOfIterations));
+    memcpy(&record[sizeof(key) + 2 * sizeof(int32_t)], &portfolio.statistics.residualNorm, sizeof(double));
+    memcpy(&record[recordFlagsOffset], &hasReachedIterationLimit, sizeof(hasReachedIterationLimit));
+    memcpy(&record[recordFlagsOffset + sizeof(int32_t)], &numOfExcludedAssets, sizeof(numOfExcludedAssets));
+    memcpy(&record[recordHeaderSize], portfolio.weights.data(), numOfWeights * sizeof(double));
+
+    uint64_t checksum = calculateFnv1aHash(record.data(), record.size() - sizeof(checksum));
+    memcpy(&record[record.size() - sizeof(checksum)], &checksum, sizeof(checksum));
+
+    // The lock keeps appends from other processes from interleaving with
+    // this one, and O_APPEND puts each at the current end of the file.
+    flock(fileDescriptor, LOCK_EX);
+
+    size_t numOfBytesWritten = 0;
+
+    while (numOfBytesWritten < record.size())
+    {
+        ssize_t result = write(fileDescriptor, &record[numOfBytesWritten], record.size() - numOfBytesWritten);
+
+        if (result <= 0)
+        {
+            cout << "Could not append to " << fileName << "." << endl;
+            exit(EXIT_FAILURE);
+        }
+
+        numOfBytesWritten += result;
+    }
+
+    flock(fileDescriptor, LOCK_UN);
+}
@@ -0,0 +1,161 @@
+#ifndef CachedPortfolioOptimisationModel_h
+#define CachedPortfolioOptimisationModel_h
+
+#include <fcntl.h>
+#include <iostream>
+#include <mutex>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <typeinfo>
+#include <unistd.h>
+#include <unordered_map>
+#include <vector>
+#include "portfolio_optimisation_model.h"
+#include "utils.h"
+
+using namespace std;
+
+/**
+ * A portfolio optimisation model that memoises the portfolios of another
+ * model in a file, so that reruns which share windows with earlier runs,
+ * e.g. after a small change of configuration, skip their solves.
+ *
+ * A portfolio is keyed by the FNV-1a hash of the model's type and
+ * parameters, the returns of the window it was solved over, and its target
+ * return, so a key changes with anything that could change the portfolio.
+ *
+ * The file is a log of checksummed records, to which solves are appended as
+ * they finish. Appends take an exclusive lock on the file and are written
+ * in one piece, so that several processes, e.g. backtest shards, can share
+ * a cache. The whole file is read once, under the same lock, when the model
+ * is constructed, and a record torn by a crash is cut off.
+ **/
+class CachedPortfolioOptimisationModel : public virtual PortfolioOptimisationModel
+{
+public:
+    /**
+     * Constructs a cached model, loading the portfolios already in the
+     * file, which is created if it does not exist.
+     *
+     * @param model - The model to calculate missing portfolios with. Must outlive the cache.
+     * @param fileName - The name of the cache file.
+     **/
+    CachedPortfolioOptimisationModel(PortfolioOptimisationModel &model, const string &fileName);
+
+    /**
+     * Closes the cache file.
+     **/
+    ~CachedPortfolioOptimisationModel();
+
+    /**
+     * Returns the cached optimal portfolio weights for the given subsection
+     * of time-indexed returns, calculating and caching them if they are not
+     * cached.
+     *
+     * @param returnsMatrix - The matrix of time-indexed returns.
+     * @param returnsStartIdx - The "first day" of the sample of returns.
+     * @param returnsEndIdx - The "last day" of the sample of returns.
+     * @param targetReturn - The desired return to be attained by the optimal portfolio.
+     * @return The optimal portfolio weights.
+     **/
+    vector<double> calculatePortfolioWeights(const ReturnsView &returnsMatrix, int returnsStartIdx, int returnsEndIdx, double targetReturn);
+
+    /**
+     * Returns the cached optimal portfolio weights for each of the given
+     * target returns. The targets that are not cached are calculated
+     * together, in one call to the model, and cached.
+     *
+     * @param returnsMatrix - The matrix of time-indexed returns.
+     * @param returnsStartIdx - The "first day" of the sample of returns.
+     * @param returnsEndIdx - The "last day" of the sample of returns.
+     * @param targetReturns - The desired returns to be attained by the optimal portfolios.
+     * @param solverStatistics - Optionally populated with the statistics of the solve
+     *                           for each target return, as cached.
+     * @return The optimal portfolio weights, one row per target return.
+     **/
+    vector<vector<double> > calculatePortfolioWeights(const ReturnsView &returnsMatrix, int returnsStartIdx, int returnsEndIdx, const vector<double> &targetReturns, vector<SolverStatistics> *solverStatistics = NULL);
+
+    /**
+     * Mixes the parameters of the cached model into the given hash.
+     *
+     * @param hash - The hash to continue from.
+     * @return The hash.
+     **/
+    uint64_t hashParameters(uint64_t hash) const;
+
+    /**
+     * Returns the number of portfolios found in the cache.
+     *
+     * @return The number of hits.
+     **/
+    int getNumOfHits() const;
+
+    /**
+     * Returns the number of portfolios that had to be calculated.
+     *
+     * @return The number of misses.
+     **/
+    int getNumOfMisses() const;
+
+    /**
+     * Prints the number of hits and misses, and the number of portfolios
+     * cached.
+     **/
+    void printStatistics() const;
+
+private:
+    /**
+     * A cached portfolio.
+     **/
+    struct CachedPortfolio
+    {
+        vector<double> weights;
+        SolverStatistics statistics;
+    };
+
+    PortfolioOptimisationModel &model;
+    string fileName;
+    int fileDescriptor;
+
+    // The hash of the model's type and parameters, which every key continues.
+    uint64_t modelHash;
+
+    // Guards the portfolios, the counts and appends to the file, as the
+    // model may be called from several threads.
+    mutable mutex cacheMutex;
+    unordered_map<uint64_t, CachedPortfolio> portfolios;
+    int numOfHits;
+    int numOfMisses;
+
+    /**
+     * Returns the hash of the returns of every asset over the given
+     * subsection of time-indexed returns, continuing the model's hash.
+     *
+     * @param returnsMatrix - The matrix of time-indexed returns.
+     * @param returnsStartIdx - The "first day" of the sample of returns.
+     * @param returnsEndIdx - The "last day" of the sample of returns.
+     * @return The hash of the window.
+     **/
+    uint64_t hashWindow(const ReturnsView &returnsMatrix, int returnsStartIdx, int returnsEndIdx) const;
+
+    /**
+     * Reads every complete record of the cache file into the portfolios,
+     * writing the file's header if it is empty, and cutting off any torn
+     * record at its end. Holds the file's lock throughout.
+     **/
+    void load();
+
+    /**
+     * Appends a record of the given portfolio to the cache file.
+     *
+     * @param key - The key of the portfolio.
+     * @param portfolio - The portfolio.
+     **/
+    void append(uint64_t key, const CachedPortfolio &portfolio);
+};
+
+#endif
@@ -0,0 +1,294 @@
+#include "csv_scanner.h"
+
+/**
+ * Constructs a scanner over the given bytes.
+ *
+ * @param begin - The first byte.
+ * @param end - One past the last byte.
+ **/
+CsvScanner::CsvScanner(const char *begin, const char *end)
+{
+    this->position = begin;
+    this->end = end;
+    this->isInLine = false;
+    this->hasMoreFields = false;
+}
+
+/**
+ * Moves to the next line, skipping any unread fields of the current one.
+ *
+ * @return False if there are no more lines.
+ **/
+bool CsvScanner::nextLine()
+{
+    if (isInLine)
+    {
+        const char *fieldBegin;
+        const char *fieldEnd;
+
+        while (nextField(fieldBegin, fieldEnd))
+        {
+        }
+
+        // Step over the line ending, treating "\r\n" as one.
+        if (position < end)
+        {
+            position += *position == '\r' && position + 1 < end && position[1] == '\n' ? 2 : 1;
+        }
+    }
+
+    if (position >= end)
+    {
+        isInLine = false;
+        return false;
+    }
+
+    isInLine = true;
+    hasMoreFields = *position != '\n' && *position != '\r';
+
+    return true;
+}
+
+/**
+ * Reads the next field of the current line.
+ *
+ * @param fieldBegin - Populated with the first byte of the field.
+ * @param fieldEnd - Populated with one past the last byte of the field.
+ * @return False if the line has no more fields.
+ **/
+bool CsvScanner::nextField(const char *&fieldBegin, const char *&fieldEnd)
+{
+    if (!hasMoreFields)
+    {
+        return false;
+    }
+
+    bool isQuoted = position < end && *position == '"';
+    const char *specialChar;
+
+    if (isQuoted)
+    {
+        // A quoted field ends at a quote that is not doubled. Anything after
+        // the closing quote, up to the separator, is skipped.
+        fieldBegin = position + 1;
+        fieldEnd = fieldBegin;
+
+        while (fieldEnd < end && *fieldEnd != '\n' && *fieldEnd != '\r' && (*fieldEnd != '"' || (fieldEnd + 1 < end && fieldEnd[1] == '"')))
+        {
+            fieldEnd += *fieldEnd == '"' ? 2 : 1;
+        }
+
+        specialChar = fieldEnd < end && *fieldEnd == '"' ? fieldEnd + 1 : fieldEnd;
+    }
+    else
+    {
+        fieldBegin = position;
+        specialChar = position;
+    }
+
+    // Quotes within an unquoted field are ordinary characters.
+    specialChar = findSpecialChar(specialChar, end);
+
+    while (specialChar < end && *specialChar == '"')
+    {
+        specialChar = findSpecialChar(specialChar + 1, end);
+    }
+
+    if (!isQuoted)
+    {
+        fieldEnd = specialChar;
+    }
+
+    if (specialChar < end && *specialChar == ',')
+    {
+        position = specialChar + 1;
+    }
+    else
+    {
+        position = specialChar;
+        hasMoreFields = false;
+    }
+
+    return true;
+}
+
+/**
+ * Returns the first separator, line ending or quote at or after the given
+ * position. Scans 16 bytes at a time with SSE2 where available, and 8
+ * bytes at a time otherwise.
+ *
+ * @param position - The position to scan from.
+ * @param end - One past the last byte to scan.
+ * @return The position of the character, or `end` if there is none.
+ **/
+const char *CsvScanner::findSpecialChar(const char *position, const char *end)
+{
+#if defined(__SSE2__)
+    const __m128i separators = _mm_set1_epi8(',');
+    const __m128i lineFeeds = _mm_set1_epi8('\n');
+    const __m128i carriageReturns = _mm_set1_epi8('\r');
+    const __m128i quotes = _mm_set1_epi8('"');
+
+    for (; end - position >= 16; position += 16)
+    {
+        __m128i chunk = _mm_loadu_si128((const __m128i *)position);
+        __m128i matches = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(chunk, separators), _mm_cmpeq_epi8(chunk, lineFeeds)), _mm_or_si128(_mm_cmpeq_epi8(chunk, carriageReturns), _mm_cmpeq_epi8(chunk, quotes)));
+        int matchMask = _mm_movemask_epi8(matches);
+
+        if (matchMask != 0)
+        {
+            return position + __builtin_ctz(matchMask);
+        }
+    }
+#endif
+
+    for (; end - position >= 8; position += 8)
+    {
+        uint64_t word;
+        memcpy(&word, position, sizeof(word));
+
+        uint64_t matches = findByte(word, ',') | findByte(word, '\n') | findByte(word, '\r') | findByte(word, '"');
+
+        if (matches != 0)
+        {
+            return position + __builtin_ctzll(matches) / 8;
+        }
+    }
+
+    for (; position < end; position++)
+    {
+        if (*position == ',' || *position == '\n' || *position == '\r' || *position == '"')
+        {
+            return position;
+        }
+    }
+
+    return end;
+}
+
+/**
+ * Returns the first "\r" or "\n" at or after the given position, scanning
+ * as `findSpecialChar` does.
+ *
+ * @param position - The position to scan from.
+ * @param end - One past the last byte to scan.
+ * @return The position of the line ending, or `end` if there is none.
+ **/
+const char *CsvScanner::findLineEnding(const char *position, const char *end)
+{
+#if defined(__SSE2__)
+    const __m128i lineFeeds = _mm_set1_epi8('\n');
+    const __m128i carriageReturns = _mm_set1_epi8('\r');
+
+    for (; end - position >= 16; position += 16)
+    {
+        __m128i chunk = _mm_loadu_si128((const __m128i *)position);
+        int matchMask = _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(chunk, lineFeeds), _mm_cmpeq_epi8(chunk, carriageReturns)));
+
+        if (matchMask != 0)
+        {
+            return position + __builtin_ctz(matchMask);
+        }
+    }
+#endif
+
+    for (; end - position >= 8; position += 8)
+    {
+        uint64_t word;
+        memcpy(&word, position, sizeof(word));
+
+        uint64_t matches = findByte(word, '\n') | findByte(word, '\r');
+
+        if (matches != 0)
+        {
+            return position + __builtin_ctzll(matches) / 8;
+        }
+    }
+
+    for (; position < end; position++)
+    {
+        if (*position == '\n' || *position == '\r')
+        {
+            return position;
+        }
+    }
+
+    return end;
+}
+
+/**
+ * Returns the start of the first line that starts at or after the given
+ * position, so that bytes can be split into ranges of whole lines.
+ *
+ * @param begin - The first byte of all the bytes, which starts a line.
+ * @param position - The position to search from.
+ * @param end - One past the last byte.
+ * @return The start of the line, or `end` if no line starts there.
+ **/
+const char *CsvScanner::findLineStart(const char *begin, const char *position, const char *end)
+{
+    if (position <= begin)
+    {
+        return begin;
+    }
+
+    // A line starts after "\n", or after a "\r" that is not part of "\r\n".
+    if (position < end && (position[-1] == '\n' || (position[-1] == '\r' && *position != '\n')))
+    {
+        return position;
+    }
+
+    const char *lineEnding = findLineEnding(position, end);
+
+    if (lineEnding < end && *lineEnding == '\r' && lineEnding + 1 < end && lineEnding[1] == '\n')
+    {
+        lineEnding++;
+    }
+
+    return lineEnding < end ? lineEnding + 1 : end;
+}
+
+/**
+ * Counts the lines that start in the given range, which must itself start
+ * a line. A scanner over the range reads as many lines.
+ *
+ * @param begin - The first byte of the range.
+ * @param end - One past the last byte of the range.
+ * @return The number of lines.
+ **/
+int CsvScanner::countLines(const char *begin, const char *end)
+{
+    int numOfLines = 0;
+
+    for (const char *position = begin; position < end; numOfLines++)
+    {
+        const char *lineEnding = findLineEnding(position, end);
+
+        if (lineEnding < end && *lineEnding == '\r' && lineEnding + 1 < end && lineEnding[1] == '\n')
+        {
+            lineEnding++;
+        }
+
+        position = lineEnding + 1;
+    }
+
+    return numOfLines;
+}
+
+/**
+ * Returns a word with a high bit set in (at least) the lowest byte of
+ * `word` equal to `c`, and none below it.
+ *
+ * @param word - Eight bytes, in memory order.
+ * @param c - The byte to look for.
+ * @return The match bits.
+ **/
+uint64_t CsvScanner::findByte(uint64_t word, char c)
+{
+    // Bytes equal to `c` become zero, and the lowest zero byte is the first
+    // to borrow in the subtraction. Bytes above it may be false positives,
+    // but only the lowest match is used (on a little endian machine).
+    uint64_t x = word ^ (0x0101010101010101ULL * (unsigned char)c);
+
+    return (x - 0x0101010101010101ULL) & ~x & 0x8080808080808080ULL;
+}
@@ -0,0 +1,111 @@
+#ifndef CsvScanner_h
+#define CsvScanner_h
+
+#include <stdint.h>
+#include <string.h>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+using namespace std;
+
+/**
+ * Walks the lines and fields of comma separated values held in memory, e.g.
+ * a mapped file, without copying them. Fields are returned as ranges of the
+ * underlying bytes, so there is no allocation per line or field.
+ *
+ * Lines and fields are split as by `Csv`: a line ends at "\r", "\n" or
+ * "\r\n", an empty line has no fields, and a field that starts with a quote
+ * runs to the closing quote. Unlike `Csv`, a quoted field is returned as it
+ * appears between its quotes, with any doubled quotes left in place and
+ * without any characters that follow the closing quote.
+ **/
+class CsvScanner
+{
+public:
+    /**
+     * Constructs a scanner over the given bytes.
+     *
+     * @param begin - The first byte.
+     * @param end - One past the last byte.
+     **/
+    CsvScanner(const char *begin, const char *end);
+
+    /**
+     * Moves to the next line, skipping any unread fields of the current one.
+     *
+     * @return False if there are no more lines.
+     **/
+    bool nextLine();
+
+    /**
+     * Reads the next field of the current line.
+     *
+     * @param fieldBegin - Populated with the first byte of the field.
+     * @param fieldEnd - Populated with one past the last byte of the field.
+     * @return False if the line has no more fields.
+     **/
+    bool nextField(const char *&fieldBegin, const char *&fieldEnd);
+
+    /**
+     * Returns the first separator, line ending or quote at or after the given
+     * position. Scans 16 bytes at a time with SSE2 where available, and 8
+     * bytes at a time otherwise.
+     *
+     * @param position - The position to scan from.
+     * @param end - One past the last byte to scan.
+     * @return The position of the character, or `end` if there is none.
+     **/
+    static const char *findSpecialChar(const char *position, const char *end);
+
+    /**
+     * Returns the first "\r" or "\n" at or after the given position, scanning
+     * as `findSpecialChar` does.
+     *
+     * @param position - The position to scan from.
+     * @param end - One past the last byte to scan.
+     * @return The position of the line ending, or `end` if there is none.
+     **/
+    static const char *findLineEnding(const char *position, const char *end);
+
+    /**
+     * Returns the start of the first line that starts at or after the given
+     * position, so that bytes can be split into ranges of whole lines.
+     *
+     * @param begin - The first byte of all the bytes, which starts a line.
+     * @param position - The position to search from.
+     * @param end - One past the last byte.
+     * @return The start of the line, or `end` if no line starts there.
+     **/
+    static const char *findLineStart(const char *begin, const char *position, const char *end);
+
+    /**
+     * Counts the lines that start in the given range, which must itself start
+     * a line. A scanner over the range reads as many lines.
+     *
+     * @param begin - The first byte of the range.
+     * @param end - One past the last byte of the range.
+     * @return The number of lines.
+     **/
+    static int countLines(const char *begin, const char *end);
+
+private:
+    const char *position;
+    const char *end;
+
+    // Whether a line has been started, and whether it has unread fields.
+    bool isInLine;
+    bool hasMoreFields;
+
+    /**
+     * Returns a word with a high bit set in (at least) the lowest byte of
+     * `word` equal to `c`, and none below it.
+     *
+     * @param word - Eight bytes, in memory order.
+     * @param c - The byte to look for.
+     * @return The match bits.
+     **/
+    static uint64_t findByte(uint64_t word, char c);
+};
+
+#endif
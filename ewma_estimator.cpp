@@ -0,0 +1,327 @@
+#include "ewma_estimator.h"
+
+// Identifies checkpoint files written by `saveState`.
+static const char checkpointMagic[8] = {'E', 'W', 'M', 'A', 'C', 'K', 'P', 'T'};
+static const int checkpointVersion = 2;
+
+/**
+ * Constructs an estimator with no observations.
+ *
+ * @param numOfAssets - The number of assets in scope.
+ * @param halfLife - The number of days after which an observation's weight halves.
+ **/
+EwmaEstimator::EwmaEstimator(int numOfAssets, double halfLife)
+{
+    if (numOfAssets <= 0 || halfLife <= 0)
+    {
+        cout << "EWMA estimator requires a positive number of assets and half life." << endl;
+        exit(EXIT_FAILURE);
+    }
+
+    this->numOfAssets = numOfAssets;
+    this->halfLife = halfLife;
+    this->decayFactor = pow(0.5, 1. / halfLife);
+    this->numOfObservations = 0;
+
+    sumsOfWeights.assign(numOfAssets, vector<double>(numOfAssets, 0));
+    sumsOfSquaredWeights.assign(numOfAssets, vector<double>(numOfAssets, 0));
+    meanReturns.assign(numOfAssets, vector<double>(numOfAssets, 0));
+    covarianceMatrix.assign(numOfAssets, vector<double>(numOfAssets, 0));
+    hasReturns.resize(numOfAssets);
+}
+
+/**
+ * Updates the estimates with a new day of returns.
+ *
+ * With decay factor L, x the new returns and W the running sum of
+ * observation weights, the update is
+ *   W = L * W + 1
+ *   d = x - mean
+ *   mean = mean + d / W
+ *   cov = (1 - 1 / W) * (cov + d * d^T / W)
+ * which reduces to Welford's algorithm when L = 1. Each pair of assets
+ * keeps its own W, and means, over the days on which both have a return.
+ * On a day that one of them misses, only its W decays, which weights its
+ * next day correctly and leaves its estimates, ratios of sums that decay
+ * alike, unchanged.
+ *
+ * @param returns - The returns of every asset on the new day, with missing returns as NaN.
+ **/
+void EwmaEstimator::update(const vector<double> &returns)
+{
+    if (returns.size() != numOfAssets)
+    {
+        cout << "Number of returns does not match the number of assets in the EWMA estimator." << endl;
+        exit(EXIT_FAILURE);
+    }
+
+    numOfObservations++;
+
+    for (int i = 0; i < numOfAssets; i++)
+    {
+        hasReturns[i] = !isnan(returns[i]);
+    }
+
+    double squaredDecayFactor = decayFactor * decayFactor;
+
+    for (int i = 0; i < numOfAssets; i++)
+    {
+        double *sumsOfWeightsRow = &sumsOfWeights[i][0];
+        double *sumsOfSquaredWeightsRow = &sumsOfSquaredWeights[i][0];
+        double *covarianceRow = &covarianceMatrix[i][0];
+
+        for (int j = i; j < numOfAssets; j++)
+        {
+            if (!hasReturns[i] || !hasReturns[j])
+            {
+                sumsOfWeightsRow[j] *= decayFactor;
+                sumsOfSquaredWeightsRow[j] *= squaredDecayFactor;
+                continue;
+            }
+
+            sumsOfWeightsRow[j] = decayFactor * sumsOfWeightsRow[j] + 1;
+            sumsOfSquaredWeightsRow[j] = squaredDecayFactor * sumsOfSquaredWeightsRow[j] + 1;
+
+            double weight = 1 / sumsOfWeightsRow[j];
+            double deviationI = returns[i] - meanReturns[i][j];
+            double deviationJ = returns[j] - meanReturns[j][i];
+
+            meanReturns[i][j] += weight * deviationI;
+
+            if (j != i)
+            {
+                meanReturns[j][i] += weight * deviationJ;
+            }
+
+            covarianceRow[j] = (1 - weight) * (covarianceRow[j] + weight * deviationI * deviationJ);
+        }
+    }
+}
+
+/**
+ * Updates the estimates with the returns on day `returnsIdx`
+ * of the given matrix of returns.
+ *
+ * @param returnsMatrix - The matrix of time-indexed returns.
+ * @param returnsIdx - The day of returns to update the estimates with.
+ **/
+void EwmaEstimator::update(const ReturnsView &returnsMatrix, int returnsIdx)
+{
+    vector<double> returns;
+    returns.resize(returnsMatrix.getNumOfAssets());
+
+    for (int assetIdx = 0; assetIdx < returnsMatrix.getNumOfAssets(); assetIdx++)
+    {
+        returns[assetIdx] = returnsMatrix.getReturn(assetIdx, returnsIdx);
+    }
+
+    update(returns);
+}
+
+/**
+ * Updates the estimates with every day of returns in the (inclusive)
+ * range bounded by `returnsStartIdx` and `returnsEndIdx`, in order.
+ *
+ * @param returnsMatrix - The matrix of time-indexed returns.
+ * @param returnsStartIdx - The "first day" of the sample of returns.
+ * @param returnsEndIdx - The "last day" of the sample of returns.
+ **/
+void EwmaEstimator::update(const ReturnsView &returnsMatrix, int returnsStartIdx, int returnsEndIdx)
+{
+    for (int returnsIdx = returnsStartIdx; returnsIdx <= returnsEndIdx; returnsIdx++)
+    {
+        update(returnsMatrix, returnsIdx);
+    }
+}
+
+/**
+ * Returns a column vector of the exponentially weighted mean returns.
+ *
+ * @return The column vector of mean returns.
+ **/
+vector<vector<double> > EwmaEstimator::getMeanReturns() const
+{
+    vector<double> meanReturnsRowVector(numOfAssets);
+
+    for (int i = 0; i < numOfAssets; i++)
+    {
+        meanReturnsRowVector[i] = sumsOfWeights[i][i] > 0 ? meanReturns[i][i] : NAN;
+    }
+
+    return convertFromRowToColumnVector(meanReturnsRowVector);
+}
+
+/**
+ * Returns the exponentially weighted covariance matrix.
+ *
+ * @return The covariance matrix.
+ **/
+vector<vector<double> > EwmaEstimator::getCovarianceMatrix() const
+{
+    vector<vector<double> > fullCovarianceMatrix = covarianceMatrix;
+
+    for (int i = 0; i < numOfAssets; i++)
+    {
+        for (int j = i; j < numOfAssets; j++)
+        {
+            // Correct the bias of the weighted estimate, the analogue of dividing
+            // by (n - 1) rather than n. Undefined until there are two observations.
+            double squaredSumOfWeights = sumsOfWeights[i][j] * sumsOfWeights[i][j];
+            double biasCorrection = 1;
+
+            if (squaredSumOfWeights > sumsOfSquaredWeights[i][j])
+            {
+                biasCorrection = squaredSumOfWeights / (squaredSumOfWeights - sumsOfSquaredWeights[i][j]);
+            }
+
+            // Mirror the upper triangle into the lower triangle.
+            fullCovarianceMatrix[i][j] = sumsOfWeights[i][j] > 0 ? covarianceMatrix[i][j] * biasCorrection : NAN;
+            fullCovarianceMatrix[j][i] = fullCovarianceMatrix[i][j];
+        }
+    }
+
+    return fullCovarianceMatrix;
+}
+
+/**
+ * Returns the number of days of returns seen so far.
+ *
+ * @return The number of observations.
+ **/
+long EwmaEstimator::getNumOfObservations() const
+{
+    return numOfObservations;
+}
+
+/**
+ * Returns the number of assets in scope.
+ *
+ * @return The number of assets.
+ **/
+int EwmaEstimator::getNumOfAssets() const
+{
+    return numOfAssets;
+}
+
+/**
+ * Returns the half life of the estimator.
+ *
+ * @return The half life, in days.
+ **/
+double EwmaEstimator::getHalfLife() const
+{
+    return halfLife;
+}
+
+/**
+ * Writes the state of the estimator to the given binary file, so
+ * that it can later be restored with `loadState`.
+ *
+ * @param fileName - The name of the checkpoint file.
+ **/
+void EwmaEstimator::saveState(const string &fileName) const
+{
+    ofstream file(fileName.c_str(), ios::binary | ios::trunc);
+
+    if (!file.is_open())
+    {
+        cout << "Could not open " << fileName << " to checkpoint the EWMA estimator." << endl;
+        exit(EXIT_FAILURE);
+    }
+
+    writeState(file);
+
+    file.close();
+}
+
+/**
+ * Restores the state of the estimator from a checkpoint file
+ * written by `saveState`.
+ *
+ * @param fileName - The name of the checkpoint file.
+ **/
+void EwmaEstimator::loadState(const string &fileName)
+{
+    ifstream file(fileName.c_str(), ios::binary);
+
+    if (!file.is_open())
+    {
+        cout << fileName << " missing\n";
+        exit(EXIT_FAILURE);
+    }
+
+    readState(file, fileName);
+
+    file.close();
+}
+
+/**
+ * Writes the state of the estimator to the given binary stream, e.g.
+ * as part of a larger snapshot, in the format of `saveState`.
+ *
+ * @param file - The stream to write to.
+ **/
+void EwmaEstimator::writeState(ostream &file) const
+{
+    file.write(checkpointMagic, sizeof(checkpointMagic));
+    file.write((const char *)&checkpointVersion, sizeof(checkpointVersion));
+    file.write((const char *)&numOfAssets, sizeof(numOfAssets));
+    file.write((const char *)&halfLife, sizeof(halfLife));
+    file.write((const char *)&numOfObservations, sizeof(numOfObservations));
+
+    for (int i = 0; i < numOfAssets; i++)
+    {
+        file.write((const char *)&sumsOfWeights[i][i], (numOfAssets - i) * sizeof(double));
+        file.write((const char *)&sumsOfSquaredWeights[i][i], (numOfAssets - i) * sizeof(double));
+        file.write((const char *)&covarianceMatrix[i][i], (numOfAssets - i) * sizeof(double));
+        file.write((const char *)&meanReturns[i][0], numOfAssets * sizeof(double));
+    }
+}
+
+/**
+ * Restores the state of the estimator from the given binary stream,
+ * written by `writeState`, exiting if it is not a valid state.
+ *
+ * @param file - The stream to read from.
+ * @param fileName - The name of the file, for errors.
+ **/
+void EwmaEstimator::readState(istream &file, const string &fileName)
+{
+    char magic[sizeof(checkpointMagic)];
+    int version = 0;
+    int savedNumOfAssets = 0;
+    double savedHalfLife = 0;
+
+    file.read(magic, sizeof(magic));
+    file.read((char *)&version, sizeof(version));
+    file.read((char *)&savedNumOfAssets, sizeof(savedNumOfAssets));
+    file.read((char *)&savedHalfLife, sizeof(savedHalfLife));
+
+    if (!file || !equal(magic, magic + sizeof(magic), checkpointMagic) || version != checkpointVersion)
+    {
+        cout << fileName << " is not a valid EWMA estimator checkpoint." << endl;
+        exit(EXIT_FAILURE);
+    }
+
+    if (savedNumOfAssets != numOfAssets || savedHalfLife != halfLife)
+    {
+        cout << fileName << " was checkpointed with a different number of assets or half life." << endl;
+        exit(EXIT_FAILURE);
+    }
+
+    file.read((char *)&numOfObservations, sizeof(numOfObservations));
+
+    for (int i = 0; i < numOfAssets; i++)
+    {
+        file.read((char *)&sumsOfWeights[i][i], (numOfAssets - i) * sizeof(double));
+        file.read((char *)&sumsOfSquaredWeights[i][i], (numOfAssets - i) * sizeof(double));
+        file.read((char *)&covarianceMatrix[i][i], (numOfAssets - i) * sizeof(double));
+        file.read((char *)&meanReturns[i][0], numOfAssets * sizeof(double));
+    }
+
+    if (!file)
+    {
+        cout << fileName << " is truncated." << endl;
+        exit(EXIT_FAILURE);
+    }
+}
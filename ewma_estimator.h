@@ -0,0 +1,167 @@
+#ifndef EwmaEstimator_h
+#define EwmaEstimator_h
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <vector>
+#include "matrix.h"
+#include "returns_view.h"
+
+using namespace std;
+
+/**
+ * An exponentially weighted moving average (EWMA) estimator of the mean
+ * returns and the covariance of returns. Recent observations are weighted
+ * more heavily than older ones, with the weight of an observation halving
+ * every `halfLife` days.
+ *
+ * The estimator is streaming - each new day of returns updates the estimates
+ * in O(no_of_assets^2), independent of how much history has been seen.
+ *
+ * Missing (NaN) returns are skipped, as the pairwise-complete sample
+ * estimates skip them: each mean is weighted over the days on which its
+ * asset has a return, and each covariance over the days on which both of
+ * its assets do, about the pair's own means. A gap therefore leaves the
+ * estimates of its asset where they were, rather than turning them NaN for
+ * good. Estimates with no days to weight are NaN.
+ **/
+class EwmaEstimator
+{
+public:
+    /**
+     * Constructs an estimator with no observations.
+     *
+     * @param numOfAssets - The number of assets in scope.
+     * @param halfLife - The number of days after which an observation's weight halves.
+     **/
+    EwmaEstimator(int numOfAssets, double halfLife);
+
+    /**
+     * Updates the estimates with a new day of returns.
+     *
+     * @param returns - The returns of every asset on the new day, with missing returns as NaN.
+     **/
+    void update(const vector<double> &returns);
+
+    /**
+     * Updates the estimates with the returns on day `returnsIdx`
+     * of the given matrix of returns.
+     *
+     * @param returnsMatrix - The matrix of time-indexed returns.
+     * @param returnsIdx - The day of returns to update the estimates with.
+     **/
+    void update(const ReturnsView &returnsMatrix, int returnsIdx);
+
+    /**
+     * Updates the estimates with every day of returns in the (inclusive)
+     * range bounded by `returnsStartIdx` and `returnsEndIdx`, in order.
+     *
+     * @param returnsMatrix - The matrix of time-indexed returns.
+     * @param returnsStartIdx - The "first day" of the sample of returns.
+     * @param returnsEndIdx - The "last day" of the sample of returns.
+     **/
+    void update(const ReturnsView &returnsMatrix, int returnsStartIdx, int returnsEndIdx);
+
+    /**
+     * Returns a column vector of the exponentially weighted mean returns.
+     *
+     * @return The column vector of mean returns.
+     **/
+    vector<vector<double> > getMeanReturns() const;
+
+    /**
+     * Returns the exponentially weighted covariance matrix.
+     *
+     * @return The covariance matrix.
+     **/
+    vector<vector<double> > getCovarianceMatrix() const;
+
+    /**
+     * Returns the number of days of returns seen so far.
+     *
+     * @return The number of observations.
+     **/
+    long getNumOfObservations() const;
+
+    /**
+     * Returns the number of assets in scope.
+     *
+     * @return The number of assets.
+     **/
+    int getNumOfAssets() const;
+
+    /**
+     * Returns the half life of the estimator.
+     *
+     * @return The half life, in days.
+     **/
+    double getHalfLife() const;
+
+    /**
+     * Writes the state of the estimator to the given binary file, so
+     * that it can later be restored with `loadState`.
+     *
+     * @param fileName - The name of the checkpoint file.
+     **/
+    void saveState(const string &fileName) const;
+
+    /**
+     * Restores the state of the estimator from a checkpoint file
+     * written by `saveState`.
+     *
+     * @param fileName - The name of the checkpoint file.
+     **/
+    void loadState(const string &fileName);
+
+    /**
+     * Writes the state of the estimator to the given binary stream, e.g.
+     * as part of a larger snapshot, in the format of `saveState`.
+     *
+     * @param file - The stream to write to.
+     **/
+    void writeState(ostream &file) const;
+
+    /**
+     * Restores the state of the estimator from the given binary stream,
+     * written by `writeState`, exiting if it is not a valid state.
+     *
+     * @param file - The stream to read from.
+     * @param fileName - The name of the file, for errors.
+     **/
+    void readState(istream &file, const string &fileName);
+
+private:
+    int numOfAssets;
+    double halfLife;
+
+    // The weight retained by the existing estimates on each update.
+    double decayFactor;
+
+    long numOfObservations;
+
+    // The sums of the (decayed) weights and squared weights of the days on
+    // which both assets of a pair have a return, used to normalise the
+    // estimates. The diagonal holds each asset's own, and only the upper
+    // triangle (j >= i) is maintained.
+    vector<vector<double> > sumsOfWeights;
+    vector<vector<double> > sumsOfSquaredWeights;
+
+    // meanReturns[i][j] is the mean return of asset i over the days on which
+    // asset j has a return too, about which their covariance is updated. The
+    // diagonal holds the mean returns.
+    vector<vector<double> > meanReturns;
+
+    // Only the upper triangle (j >= i) is maintained, since the
+    // covariance matrix is symmetric.
+    vector<vector<double> > covarianceMatrix;
+
+    // Scratch space for which assets have a return in `update`.
+    vector<char> hasReturns;
+};
+
+#endif
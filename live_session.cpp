@@ -0,0 +1,721 @@
+#include "live_session.h"
+
+static const char snapshotMagic[8] = {'L', 'I', 'V', 'E', 'S', 'N', 'A', 'P'};
+static const int snapshotVersion = 3;
+
+// The largest difference, relative to the sum, allowed between a snapshot's
+// sums and the sums recomputed from its returns.
+static const double snapshotSumsTolerance = 1e-9;
+
+/***************** Public Methods *****************/
+
+/**
+ * Constructs a live session over the given history of returns, which
+ * seeds the window. If the history fills the window, the portfolios are
+ * optimised straight away, so that the first bar is solved warm.
+ *
+ * @param model - The model to optimise with. Must outlive the session.
+ * @param history - The returns up to the start of the session.
+ * @param windowSize - The number of days in the rolling window.
+ * @param targetReturns - The desired returns to be attained by the optimal portfolios.
+ * @param ewmaHalfLife - The half life, in days, of an EWMA estimator to estimate
+ *                       the risk inputs with, or 0 to estimate them from the window.
+ **/
+LiveSession::LiveSession(MarkowitzModel &model, const ReturnsPanel &history, int windowSize, const vector<double> &targetReturns, double ewmaHalfLife) : model(model)
+{
+    if (windowSize < 2)
+    {
+        cout << "A live session needs a window of at least 2 days, not " << windowSize << "." << endl;
+        exit(EXIT_FAILURE);
+    }
+
+    this->windowSize = windowSize;
+    this->targetReturns = targetReturns;
+    this->numOfAssets = history.getNumOfAssets();
+
+    // The history may be mapped, and so read only, whatever its layout, so
+    // it is always copied, a day at a time, into a panel of the session's own.
+    returnsPanel = ReturnsPanel(numOfAssets, 0).toLayout(TIME_MAJOR);
+
+    if (ewmaHalfLife > 0)
+    {
+        ewmaEstimator.reset(new EwmaEstimator(numOfAssets, ewmaHalfLife));
+    }
+
+    vector<double> dayReturns(numOfAssets);
+
+    for (int t = 0; t < history.getNumOfReturns(); t++)
+    {
+        for (int i = 0; i < numOfAssets; i++)
+        {
+            dayReturns[i] = history.getReturn(i, t);
+        }
+
+        returnsPanel.appendReturns(dayReturns, t);
+
+        if (ewmaEstimator)
+        {
+            ewmaEstimator->update(dayReturns);
+        }
+    }
+
+    shifts.resize(numOfAssets);
+    sumsOfReturns.resize(numOfAssets);
+    sumsOfProducts.resize(numOfAssets);
+
+    for (int i = 0; i < numOfAssets; i++)
+    {
+        sumsOfProducts[i].resize(numOfAssets);
+    }
+
+    resyncSums();
+
+    if (returnsPanel.getNumOfReturns() >= windowSize)
+    {
+        optimise();
+    }
+}
+
+/**
+ * Constructs a live session from a snapshot written by `saveSnapshot`.
+ * The snapshot's sums are checked against the window's returns, which
+ * the restored panel holds in place of the full history.
+ *
+ * @param model - The model to optimise with. Must outlive the session.
+ * @param snapshotFileName - The name of the snapshot file.
+ **/
+LiveSession::LiveSession(MarkowitzModel &model, const string &snapshotFileName) : model(model)
+{
+    loadSnapshot(snapshotFileName);
+}
+
+/**
+ * Enables snapshots, so that `run` saves the state of the session
+ * after each bar, ready for a restart.
+ *
+ * @param fileName - The name of the snapshot file.
+ **/
+void LiveSession::enableSnapshots(const string &fileName)
+{
+    snapshotFileName = fileName;
+}
+
+/**
+ * Saves the state of the session to a snapshot file. The snapshot is
+ * written aside and renamed over the file, so that the file is always
+ * a complete snapshot.
+ *
+ * @param fileName - The name of the snapshot file.
+ **/
+void LiveSession::saveSnapshot(const string &fileName) const
+{
+    string partialFileName = fileName + ".partial";
+    ofstream file(partialFileName.c_str(), ios::binary | ios::trunc);
+
+    if (!file.is_open())
+    {
+        cout << "Could not open " << partialFileName << " to snapshot the live session." << endl;
+        exit(EXIT_FAILURE);
+    }
+
+    int numOfReturns = returnsPanel.getNumOfReturns();
+    int windowStartIdx = max(0, numOfReturns - windowSize);
+    int numOfWindowDays = numOfReturns - windowStartIdx;
+    int numOfTargets = targetReturns.size();
+
+    file.write(snapshotMagic, sizeof(snapshotMagic));
+    file.write((const char *)&snapshotVersion, sizeof(snapshotVersion));
+    file.write((const char *)&numOfAssets, sizeof(numOfAssets));
+    file.write((const char *)&windowSize, sizeof(windowSize));
+    file.write((const char *)&numOfTargets, sizeof(numOfTargets));
+    file.write((const char *)&numOfWindowDays, sizeof(numOfWindowDays));
+    file.write((const char *)&numOfIncompleteDays, sizeof(numOfIncompleteDays));
+    file.write((const char *)&numOfBarsSinceResync, sizeof(numOfBarsSinceResync));
+    file.write((const char *)targetReturns.data(), numOfTargets * sizeof(double));
+
+    // The window's days, which are all that is needed to roll it forward.
+    file.write((const char *)&returnsPanel.getDateIndex()[windowStartIdx], numOfWindowDays * sizeof(int64_t));
+
+    for (int t = windowStartIdx; t < numOfReturns; t++)
+    {
+        file.write((const char *)returnsPanel.getDayReturns(t), numOfAssets * sizeof(double));
+    }
+
+    // The sums as they are, rather than as recomputed, so that a restored
+    // session solves exactly as this one would.
+    file.write((const char *)shifts.data(), numOfAssets * sizeof(double));
+    file.write((const char *)sumsOfReturns.data(), numOfAssets * sizeof(double));
+
+    for (int i = 0; i < numOfAssets; i++)
+    {
+        file.write((const char *)&sumsOfProducts[i][i], (numOfAssets - i) * sizeof(double));
+    }
+
+    for (int k = 0; k < numOfTargets; k++)
+    {
+        // Before the window has first filled, there are no solutions.
+        bool isSolved = k < solutions.size();
+        int solutionSize = isSolved ? solutions[k].size() : 0;
+
+        file.write((const char *)&solutionSize, sizeof(solutionSize));
+
+        if (isSolved)
+        {
+            file.write((const char *)solutions[k].data(), solutionSize * sizeof(double));
+        }
+
+        SolverStatistics statistics = isSolved ? solverStatistics[k] : SolverStatistics{-1, NAN};
+
+        file.write((const char *)&statistics.numOfIterations, sizeof(statistics.numOfIterations));
+        file.write((const char *)&statistics.residualNorm, sizeof(statistics.residualNorm));
+    }
+
+    // The estimator's half life, 0 without one, and then its state.
+    double ewmaHalfLife = ewmaEstimator ? ewmaEstimator->getHalfLife() : 0;
+
+    file.write((const char *)&ewmaHalfLife, sizeof(ewmaHalfLife));
+
+    if (ewmaEstimator)
+    {
+        ewmaEstimator->writeState(file);
+    }
+
+    file.close();
+
+    if (!file)
+    {
+        cout << "Could not write the snapshot " << partialFileName << "." << endl;
+        exit(EXIT_FAILURE);
+    }
+
+    if (rename(partialFileName.c_str(), fileName.c_str()) != 0)
+    {
+        cout << "Could not replace " << fileName << " with the new snapshot." << endl;
+        exit(EXIT_FAILURE);
+    }
+}
+
+/**
+ * Appends a bar of returns, rolls the window forward and, once the
+ * window is full, re-optimises the portfolio of every target return.
+ *
+ * @param dayReturns - The return of every asset on the day, with missing returns as NaN.
+ * @return True if the portfolios were re-optimised.
+ **/
+bool LiveSession::appendReturns(const vector<double> &dayReturns)
+{
+    chrono::steady_clock::time_point startTime = chrono::steady_clock::now();
+
+    const vector<int64_t> &dateIndex = returnsPanel.getDateIndex();
+
+    returnsPanel.appendReturns(dayReturns, dateIndex.empty() ? 0 : dateIndex.back() + 1);
+
+    int numOfReturns = returnsPanel.getNumOfReturns();
+
+    updateSums(numOfReturns - 1, 1);
+
+    if (ewmaEstimator)
+    {
+        ewmaEstimator->update(dayReturns);
+    }
+
+    if (numOfReturns > windowSize)
+    {
+        updateSums(numOfReturns - 1 - windowSize, -1);
+    }
+
+    if (numOfReturns < windowSize)
+    {
+        return false;
+    }
+
+    if (++numOfBarsSinceResync >= windowSize)
+    {
+        resyncSums();
+    }
+
+    optimise();
+
+    latencies.push_back(chrono::duration<double, micro>(chrono::steady_clock::now() - startTime).count());
+
+    return true;
+}
+
+/**
+ * Appends a bar for each line of the given input until it ends, writing
+ * the portfolio weights of every bar to a CSV file as soon as they are
+ * solved. Each line holds the returns of one day, one field per asset,
+ * e.g. as written by a feed to stdin or followed with `tail -f`. The
+ * weights are appended to any that the file already holds, e.g. from
+ * before a restart.
+ *
+ * @param input - The lines of returns.
+ * @param fileName - The name of the CSV file to write the weights to.
+ **/
+void LiveSession::run(istream &input, const string &fileName)
+{
+    ofstream weightsFile;
+    weightsFile.open(fileName, ios::app);
+
+    if (weightsFile.tellp() == 0)
+    {
+        weightsFile << "Date,Target Return,Iterations,Latency (us)";
+
+        for (int assetIdx = 0; assetIdx < numOfAssets; assetIdx++)
+        {
+            weightsFile << "," << assetIdx + 1;
+        }
+        weightsFile << endl;
+    }
+
+    string line;
+
+    while (getline(input, line))
+    {
+        // Blank lines, e.g. a trailing line ending, are not bars.
+        if (line.empty() || line == "\r")
+        {
+            continue;
+        }
+
+        if (appendReturns(parseReturns(line)))
+        {
+            int64_t date = returnsPanel.getDateIndex().back();
+
+            for (int i = 0; i < targetReturns.size(); i++)
+            {
+                weightsFile << date << "," << targetReturns[i] << "," << solverStatistics[i].numOfIterations << "," << latencies.back();
+
+                for (int j = 0; j < portfolioWeights[i].size(); j++)
+                {
+                    weightsFile << "," << portfolioWeights[i][j];
+                }
+
+                weightsFile << "\n";
+            }
+
+            // Each bar's weights are wanted as soon as they are solved.
+            weightsFile.flush();
+        }
+
+        // Every bar is snapshotted, including those before the window fills.
+        if (!snapshotFileName.empty())
+        {
+            saveSnapshot(snapshotFileName);
+        }
+    }
+
+    weightsFile.close();
+
+    printLatencySummary();
+}
+
+/**
+ * Parses a line of returns, one field per asset. Fields that are empty
+ * or unparseable are missing, as are fields beyond the end of the line,
+ * and fields beyond the number of assets are ignored.
+ *
+ * @param line - The line of returns.
+ * @return The return of every asset on the day.
+ **/
+vector<double> LiveSession::parseReturns(const string &line) const
+{
+    vector<double> dayReturns(numOfAssets, NAN);
+
+    CsvScanner scanner(line.data(), line.data() + line.size());
+    const char *fieldBegin;
+    const char *fieldEnd;
+
+    if (scanner.nextLine())
+    {
+        for (int assetIdx = 0; assetIdx < numOfAssets && scanner.nextField(fieldBegin, fieldEnd); assetIdx++)
+        {
+            dayReturns[assetIdx] = parseReturn(fieldBegin, fieldEnd);
+        }
+    }
+
+    return dayReturns;
+}
+
+/**
+ * Returns the panel of every return seen, the history included, or of
+ * the window onwards for a session restored from a snapshot.
+ *
+ * @return The returns panel.
+ **/
+const ReturnsPanel &LiveSession::getReturnsPanel() const
+{
+    return returnsPanel;
+}
+
+/**
+ * Returns the portfolio weights of the latest solve.
+ *
+ * @return The optimal portfolio weights, one row per target return, or
+ *         none if the window has never been full.
+ **/
+const vector<vector<double> > &LiveSession::getPortfolioWeights() const
+{
+    return portfolioWeights;
+}
+
+/**
+ * Returns the statistics of the latest solve.
+ *
+ * @return The statistics of the solve for each target return.
+ **/
+const vector<SolverStatistics> &LiveSession::getSolverStatistics() const
+{
+    return solverStatistics;
+}
+
+/**
+ * Returns the latency of every bar re-optimised so far.
+ *
+ * @return The latencies, in microseconds.
+ **/
+const vector<double> &LiveSession::getLatencies() const
+{
+    return latencies;
+}
+
+/**
+ * Prints the number of bars re-optimised, and the mean, median, 99th
+ * percentile and maximum of their latencies.
+ **/
+void LiveSession::printLatencySummary() const
+{
+    if (latencies.empty())
+    {
+        cout << "No bars were re-optimised." << endl;
+        return;
+    }
+
+    vector<double> sortedLatencies = latencies;
+    sort(sortedLatencies.begin(), sortedLatencies.end());
+
+    double totalLatency = 0;
+
+    for (int i = 0; i < sortedLatencies.size(); i++)
+    {
+        totalLatency += sortedLatencies[i];
+    }
+
+    int numOfBars = sortedLatencies.size();
+    double medianLatency = sortedLatencies[(numOfBars - 1) / 2];
+    double tailLatency = sortedLatencies[(int)ceil(0.99 * numOfBars) - 1];
+
+    cout << "Re-optimised " << numOfBars << " bars, latency (us): mean " << totalLatency / numOfBars << ", p50 " << medianLatency << ", p99 " << tailLatency << ", max " << sortedLatencies.back() << endl;
+}
+
+/***************** Private Methods *****************/
+
+/**
+ * Restores the state of the session from a snapshot file, exiting if
+ * it is not a valid snapshot or its sums do not match its returns.
+ *
+ * @param fileName - The name of the snapshot file.
+ **/
+void LiveSession::loadSnapshot(const string &fileName)
+{
+    ifstream file(fileName.c_str(), ios::binary);
+
+    if (!file.is_open())
+    {
+        cout << fileName << " missing\n";
+        exit(EXIT_FAILURE);
+    }
+
+    char magic[sizeof(snapshotMagic)];
+    int version = 0;
+    int numOfTargets = 0;
+    int numOfWindowDays = 0;
+    int savedNumOfIncompleteDays = 0;
+
+    file.read(magic, sizeof(magic));
+    file.read((char *)&version, sizeof(version));
+    file.read((char *)&numOfAssets, sizeof(numOfAssets));
+    file.read((char *)&windowSize, sizeof(windowSize));
+    file.read((char *)&numOfTargets, sizeof(numOfTargets));
+    file.read((char *)&numOfWindowDays, sizeof(numOfWindowDays));
+    file.read((char *)&savedNumOfIncompleteDays, sizeof(savedNumOfIncompleteDays));
+    file.read((char *)&numOfBarsSinceResync, sizeof(numOfBarsSinceResync));
+
+    if (!file || !equal(magic, magic + sizeof(magic), snapshotMagic) || version != snapshotVersion)
+    {
+        cout << fileName << " is not a valid live session snapshot." << endl;
+        exit(EXIT_FAILURE);
+    }
+
+    if (numOfAssets < 1 || windowSize < 2 || numOfTargets < 0 || numOfWindowDays < 0 || numOfWindowDays > windowSize)
+    {
+        cout << fileName << " has an invalid shape." << endl;
+        exit(EXIT_FAILURE);
+    }
+
+    targetReturns.resize(numOfTargets);
+    file.read((char *)targetReturns.data(), numOfTargets * sizeof(double));
+
+    vector<int64_t> dates(numOfWindowDays);
+    file.read((char *)dates.data(), numOfWindowDays * sizeof(int64_t));
+
+    returnsPanel = ReturnsPanel(numOfAssets, 0).toLayout(TIME_MAJOR);
+
+    vector<double> dayReturns(numOfAssets);
+
+    for (int t = 0; t < numOfWindowDays; t++)
+    {
+        file.read((char *)dayReturns.data(), numOfAssets * sizeof(double));
+        returnsPanel.appendReturns(dayReturns, dates[t]);
+    }
+
+    vector<double> savedSumsOfReturns(numOfAssets);
+    vector<vector<double> > savedSumsOfProducts(numOfAssets, vector<double>(numOfAssets));
+
+    shifts.resize(numOfAssets);
+    file.read((char *)shifts.data(), numOfAssets * sizeof(double));
+    file.read((char *)savedSumsOfReturns.data(), numOfAssets * sizeof(double));
+
+    for (int i = 0; i < numOfAssets; i++)
+    {
+        file.read((char *)&savedSumsOfProducts[i][i], (numOfAssets - i) * sizeof(double));
+    }
+
+    solutions.resize(numOfTargets);
+    portfolioWeights.clear();
+    solverStatistics.resize(numOfTargets);
+
+    for (int k = 0; k < numOfTargets && file; k++)
+    {
+        int solutionSize = 0;
+        file.read((char *)&solutionSize, sizeof(solutionSize));
+
+        if (solutionSize != 0 && solutionSize != numOfAssets + 2)
+        {
+            cout << fileName << " has an invalid solution." << endl;
+            exit(EXIT_FAILURE);
+        }
+
+        solutions[k].resize(solutionSize);
+        file.read((char *)solutions[k].data(), solutionSize * sizeof(double));
+        file.read((char *)&solverStatistics[k].numOfIterations, sizeof(solverStatistics[k].numOfIterations));
+        file.read((char *)&solverStatistics[k].residualNorm, sizeof(solverStatistics[k].residualNorm));
+
+        if (solutionSize > 0)
+        {
+            portfolioWeights.push_back(vector<double>(solutions[k].begin(), solutions[k].begin() + numOfAssets));
+        }
+    }
+
+    double ewmaHalfLife = 0;
+    file.read((char *)&ewmaHalfLife, sizeof(ewmaHalfLife));
+
+    if (file && ewmaHalfLife > 0)
+    {
+        ewmaEstimator.reset(new EwmaEstimator(numOfAssets, ewmaHalfLife));
+        ewmaEstimator->readState(file, fileName);
+    }
+
+    if (!file)
+    {
+        cout << fileName << " is truncated." << endl;
+        exit(EXIT_FAILURE);
+    }
+
+    file.close();
+
+    // Cross check the sums against the window's returns, about the saved
+    // shifts, so that a corrupt snapshot is not served from.
+    sumsOfReturns.resize(numOfAssets);
+    sumsOfProducts.assign(numOfAssets, vector<double>(numOfAssets));
+
+    int savedNumOfBarsSinceResync = numOfBarsSinceResync;
+    resyncSums(false);
+
+    bool isConsistent = numOfIncompleteDays == savedNumOfIncompleteDays;
+
+    for (int i = 0; i < numOfAssets && isConsistent; i++)
+    {
+        isConsistent = fabs(savedSumsOfReturns[i] - sumsOfReturns[i]) <= snapshotSumsTolerance * max(1.0, fabs(sumsOfReturns[i]));
+
+        for (int j = i; j < numOfAssets && isConsistent; j++)
+        {
+            isConsistent = fabs(savedSumsOfProducts[i][j] - sumsOfProducts[i][j]) <= snapshotSumsTolerance * max(1.0, fabs(sumsOfProducts[i][j]));
+        }
+    }
+
+    if (!isConsistent)
+    {
+        cout << fileName << " has sums that do not match its returns." << endl;
+        exit(EXIT_FAILURE);
+    }
+
+    sumsOfReturns = savedSumsOfReturns;
+    sumsOfProducts = savedSumsOfProducts;
+    numOfBarsSinceResync = savedNumOfBarsSinceResync;
+}
+
+/**
+ * Adds the returns of a day to, or removes them from, the window's sums.
+ * Days with a missing return are only counted.
+ *
+ * @param returnIdx - The index of the day in the panel.
+ * @param sign - 1 to add the day, or -1 to remove it.
+ **/
+void LiveSession::updateSums(int returnIdx, int sign)
+{
+    const double *dayReturns = returnsPanel.getDayReturns(returnIdx);
+
+    for (int i = 0; i < numOfAssets; i++)
+    {
+        if (isnan(dayReturns[i]))
+        {
+            numOfIncompleteDays += sign;
+            return;
+        }
+    }
+
+    vector<double> shiftedReturns(numOfAssets);
+
+    for (int i = 0; i < numOfAssets; i++)
+    {
+        shiftedReturns[i] = dayReturns[i] - shifts[i];
+    }
+
+    for (int i = 0; i < numOfAssets; i++)
+    {
+        double signedReturn = sign * shiftedReturns[i];
+        sumsOfReturns[i] += signedReturn;
+
+        for (int j = i; j < numOfAssets; j++)
+        {
+            sumsOfProducts[i][j] += signedReturn * shiftedReturns[j];
+        }
+    }
+}
+
+/**
+ * Recomputes the window's sums from its returns.
+ *
+ * @param isRecentred - Whether to first move the shifts to the means of the
+ *                      window's complete days, or else to keep them.
+ **/
+void LiveSession::resyncSums(bool isRecentred)
+{
+    int numOfReturns = returnsPanel.getNumOfReturns();
+    int windowStartIdx = max(0, numOfReturns - windowSize);
+
+    if (isRecentred)
+    {
+        int numOfCompleteDays = 0;
+
+        fill(shifts.begin(), shifts.end(), 0);
+
+        for (int t = windowStartIdx; t < numOfReturns; t++)
+        {
+            const double *dayReturns = returnsPanel.getDayReturns(t);
+
+            if (any_of(dayReturns, dayReturns + numOfAssets, [](double value) { return isnan(value); }))
+            {
+                continue;
+            }
+
+            for (int i = 0; i < numOfAssets; i++)
+            {
+                shifts[i] += dayReturns[i];
+            }
+
+            numOfCompleteDays++;
+        }
+
+        for (int i = 0; i < numOfAssets && numOfCompleteDays > 0; i++)
+        {
+            shifts[i] /= numOfCompleteDays;
+        }
+    }
+
+    fill(sumsOfReturns.begin(), sumsOfReturns.end(), 0);
+
+    for (int i = 0; i < numOfAssets; i++)
+    {
+        fill(sumsOfProducts[i].begin(), sumsOfProducts[i].end(), 0);
+    }
+
+    numOfIncompleteDays = 0;
+    numOfBarsSinceResync = 0;
+
+    for (int t = windowStartIdx; t < numOfReturns; t++)
+    {
+        updateSums(t, 1);
+    }
+}
+
+/**
+ * Estimates the mean returns and covariance matrix: the EWMA estimator's,
+ * if the session has one, or else the window's, from the sums if every
+ * day of it is complete.
+ *
+ * @param meanReturns - Populated with the column vector of mean returns.
+ * @param covarianceMatrix - Populated with the covariance matrix.
+ **/
+void LiveSession::estimateSampleStatistics(vector<vector<double> > &meanReturns, vector<vector<double> > &covarianceMatrix) const
+{
+    if (ewmaEstimator)
+    {
+        meanReturns = ewmaEstimator->getMeanReturns();
+        covarianceMatrix = ewmaEstimator->getCovarianceMatrix();
+        return;
+    }
+
+    int windowStartIdx = returnsPanel.getNumOfReturns() - windowSize;
+
+    if (numOfIncompleteDays > 0)
+    {
+        vector<vector<double> > windowReturnsMatrix(numOfAssets, vector<double>(windowSize));
+
+        for (int t = 0; t < windowSize; t++)
+        {
+            const double *dayReturns = returnsPanel.getDayReturns(windowStartIdx + t);
+
+            for (int i = 0; i < numOfAssets; i++)
+            {
+                windowReturnsMatrix[i][t] = dayReturns[i];
+            }
+        }
+
+        estimateMeanReturnsAndCovarianceMatrix(windowReturnsMatrix, 0, windowSize - 1, meanReturns, covarianceMatrix);
+        return;
+    }
+
+    // With d_i = r_i - shift_i, mean(i) = shift_i + sum(d_i) / n and
+    // cov(i, j) = (sum(d_i * d_j) - sum(d_i) * sum(d_j) / n) / (n - 1). The
+    // shifts are near the means, so the subtraction cancels little.
+    double numberOfDays = windowSize;
+
+    meanReturns.assign(numOfAssets, vector<double>(1));
+    covarianceMatrix.assign(numOfAssets, vector<double>(numOfAssets));
+
+    for (int i = 0; i < numOfAssets; i++)
+    {
+        meanReturns[i][0] = shifts[i] + sumsOfReturns[i] / numberOfDays;
+
+        for (int j = i; j < numOfAssets; j++)
+        {
+            covarianceMatrix[i][j] = (sumsOfProducts[i][j] - sumsOfReturns[i] * sumsOfReturns[j] / numberOfDays) / (numberOfDays - 1);
+            covarianceMatrix[j][i] = covarianceMatrix[i][j];
+        }
+    }
+}
+
+/**
+ * Re-optimises the portfolio of every target return over the window.
+ **/
+void LiveSession::optimise()
+{
+    vector<vector<double> > meanReturns;
+    vector<vector<double> > covarianceMatrix;
+
+    estimateSampleStatistics(meanReturns, covarianceMatrix);
+
+    portfolioWeights = model.calculatePortfolioWeights(meanReturns, covarianceMatrix, targetReturns, solutions, &solverStatistics);
+}
@@ -0,0 +1,242 @@
+#ifndef LiveSession_h
+#define LiveSession_h
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <math.h>
+#include <memory>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <vector>
+#include "csv_scanner.h"
+#include "ewma_estimator.h"
+#include "markowitz_model.h"
+#include "read_data.h"
+#include "returns_panel.h"
+
+using namespace std;
+
+/**
+ * A live session re-optimises the portfolios of a set of target returns as
+ * each new day (bar) of returns arrives, over a rolling window of the most
+ * recent days, without reloading the returns or re-estimating the window
+ * from scratch.
+ *
+ * The session holds the returns in a growing time major panel, and keeps
+ * the sums of returns and of products of returns over the complete days of
+ * the window, so that a new bar updates the mean returns and covariance in
+ * O(no_of_assets^2) rather than O(no_of_assets^2 x window_size). The returns
+ * are summed less a shift per asset, the window's mean when the sums were
+ * last recomputed, so that the covariance is not lost to cancellation when
+ * the returns' means are large beside their spread. The sums are recomputed
+ * exactly once a window's worth of bars, so that rounding error cannot
+ * build up, and a window with missing returns is estimated
+ * pairwise from the window itself, as the backtester does. Each solve starts
+ * from the previous bar's solution for its target, which is close to the
+ * new one. The latency of every bar is measured, from the bar's returns to
+ * its weights.
+ *
+ * The risk inputs may instead be estimated by an EWMA estimator, which
+ * weights every day seen, the history included, by its recency rather than
+ * by whether it is in the window. The window then only sets how many days
+ * are seen before the first solve.
+ *
+ * The state of a session, i.e. the window's returns and sums, the EWMA
+ * estimator if any and the latest solutions, can be saved to a versioned binary snapshot, from which a
+ * restarted session carries on exactly where it left off, without the
+ * history of returns.
+ **/
+class LiveSession
+{
+public:
+    /**
+     * Constructs a live session over the given history of returns, which
+     * seeds the window. If the history fills the window, the portfolios are
+     * optimised straight away, so that the first bar is solved warm.
+     *
+     * @param model - The model to optimise with. Must outlive the session.
+     * @param history - The returns up to the start of the session.
+     * @param windowSize - The number of days in the rolling window.
+     * @param targetReturns - The desired returns to be attained by the optimal portfolios.
+     * @param ewmaHalfLife - The half life, in days, of an EWMA estimator to estimate
+     *                       the risk inputs with, or 0 to estimate them from the window.
+     **/
+    LiveSession(MarkowitzModel &model, const ReturnsPanel &history, int windowSize, const vector<double> &targetReturns, double ewmaHalfLife = 0);
+
+    /**
+     * Constructs a live session from a snapshot written by `saveSnapshot`.
+     * The snapshot's sums are checked against the window's returns, which
+     * the restored panel holds in place of the full history.
+     *
+     * @param model - The model to optimise with. Must outlive the session.
+     * @param snapshotFileName - The name of the snapshot file.
+     **/
+    LiveSession(MarkowitzModel &model, const string &snapshotFileName);
+
+    /**
+     * Enables snapshots, so that `run` saves the state of the session
+     * after each bar, ready for a restart.
+     *
+     * @param fileName - The name of the snapshot file.
+     **/
+    void enableSnapshots(const string &fileName);
+
+    /**
+     * Saves the state of the session to a snapshot file. The snapshot is
+     * written aside and renamed over the file, so that the file is always
+     * a complete snapshot.
+     *
+     * @param fileName - The name of the snapshot file.
+     **/
+    void saveSnapshot(const string &fileName) const;
+
+    /**
+     * Appends a bar of returns, rolls the window forward and, once the
+     * window is full, re-optimises the portfolio of every target return.
+     *
+     * @param dayReturns - The return of every asset on the day, with missing returns as NaN.
+     * @return True if the portfolios were re-optimised.
+     **/
+    bool appendReturns(const vector<double> &dayReturns);
+
+    /**
+     * Appends a bar for each line of the given input until it ends, writing
+     * the portfolio weights of every bar to a CSV file as soon as they are
+     * solved. Each line holds the returns of one day, one field per asset,
+     * e.g. as written by a feed to stdin or followed with `tail -f`. The
+     * weights are appended to any that the file already holds, e.g. from
+     * before a restart.
+     *
+     * @param input - The lines of returns.
+     * @param fileName - The name of the CSV file to write the weights to.
+     **/
+    void run(istream &input, const string &fileName);
+
+    /**
+     * Parses a line of returns, one field per asset. Fields that are empty
+     * or unparseable are missing, as are fields beyond the end of the line,
+     * and fields beyond the number of assets are ignored.
+     *
+     * @param line - The line of returns.
+     * @return The return of every asset on the day.
+     **/
+    vector<double> parseReturns(const string &line) const;
+
+    /**
+     * Returns the panel of every return seen, the history included, or of
+     * the window onwards for a session restored from a snapshot.
+     *
+     * @return The returns panel.
+     **/
+    const ReturnsPanel &getReturnsPanel() const;
+
+    /**
+     * Returns the portfolio weights of the latest solve.
+     *
+     * @return The optimal portfolio weights, one row per target return, or
+     *         none if the window has never been full.
+     **/
+    const vector<vector<double> > &getPortfolioWeights() const;
+
+    /**
+     * Returns the statistics of the latest solve.
+     *
+     * @return The statistics of the solve for each target return.
+     **/
+    const vector<SolverStatistics> &getSolverStatistics() const;
+
+    /**
+     * Returns the latency of every bar re-optimised so far.
+     *
+     * @return The latencies, in microseconds.
+     **/
+    const vector<double> &getLatencies() const;
+
+    /**
+     * Prints the number of bars re-optimised, and the mean, median, 99th
+     * percentile and maximum of their latencies.
+     **/
+    void printLatencySummary() const;
+
+private:
+    MarkowitzModel &model;
+    int windowSize;
+    vector<double> targetReturns;
+    int numOfAssets;
+
+    // Every return seen so far, stored time major so that a day appends.
+    ReturnsPanel returnsPanel;
+
+    // The sums of returns and the upper triangles of the sums of products
+    // of returns, over the complete days of the window, of the returns less
+    // their asset's shift.
+    vector<double> shifts;
+    vector<double> sumsOfReturns;
+    vector<vector<double> > sumsOfProducts;
+
+    // The number of days of the window with a missing return.
+    int numOfIncompleteDays;
+
+    // The number of bars since the sums were last recomputed exactly.
+    int numOfBarsSinceResync;
+
+    // The estimator of the risk inputs, updated with every day seen, or
+    // null if they are estimated from the window.
+    unique_ptr<EwmaEstimator> ewmaEstimator;
+
+    // The solutions of the latest solve, which warm start the next.
+    vector<vector<double> > solutions;
+    vector<vector<double> > portfolioWeights;
+    vector<SolverStatistics> solverStatistics;
+
+    vector<double> latencies;
+
+    // The snapshot file saved after each bar by `run`. Empty disables snapshots.
+    string snapshotFileName;
+
+    /**
+     * Restores the state of the session from a snapshot file, exiting if
+     * it is not a valid snapshot or its sums do not match its returns.
+     *
+     * @param fileName - The name of the snapshot file.
+     **/
+    void loadSnapshot(const string &fileName);
+
+    /**
+     * Adds the returns of a day to, or removes them from, the window's sums.
+     * Days with a missing return are only counted.
+     *
+     * @param returnIdx - The index of the day in the panel.
+     * @param sign - 1 to add the day, or -1 to remove it.
+     **/
+    void updateSums(int returnIdx, int sign);
+
+    /**
+     * Recomputes the window's sums from its returns.
+     *
+     * @param isRecentred - Whether to first move the shifts to the means of the
+     *                      window's complete days, or else to keep them.
+     **/
+    void resyncSums(bool isRecentred = true);
+
+    /**
+     * Estimates the mean returns and covariance matrix: the EWMA estimator's,
+     * if the session has one, or else the window's, from the sums if every
+     * day of it is complete.
+     *
+     * @param meanReturns - Populated with the column vector of mean returns.
+     * @param covarianceMatrix - Populated with the covariance matrix.
+     **/
+    void estimateSampleStatistics(vector<vector<double> > &meanReturns, vector<vector<double> > &covarianceMatrix) const;
+
+    /**
+     * Re-optimises the portfolio of every target return over the window.
+     **/
+    void optimise();
+};
+
+#endif
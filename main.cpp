@@ -1,33 +1,456 @@
+#include "backtest_sweep.h"
+#include "cached_portfolio_optimisation_model.h"
+#include "live_session.h"
 #include "markowitz_model.h"
 #include "markowitz_model_backtester.h"
 #include "read_data.h"
+#include "resampled_frontier.h"
+#include "returns_prefix_sums.h"
+#include "shard_launcher.h"
 #include "matrix.h"
 
 using namespace std;
 
-int main()
+/**
+ * Parses a comma separated list of numbers, e.g. "0.005,0.01,0.015".
+ *
+ * @param list - The list.
+ * @param values - Populated with the numbers.
+ * @return False if the list is empty or any of its numbers is unparseable.
+ **/
+bool parseList(const string &list, vector<double> &values)
 {
+    values.clear();
+
+    for (size_t start = 0; start <= list.size(); )
+    {
+        size_t end = min(list.find(',', start), list.size());
+        string field = list.substr(start, end - start);
+        char *fieldEnd = NULL;
+
+        values.push_back(strtod(field.c_str(), &fieldEnd));
+
+        if (field.empty() || *fieldEnd != '\0')
+        {
+            return false;
+        }
+
+        start = end + 1;
+    }
+
+    return !values.empty();
+}
+
+/**
+ * Parses a comma separated list of numbers of days, e.g. "50,100,150".
+ *
+ * @param list - The list.
+ * @param sizes - Populated with the numbers of days.
+ * @param minSize - The smallest number of days allowed.
+ * @return False if the list is empty or any of its numbers is not a whole number of at least `minSize`.
+ **/
+bool parseList(const string &list, vector<int> &sizes, int minSize)
+{
+    vector<double> values;
+
+    if (!parseList(list, values))
+    {
+        return false;
+    }
+
+    sizes.clear();
+
+    for (int i = 0; i < values.size(); i++)
+    {
+        if (values[i] != (int)values[i] || values[i] < minSize)
+        {
+            return false;
+        }
+
+        sizes.push_back(values[i]);
+    }
+
+    return true;
+}
+
+/**
+ * Runs a live session over the returns of new days as they arrive,
+ * writing their weights to live_weights.csv.
+ *
+ * @param liveSession - The live session.
+ * @param liveFileName - The file to read the new days from, or "-" for stdin.
+ * @param snapshotFileName - The file to snapshot the session to after each bar. Empty disables snapshots.
+ * @return The exit status.
+ **/
+int runLiveSession(LiveSession &liveSession, const string &liveFileName, const string &snapshotFileName)
+{
+    if (!snapshotFileName.empty())
+    {
+        liveSession.enableSnapshots(snapshotFileName);
+    }
+
+    if (liveFileName == "-")
+    {
+        liveSession.run(cin, "live_weights.csv");
+
+        return 0;
+    }
+
+    ifstream liveFile(liveFileName);
+
+    if (!liveFile.is_open())
+    {
+        cout << liveFileName << " missing\n";
+        return EXIT_FAILURE;
+    }
+
+    liveSession.run(liveFile, "live_weights.csv");
+
+    return 0;
+}
+
+int main(int argc, char *argv[])
+{
+    // The returns to backtest, as a CSV file or a returns panel file.
     string fileName = "asset_returns.csv";
-    int numOfAssets = 83;
-    int numOfReturns = 700;
+
+    // A returns panel file to convert the returns to, instead of backtesting,
+    // and the layout to store them in.
+    string panelFileName = "";
+    ReturnsLayout panelLayout = ASSET_MAJOR;
+
+    // Whether to store the returns as float32s, halving their memory. The
+    // kernels read them in place and accumulate in double precision. They
+    // are otherwise stored as the file stores them.
+    bool isSinglePrecision = false;
     int inSampleSize = 100;
     int outOfSampleSize = 12;
 
+    // The number of threads to backtest on; 0 means one per hardware thread,
+    // shared between the shards launched by --launch.
+    int numOfThreads = 0;
+
+    // How the in sample period moves between windows, and by how many days;
+    // 0 steps by the out of sample size.
+    WalkForwardScheme scheme = ROLLING;
+    int stepSize = 0;
+
+    // The grid of configurations to sweep over, each axis given as a comma
+    // separated list; an empty axis takes the default grid's. A backtest
+    // takes its in and out of sample sizes and step from single valued lists.
+    vector<int> inSampleSizes;
+    vector<int> outOfSampleSizes;
+    vector<int> stepSizes;
+    vector<vector<double> > targetReturnGrids;
+
+    // The grid's arguments as given, to forward to shard processes.
+    vector<string> gridArguments;
+
+    // A file to checkpoint completed windows to, so that a killed run can be
+    // resumed by rerunning it. Shards checkpoint to files named after it.
+    // Empty disables checkpointing.
+    string checkpointFileName = "";
+
+    // A binary columnar file of the backtest results, including the portfolio
+    // weights, for analysis with numpy. Empty disables it.
+    string resultsStoreFileName = "backtest_results.bin";
+
+    // A file that the portfolios of the backtest windows are cached in, so
+    // that reruns sharing windows with earlier runs skip their solves.
+    // Empty disables the cache.
+    string cacheFileName = "";
+
+    // Whether to sweep over a grid of window sizes instead of running one backtest.
+    bool isSweep = false;
+
+    // The returns of new days to re-optimise on as they arrive, one line per
+    // day, instead of backtesting. "-" reads them from stdin, so that a file
+    // can be followed with `tail -f file | main --live -`.
+    string liveFileName = "";
+
+    // A snapshot of the live session, saved after each day. If it exists, the
+    // session restarts from it rather than from the returns. Empty disables it.
+    string snapshotFileName = "";
+
+    // The half life, in days, of an EWMA estimator for the live session to
+    // estimate the risk inputs with, instead of the window's sample; 0
+    // disables it. A restarted session keeps its snapshot's.
+    double ewmaHalfLife = 0;
+
+    // Whether to compute a resampled frontier over the last in sample period
+    // instead, from how many bootstrap paths of blocks of how many days.
+    bool isResampledFrontier = false;
+    int numOfPaths = 10000;
+    int blockSize = 5;
+    uint64_t seed = 42;
+
+    // The shard to run, when the windows are split over several processes,
+    // the number of shard processes to launch locally, and the number of
+    // finished shards to merge.
+    int shardIdx = 0;
+    int numOfShards = 1;
+    int numOfLaunchedShards = 0;
+    int numOfMergedShards = 0;
+
+    // Usage: main [--returns file] [--convert file [--layout asset|time|tiled]] [--single-precision] [--scheme rolling|expanding|anchored] [--in-sample n,...] [--out-of-sample n,...] [--step n,...] [--targets r,... ...] [--threads n] [--cache file] [--checkpoint file] [--sweep | --resample paths [block] | --live file|- [--snapshot file] [--ewma half-life]] [--shard i/n | --launch n | --merge n]
+    for (int i = 1; i < argc; i++)
+    {
+        string argument = argv[i];
+        bool hasValue = i + 1 < argc;
+        vector<double> targetReturns;
+
+        if (argument == "--sweep")
+        {
+            isSweep = true;
+        }
+        else if (argument == "--single-precision")
+        {
+            isSinglePrecision = true;
+        }
+        else if (argument == "--resample" && hasValue && (numOfPaths = atoi(argv[++i])) > 0)
+        {
+            isResampledFrontier = true;
+
+            // The block size is optional.
+            if (i + 1 < argc && atoi(argv[i + 1]) > 0)
+            {
+                blockSize = atoi(argv[++i]);
+            }
+        }
+        else if (argument == "--returns" && hasValue)
+        {
+            fileName = argv[++i];
+        }
+        else if (argument == "--live" && hasValue)
+        {
+            liveFileName = argv[++i];
+        }
+        else if (argument == "--cache" && hasValue)
+        {
+            cacheFileName = argv[++i];
+        }
+        else if (argument == "--checkpoint" && hasValue)
+        {
+            checkpointFileName = argv[++i];
+        }
+        else if (argument == "--snapshot" && hasValue)
+        {
+            snapshotFileName = argv[++i];
+        }
+        else if (argument == "--ewma" && hasValue && (ewmaHalfLife = atof(argv[++i])) > 0)
+        {
+            continue;
+        }
+        else if (argument == "--convert" && hasValue)
+        {
+            panelFileName = argv[++i];
+        }
+        else if (argument == "--layout" && hasValue && (string(argv[i + 1]) == "asset" || string(argv[i + 1]) == "time" || string(argv[i + 1]) == "tiled"))
+        {
+            string layout = argv[++i];
+            panelLayout = layout == "asset" ? ASSET_MAJOR : layout == "time" ? TIME_MAJOR : TILED;
+        }
+        else if (argument == "--scheme" && hasValue && (string(argv[i + 1]) == "rolling" || string(argv[i + 1]) == "expanding" || string(argv[i + 1]) == "anchored"))
+        {
+            string schemeName = argv[++i];
+            scheme = schemeName == "rolling" ? ROLLING : schemeName == "expanding" ? EXPANDING : ANCHORED;
+        }
+        else if (argument == "--in-sample" && hasValue && parseList(argv[i + 1], inSampleSizes, 2))
+        {
+            gridArguments.push_back(argument);
+            gridArguments.push_back(argv[++i]);
+        }
+        else if (argument == "--out-of-sample" && hasValue && parseList(argv[i + 1], outOfSampleSizes, 2))
+        {
+            gridArguments.push_back(argument);
+            gridArguments.push_back(argv[++i]);
+        }
+        else if (argument == "--step" && hasValue && parseList(argv[i + 1], stepSizes, 0))
+        {
+            gridArguments.push_back(argument);
+            gridArguments.push_back(argv[++i]);
+        }
+        else if (argument == "--targets" && hasValue && parseList(argv[i + 1], targetReturns))
+        {
+            // Each list of target returns is a grid of its own.
+            targetReturnGrids.push_back(targetReturns);
+            gridArguments.push_back(argument);
+            gridArguments.push_back(argv[++i]);
+        }
+        else if (argument == "--shard" && hasValue && sscanf(argv[++i], "%d/%d", &shardIdx, &numOfShards) == 2 && numOfShards > 0 && shardIdx >= 0 && shardIdx < numOfShards)
+        {
+            continue;
+        }
+        else if (argument == "--threads" && hasValue && (numOfThreads = atoi(argv[++i])) > 0)
+        {
+            continue;
+        }
+        else if (argument == "--launch" && hasValue && (numOfLaunchedShards = atoi(argv[++i])) > 0)
+        {
+            continue;
+        }
+        else if (argument == "--merge" && hasValue && (numOfMergedShards = atoi(argv[++i])) > 0)
+        {
+            continue;
+        }
+        else
+        {
+            cout << "Usage: " << argv[0] << " [--returns file] [--convert file [--layout asset|time|tiled]] [--single-precision] [--scheme rolling|expanding|anchored] [--in-sample n,...] [--out-of-sample n,...] [--step n,...] [--targets r,... ...] [--threads n] [--cache file] [--checkpoint file] [--sweep | --resample paths [block] | --live file|- [--snapshot file] [--ewma half-life]] [--shard i/n | --launch n | --merge n]" << endl;
+            return EXIT_FAILURE;
+        }
+    }
+
+    if (isResampledFrontier && (isSweep || !liveFileName.empty() || numOfShards > 1 || numOfLaunchedShards > 0 || numOfMergedShards > 0))
+    {
+        cout << "A resampled frontier runs on its own, in one process." << endl;
+        return EXIT_FAILURE;
+    }
+
+    if (ewmaHalfLife > 0 && liveFileName.empty())
+    {
+        cout << "Only a live session takes an EWMA half life." << endl;
+        return EXIT_FAILURE;
+    }
+
+    if (!isSweep && (inSampleSizes.size() > 1 || outOfSampleSizes.size() > 1 || stepSizes.size() > 1))
+    {
+        cout << "Only a sweep takes more than one in sample size, out of sample size or step." << endl;
+        return EXIT_FAILURE;
+    }
+
+    if (!isSweep && targetReturnGrids.size() > 1)
+    {
+        cout << "Only a sweep takes more than one list of target returns." << endl;
+        return EXIT_FAILURE;
+    }
+
+    // Without --targets, every mode solves for the default grid of target returns.
+    if (targetReturnGrids.empty())
+    {
+        targetReturnGrids.push_back(MarkowitzModelBacktester::getDefaultTargetReturns());
+    }
+
+    const vector<double> &targetReturns = targetReturnGrids[0];
+
+    inSampleSize = inSampleSizes.empty() ? inSampleSize : inSampleSizes[0];
+    outOfSampleSize = outOfSampleSizes.empty() ? outOfSampleSize : outOfSampleSizes[0];
+    stepSize = stepSizes.empty() ? stepSize : stepSizes[0];
+
+    // Run every shard as a local process, then merge their results.
+    if (numOfLaunchedShards > 0)
+    {
+        vector<string> shardArguments;
+
+        shardArguments.push_back("--returns");
+        shardArguments.push_back(fileName);
+
+        // The shards run at once, so they split the threads between them
+        // rather than each taking one per hardware thread.
+        int numOfShardThreads = numOfThreads > 0 ? numOfThreads : max(1, ThreadPool::resolveNumOfThreads(0) / numOfLaunchedShards);
+
+        shardArguments.push_back("--threads");
+        shardArguments.push_back(to_string(numOfShardThreads));
+
+        if (isSinglePrecision)
+        {
+            shardArguments.push_back("--single-precision");
+        }
+
+        const char *schemeNames[] = {"rolling", "expanding", "anchored"};
+
+        shardArguments.push_back("--scheme");
+        shardArguments.push_back(schemeNames[scheme]);
+        shardArguments.insert(shardArguments.end(), gridArguments.begin(), gridArguments.end());
+
+        if (!cacheFileName.empty())
+        {
+            shardArguments.push_back("--cache");
+            shardArguments.push_back(cacheFileName);
+        }
+
+        if (!checkpointFileName.empty())
+        {
+            shardArguments.push_back("--checkpoint");
+            shardArguments.push_back(checkpointFileName);
+        }
+
+        if (isSweep)
+        {
+            shardArguments.push_back("--sweep");
+        }
+
+        if (!runShardProcesses(argv[0], numOfLaunchedShards, shardArguments))
+        {
+            return EXIT_FAILURE;
+        }
+
+        numOfMergedShards = numOfLaunchedShards;
+    }
+
     // string fileName = "asset_returns_small.csv";
-    // int numOfAssets = 5;
-    // int numOfReturns = 10;
 
     // // Warning - you get some ridicously weights with this CSV file.
     // // These "returns" in this file are all >> 1. Was used for debugging
     // // in the early stages of this project.
     // string fileName = "dummy_returns.csv";
-    // int numOfAssets = 4;
-    // int numOfReturns = 5;
 
-    // A matrix to store the return data.
-    vector<vector<double> > returnsMatrix = readData(fileName, numOfAssets, numOfReturns);
+    // A live session restarted from its snapshot needs none of the history.
+    if (!liveFileName.empty() && !snapshotFileName.empty() && ifstream(snapshotFileName).good())
+    {
+        chrono::steady_clock::time_point startTime = chrono::steady_clock::now();
+
+        MarkowitzModel liveModel;
+        LiveSession liveSession(liveModel, snapshotFileName);
+
+        cout << "Restored the live session from " << snapshotFileName << " in " << chrono::duration<double, milli>(chrono::steady_clock::now() - startTime).count() << " ms" << endl;
+
+        int status = runLiveSession(liveSession, liveFileName, snapshotFileName);
+        liveModel.printWarnings();
+
+        return status;
+    }
+
+    // The return data, whose dimensions are read from the file.
+    ReturnsPanel returnsPanel = isSinglePrecision ? readReturnsPanel(fileName, numOfThreads).toPrecision(FLOAT32_RETURNS) : readReturnsPanel(fileName, numOfThreads);
+    int numOfAssets = returnsPanel.getNumOfAssets();
+    int numOfReturns = returnsPanel.getNumOfReturns();
+
+    cout << "Loaded " << numOfAssets << " assets x " << numOfReturns << " returns from " << fileName << endl;
+
+    if (!panelFileName.empty())
+    {
+        writeReturnsPanelFile(returnsPanel.toLayout(panelLayout), panelFileName);
+        cout << "Wrote the returns panel to " << panelFileName << endl;
+
+        return 0;
+    }
+
+    // An asset's returns in a tiled panel are not a fixed stride apart, so
+    // the kernels read such a panel transposed. Any other panel, mapped or
+    // not, is read in place.
+    if (returnsPanel.getLayout() == TILED)
+    {
+        returnsPanel = returnsPanel.toLayout(ASSET_MAJOR);
+    }
+
+    const ReturnsView returnsMatrix = returnsPanel.getView();
+
+    // Index the returns once, so that sample means and covariances
+    // can be looked up rather than recomputed for every window.
+    ReturnsPrefixSums returnsPrefixSums(returnsMatrix, true);
+
+    MarkowitzModel model(&returnsPrefixSums);
 
-    MarkowitzModel model;
+    // The model that backtests solve with, which looks portfolios up in the
+    // cache before solving them.
+    unique_ptr<CachedPortfolioOptimisationModel> cachedModel;
+    PortfolioOptimisationModel *backtestModel = &model;
+
+    if (!cacheFileName.empty())
+    {
+        cachedModel.reset(new CachedPortfolioOptimisationModel(model, cacheFileName));
+        backtestModel = cachedModel.get();
+    }
     double targetReturn = 0.005;
     int returnsStartIdx = 0;
     int returnsEndIdx = 4;
@@ -37,8 +460,109 @@ int main()
     // cout << "The optimal weights are: " << endl;
     // printRowVector(weights);
 
-    MarkowitzModelBacktester backtester;
-    backtester.evaluatePerformance(returnsMatrix, model, inSampleSize, outOfSampleSize);
+    if (!liveFileName.empty())
+    {
+        LiveSession liveSession(model, returnsPanel, inSampleSize, targetReturns, ewmaHalfLife);
+
+        int status = runLiveSession(liveSession, liveFileName, snapshotFileName);
+        model.printWarnings();
+
+        return status;
+    }
+
+    if (isSweep)
+    {
+        if (inSampleSizes.empty())
+        {
+            inSampleSizes = {50, 100, 150, 200};
+        }
+
+        if (outOfSampleSizes.empty())
+        {
+            outOfSampleSizes = {6, 12, 24};
+        }
+
+        if (stepSizes.empty())
+        {
+            stepSizes = {0};
+        }
+
+        vector<SweepConfig> configs = BacktestSweep::createGrid(inSampleSizes, outOfSampleSizes, stepSizes, targetReturnGrids, scheme);
+        BacktestSweep sweep(numOfThreads);
+
+        // Enabled before merging, as the shard files are named after the checkpoint.
+        if (!checkpointFileName.empty())
+        {
+            sweep.enableCheckpointing(checkpointFileName);
+        }
+
+        if (numOfMergedShards > 0)
+        {
+            sweep.mergeShards(returnsMatrix, *backtestModel, configs, numOfMergedShards, "backtest_sweep.csv");
+
+            return 0;
+        }
+
+        if (numOfShards > 1)
+        {
+            sweep.enableSharding(shardIdx, numOfShards);
+        }
+
+        sweep.run(returnsPanel, *backtestModel, configs, "backtest_sweep.csv");
+        model.printWarnings();
+
+        if (cachedModel)
+        {
+            cachedModel->printStatistics();
+        }
+
+        return 0;
+    }
+
+    if (isResampledFrontier)
+    {
+        ResampledFrontier resampledFrontier(numOfPaths, blockSize, seed, numOfThreads);
+        vector<vector<double> > resampledWeights = resampledFrontier.calculatePortfolioWeights(returnsMatrix, model, numOfReturns - inSampleSize, numOfReturns - 1, targetReturns);
+        resampledFrontier.writeToCsv(resampledWeights, targetReturns, "resampled_frontier_weights.csv");
+        cout << "Wrote the resampled frontier of " << numOfPaths << " paths to resampled_frontier_weights.csv" << endl;
+        model.printWarnings();
+
+        return 0;
+    }
+
+    MarkowitzModelBacktester backtester(numOfThreads, scheme, stepSize);
+    backtester.setTargetReturns(targetReturns);
+
+    if (!resultsStoreFileName.empty())
+    {
+        backtester.enableResultsStore(resultsStoreFileName);
+    }
+
+    // Enabled before merging, as the shard files are named after the checkpoint.
+    if (!checkpointFileName.empty())
+    {
+        backtester.enableCheckpointing(checkpointFileName);
+    }
+
+    if (numOfMergedShards > 0)
+    {
+        backtester.mergeShards(returnsMatrix, *backtestModel, inSampleSize, outOfSampleSize, numOfMergedShards);
+
+        return 0;
+    }
+
+    if (numOfShards > 1)
+    {
+        backtester.enableSharding(shardIdx, numOfShards);
+    }
+
+    backtester.evaluatePerformance(returnsPanel, *backtestModel, inSampleSize, outOfSampleSize);
+    model.printWarnings();
+
+    if (cachedModel)
+    {
+        cachedModel->printStatistics();
+    }
 
     return 0;
 }
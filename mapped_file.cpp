@@ -0,0 +1,73 @@
+#include "mapped_file.h"
+
+/**
+ * Maps the given file, exiting if it cannot be opened.
+ *
+ * @param fileName - The name of the file.
+ **/
+MappedFile::MappedFile(const string &fileName)
+{
+    data = NULL;
+    size = 0;
+
+    int fileDescriptor = open(fileName.c_str(), O_RDONLY);
+    struct stat fileStatus;
+
+    if (fileDescriptor < 0 || fstat(fileDescriptor, &fileStatus) != 0)
+    {
+        cout << fileName << " missing\n";
+        exit(EXIT_FAILURE);
+    }
+
+    size = fileStatus.st_size;
+
+    // An empty file cannot be mapped, and needs no mapping.
+    if (size > 0)
+    {
+        void *mapping = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fileDescriptor, 0);
+
+        if (mapping == MAP_FAILED)
+        {
+            cout << "Could not map " << fileName << " into memory." << endl;
+            exit(EXIT_FAILURE);
+        }
+
+        // The file is mostly read front to back, so ask for aggressive read ahead.
+        madvise(mapping, size, MADV_SEQUENTIAL);
+        data = (const char *)mapping;
+    }
+
+    // The mapping stays valid once the descriptor is closed.
+    close(fileDescriptor);
+}
+
+/**
+ * Unmaps the file.
+ **/
+MappedFile::~MappedFile()
+{
+    if (data != NULL)
+    {
+        munmap((void *)data, size);
+    }
+}
+
+/**
+ * Returns the first byte of the file.
+ *
+ * @return The start of the mapping, or NULL if the file is empty.
+ **/
+const char *MappedFile::getData() const
+{
+    return data;
+}
+
+/**
+ * Returns the size of the file.
+ *
+ * @return The number of bytes in the file.
+ **/
+size_t MappedFile::getSize() const
+{
+    return size;
+}
@@ -0,0 +1,57 @@
+#ifndef MappedFile_h
+#define MappedFile_h
+
+#include <fcntl.h>
+#include <iostream>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace std;
+
+/**
+ * A read only memory mapping of a whole file. The file's pages are read in
+ * by the kernel as they are touched, with no copy into a user space buffer.
+ **/
+class MappedFile
+{
+public:
+    /**
+     * Maps the given file, exiting if it cannot be opened.
+     *
+     * @param fileName - The name of the file.
+     **/
+    MappedFile(const string &fileName);
+
+    /**
+     * Unmaps the file.
+     **/
+    ~MappedFile();
+
+    /**
+     * Returns the first byte of the file.
+     *
+     * @return The start of the mapping, or NULL if the file is empty.
+     **/
+    const char *getData() const;
+
+    /**
+     * Returns the size of the file.
+     *
+     * @return The number of bytes in the file.
+     **/
+    size_t getSize() const;
+
+private:
+    const char *data;
+    size_t size;
+
+    // The mapping owns the file's memory, so it may not be copied.
+    MappedFile(const MappedFile &);
+    MappedFile &operator=(const MappedFile &);
+};
+
+#endif
@@ -2,6 +2,22 @@
 
 /***************** Public Methods *****************/
 
+/**
+ * Constructs a Markowitz Model.
+ * 
+ * @param returnsPrefixSums - Optional prefix sums over the returns matrix, used to
+ *                            estimate the mean returns and covariance of a sample
+ *                            without sweeping over it. Must outlive the model.
+ **/
+MarkowitzModel::MarkowitzModel(const ReturnsPrefixSums *returnsPrefixSums)
+{
+    this->returnsPrefixSums = returnsPrefixSums;
+    this->numOfSolves = 0;
+    this->numOfUnconvergedSolves = 0;
+    this->numOfSolvesWithExcludedAssets = 0;
+    this->maxNumOfExcludedAssets = 0;
+}
+
 /**
  * Calculates and returns the optimatal portfolio weights for the
  * given subsection of time-indexed returns, as indicated by the
@@ -13,96 +29,574 @@
  * @param targetReturn - The desired return to be attained by the optimal portfolio.
  * @return The optimal portfolio weights.
  **/
-vector<double> MarkowitzModel::calculatePortfolioWeights(const vector<vector<double> > &returnsMatrix, int returnsStartIdx, int returnsEndIdx, double targetReturn)
+vector<double> MarkowitzModel::calculatePortfolioWeights(const ReturnsView &returnsMatrix, int returnsStartIdx, int returnsEndIdx, double targetReturn)
+{
+    vector<vector<double> > meanReturns;
+    vector<vector<double> > covarianceMatrix;
+
+    estimateSampleStatistics(returnsMatrix, returnsStartIdx, returnsEndIdx, meanReturns, covarianceMatrix);
+
+    return calculatePortfolioWeights(meanReturns, covarianceMatrix, targetReturn);
+}
+
+/**
+ * Calculates and returns the optimal portfolio weights for each of the
+ * given target returns. The sample statistics and the matrix Q are built
+ * once and shared by the solves for every target, and only the lowest and
+ * highest targets are solved for; see `solveForPortfolioWeights`.
+ * 
+ * @param returnsMatrix - The matrix of time-indexed returns.
+ * @param returnsStartIdx - The "first day" of the sample of returns.
+ * @param returnsEndIdx - The "last day" of the sample of returns.
+ * @param targetReturns - The desired returns to be attained by the optimal portfolios.
+ * @param solverStatistics - Optionally populated with the statistics of the conjugate
+ *                           gradient solve for each target return.
+ * @return The optimal portfolio weights, one row per target return.
+ **/
+vector<vector<double> > MarkowitzModel::calculatePortfolioWeights(const ReturnsView &returnsMatrix, int returnsStartIdx, int returnsEndIdx, const vector<double> &targetReturns, vector<SolverStatistics> *solverStatistics)
+{
+    vector<vector<double> > meanReturns;
+    vector<vector<double> > covarianceMatrix;
+
+    estimateSampleStatistics(returnsMatrix, returnsStartIdx, returnsEndIdx, meanReturns, covarianceMatrix);
+
+    return solveForPortfolioWeights(meanReturns, covarianceMatrix, targetReturns, NULL, solverStatistics);
+}
+
+/**
+ * Calculates and returns the optimal portfolio weights for the given
+ * estimates of the mean returns and covariance of returns. Allows
+ * alternative risk inputs, such as EWMA estimates, to be optimised.
+ * 
+ * @param meanReturns - The column vector of mean returns.
+ * @param covarianceMatrix - The covariance matrix of returns.
+ * @param targetReturn - The desired return to be attained by the optimal portfolio.
+ * @return The optimal portfolio weights.
+ **/
+vector<double> MarkowitzModel::calculatePortfolioWeights(const vector<vector<double> > &meanReturns, const vector<vector<double> > &covarianceMatrix, double targetReturn)
+{
+    vector<double> targetReturns(1, targetReturn);
+
+    return solveForPortfolioWeights(meanReturns, covarianceMatrix, targetReturns, NULL, NULL)[0];
+}
+
+/**
+ * Calculates and returns the optimal portfolio weights for each of the
+ * given target returns, from the given estimates of the mean returns and
+ * covariance of returns. Each solve starts from the given solution for its
+ * target, so that re-solving after the estimates change a little, e.g.
+ * when a window rolls forward by a day, takes few iterations. As with the
+ * other overloads, only the lowest and highest targets are solved for.
+ * 
+ * @param meanReturns - The column vector of mean returns.
+ * @param covarianceMatrix - The covariance matrix of returns.
+ * @param targetReturns - The desired returns to be attained by the optimal portfolios.
+ * @param solutions - The solutions x = (weights, multipliers) to start from, one per
+ *                    target return, which are populated with the solutions of these
+ *                    solves. Solves whose solution is empty start from equal weights.
+ * @param solverStatistics - Optionally populated with the statistics of the conjugate
+ *                           gradient solve for each target return.
+ * @return The optimal portfolio weights, one row per target return.
+ **/
+vector<vector<double> > MarkowitzModel::calculatePortfolioWeights(const vector<vector<double> > &meanReturns, const vector<vector<double> > &covarianceMatrix, const vector<double> &targetReturns, vector<vector<double> > &solutions, vector<SolverStatistics> *solverStatistics)
+{
+    solutions.resize(targetReturns.size());
+
+    return solveForPortfolioWeights(meanReturns, covarianceMatrix, targetReturns, &solutions, solverStatistics);
+}
+
+/**
+ * Calculates and returns the optimal portfolio weights using the
+ * current estimates of the given EWMA estimator as the risk input.
+ * 
+ * @param estimator - The EWMA estimator of mean returns and covariance.
+ * @param targetReturn - The desired return to be attained by the optimal portfolio.
+ * @return The optimal portfolio weights.
+ **/
+vector<double> MarkowitzModel::calculatePortfolioWeights(const EwmaEstimator &estimator, double targetReturn)
+{
+    vector<vector<double> > meanReturns = estimator.getMeanReturns();
+    vector<vector<double> > covarianceMatrix = estimator.getCovarianceMatrix();
+
+    return calculatePortfolioWeights(meanReturns, covarianceMatrix, targetReturn);
+}
+
+/**
+ * Mixes every parameter that the model's portfolios depend on into the
+ * given hash: the lagrange multipliers the solves start from, the solver's
+ * tolerance and iteration limit, and whether prefix sums estimate the
+ * samples' statistics.
+ * 
+ * @param hash - The hash to continue from.
+ * @return The hash.
+ **/
+uint64_t MarkowitzModel::hashParameters(uint64_t hash) const
+{
+    double parameters[] = {lagrangeMultiplierOne, lagrangeMultiplierTwo, toleranceThreshold, (double)maxNumOfIterationsPerRow, returnsPrefixSums != NULL ? 1.0 : 0.0};
+
+    return calculateFnv1aHash(parameters, sizeof(parameters), hash);
+}
+
+/**
+ * Returns the most iterations a solve may take per row of Q, which
+ * bounds the cost of a solve that does not converge.
+ * 
+ * @return The most iterations per row of Q.
+ **/
+int MarkowitzModel::getMaxNumOfIterationsPerRow() const
+{
+    return maxNumOfIterationsPerRow;
+}
+
+/**
+ * Prints a warning for the solves that stopped at the iteration limit
+ * before converging, and for those that excluded assets without
+ * estimates, if any, with how many there were. Meant to be called once,
+ * at the end of a run, rather than per solve.
+ **/
+void MarkowitzModel::printWarnings() const
+{
+    if (numOfUnconvergedSolves > 0)
+    {
+        cout << "Warning: " << numOfUnconvergedSolves << " of " << numOfSolves << " solves stopped at the iteration limit of " << maxNumOfIterationsPerRow << " per row of Q before converging; their residuals are in the solver statistics." << endl;
+    }
+
+    if (numOfSolvesWithExcludedAssets > 0)
+    {
+        cout << "Warning: " << numOfSolvesWithExcludedAssets << " of " << numOfSolves << " solves excluded up to " << maxNumOfExcludedAssets << " assets whose mean return or covariances could not be estimated from the portfolio." << endl;
+    }
+}
+
+/***************** Private Methods *****************/
+
+/**
+ * Estimates the mean returns and covariance matrix of the given
+ * subsection of time-indexed returns.
+ * 
+ * @param returnsMatrix - The matrix of time-indexed returns.
+ * @param returnsStartIdx - The "first day" of the sample of returns.
+ * @param returnsEndIdx - The "last day" of the sample of returns.
+ * @param meanReturns - Populated with the column vector of mean returns.
+ * @param covarianceMatrix - Populated with the covariance matrix.
+ **/
+void MarkowitzModel::estimateSampleStatistics(const ReturnsView &returnsMatrix, int returnsStartIdx, int returnsEndIdx, vector<vector<double> > &meanReturns, vector<vector<double> > &covarianceMatrix)
+{
+    if (returnsPrefixSums != NULL && returnsPrefixSums->isIndexOf(returnsMatrix) && returnsPrefixSums->hasCrossProducts() && !returnsPrefixSums->hasMissingReturns(returnsStartIdx, returnsEndIdx))
+    {
+        meanReturns = returnsPrefixSums->calculateMeanReturns(returnsStartIdx, returnsEndIdx);
+        covarianceMatrix = returnsPrefixSums->estimateCovarianceMatrix(returnsStartIdx, returnsEndIdx);
+    }
+    else
+    {
+        estimateMeanReturnsAndCovarianceMatrix(returnsMatrix, returnsStartIdx, returnsEndIdx, meanReturns, covarianceMatrix);
+    }
+}
+
+/**
+ * Calculates and returns the optimal portfolio weights for each of the
+ * given target returns from the given estimates, building Q once for all
+ * of them. Only b depends on the target return, so the optimal x is affine
+ * in it: given more than two targets, only the lowest and highest are
+ * solved for, and the others are interpolated between them, which costs
+ * one Q * x each, for their residuals, rather than a solve.
+ * 
+ * Assets whose mean return or covariances are NaN, e.g. for want of
+ * returns in the sample, are excluded from the portfolios, and given a
+ * weight of zero, so that the NaNs never reach the solver. The solves are
+ * counted towards `printWarnings`.
+ * 
+ * @param meanReturns - The column vector of mean returns.
+ * @param covarianceMatrix - The covariance matrix of returns.
+ * @param targetReturns - The desired returns to be attained by the optimal portfolios.
+ * @param solutions - Optionally, the solutions x = (weights, multipliers) to start from,
+ *                    one per target return, which are populated with the solutions of
+ *                    these solves. The weights of excluded assets are zero.
+ * @param solverStatistics - Optionally populated with the statistics of the conjugate
+ *                           gradient solve for each target return.
+ * @return The optimal portfolio weights, one row per target return.
+ **/
+vector<vector<double> > MarkowitzModel::solveForPortfolioWeights(const vector<vector<double> > &meanReturns, const vector<vector<double> > &covarianceMatrix, const vector<double> &targetReturns, vector<vector<double> > *solutions, vector<SolverStatistics> *solverStatistics)
+{
+    int numOfAssets = meanReturns.size();
+    vector<int> assetIdxs = findEstimatedAssets(meanReturns, covarianceMatrix);
+    int numOfEstimatedAssets = assetIdxs.size();
+
+    if (numOfEstimatedAssets == 0)
+    {
+        cout << "No asset has a mean return and covariances to optimise a portfolio of." << endl;
+        exit(EXIT_FAILURE);
+    }
+
+    // The optimal x is affine in the target return, as only b depends on it,
+    // so only the lowest and highest targets are solved for, and every other
+    // target's solution is interpolated between theirs.
+    int numOfTargetReturns = targetReturns.size();
+    int lowestTargetReturnIdx = min_element(targetReturns.begin(), targetReturns.end()) - targetReturns.begin();
+    int highestTargetReturnIdx = max_element(targetReturns.begin(), targetReturns.end()) - targetReturns.begin();
+    bool isInterpolated = numOfTargetReturns > 2 && targetReturns[highestTargetReturnIdx] > targetReturns[lowestTargetReturnIdx];
+    int numOfExcludedAssets = numOfAssets - numOfEstimatedAssets;
+
+    vector<vector<double> > Q;
+
+    if (numOfExcludedAssets == 0)
+    {
+        Q = calculateQ(meanReturns, covarianceMatrix, numOfAssets);
+    }
+    else
+    {
+        vector<vector<double> > estimatedMeanReturns(numOfEstimatedAssets, vector<double>(1));
+        vector<vector<double> > estimatedCovarianceMatrix(numOfEstimatedAssets, vector<double>(numOfEstimatedAssets));
+
+        for (int i = 0; i < numOfEstimatedAssets; i++)
+        {
+            estimatedMeanReturns[i][0] = meanReturns[assetIdxs[i]][0];
+
+            for (int j = 0; j < numOfEstimatedAssets; j++)
+            {
+                estimatedCovarianceMatrix[i][j] = covarianceMatrix[assetIdxs[i]][assetIdxs[j]];
+            }
+        }
+
+        Q = calculateQ(estimatedMeanReturns, estimatedCovarianceMatrix, numOfEstimatedAssets);
+
+        // Warned about once, by `printWarnings`, rather than per solve.
+        int maxNumOfExcludedAssets = this->maxNumOfExcludedAssets;
+
+        numOfSolvesWithExcludedAssets += isInterpolated ? 2 : numOfTargetReturns;
+
+        // Raise the most assets excluded, unless a concurrent solve has raised it further.
+        while (numOfExcludedAssets > maxNumOfExcludedAssets && !this->maxNumOfExcludedAssets.compare_exchange_weak(maxNumOfExcludedAssets, numOfExcludedAssets))
+        {
+        }
+    }
+
+    vector<SolverStatistics> statistics(numOfTargetReturns);
+
+    // The solutions over the estimated assets, each starting from its part
+    // of any given solution.
+    vector<vector<double> > estimatedSolutions(numOfTargetReturns);
+
+    for (int i = 0; i < numOfTargetReturns; i++)
+    {
+        if (isInterpolated && i != lowestTargetReturnIdx && i != highestTargetReturnIdx)
+        {
+            continue;
+        }
+
+        if (solutions != NULL && (*solutions)[i].size() == numOfAssets + 2)
+        {
+            for (int k = 0; k < numOfEstimatedAssets; k++)
+            {
+                estimatedSolutions[i].push_back((*solutions)[i][assetIdxs[k]]);
+            }
+
+            estimatedSolutions[i].push_back((*solutions)[i][numOfAssets]);
+            estimatedSolutions[i].push_back((*solutions)[i][numOfAssets + 1]);
+        }
+
+        solveForPortfolioWeights(Q, numOfEstimatedAssets, targetReturns[i], &statistics[i], &estimatedSolutions[i]);
+    }
+
+    if (isInterpolated)
+    {
+        const vector<double> &lowestSolution = estimatedSolutions[lowestTargetReturnIdx];
+        const vector<double> &highestSolution = estimatedSolutions[highestTargetReturnIdx];
+        double targetReturnRange = targetReturns[highestTargetReturnIdx] - targetReturns[lowestTargetReturnIdx];
+
+        for (int i = 0; i < numOfTargetReturns; i++)
+        {
+            if (i == lowestTargetReturnIdx || i == highestTargetReturnIdx)
+            {
+                continue;
+            }
+
+            double theta = (targetReturns[i] - targetReturns[lowestTargetReturnIdx]) / targetReturnRange;
+
+            estimatedSolutions[i].resize(numOfEstimatedAssets + 2);
+
+            for (int k = 0; k < numOfEstimatedAssets + 2; k++)
+            {
+                estimatedSolutions[i][k] = lowestSolution[k] + theta * (highestSolution[k] - lowestSolution[k]);
+            }
+
+            // An interpolated solution takes no iterations of its own, but it is
+            // only as good as the two it came from, so it reports its own
+            // residual, and the iteration limit if either solve reached it.
+            statistics[i].numOfIterations = 0;
+            statistics[i].residualNorm = calculateResidualNorm(Q, estimatedSolutions[i], numOfEstimatedAssets, targetReturns[i]);
+            statistics[i].hasReachedIterationLimit = statistics[lowestTargetReturnIdx].hasReachedIterationLimit || statistics[highestTargetReturnIdx].hasReachedIterationLimit;
+        }
+    }
+
+    // Spread the solutions back over every asset, with excluded assets weighted zero.
+    vector<vector<double> > portfolioWeights(numOfTargetReturns);
+
+    for (int i = 0; i < numOfTargetReturns; i++)
+    {
+        statistics[i].numOfExcludedAssets = numOfExcludedAssets;
+
+        vector<double> fullSolution(numOfAssets + 2, 0);
+
+        for (int k = 0; k < numOfEstimatedAssets; k++)
+        {
+            fullSolution[assetIdxs[k]] = estimatedSolutions[i][k];
+        }
+
+        fullSolution[numOfAssets] = estimatedSolutions[i][numOfEstimatedAssets];
+        fullSolution[numOfAssets + 1] = estimatedSolutions[i][numOfEstimatedAssets + 1];
+
+        portfolioWeights[i] = parseOutWeights(fullSolution, numOfAssets);
+
+        if (solutions != NULL)
+        {
+            (*solutions)[i] = move(fullSolution);
+        }
+    }
+
+    if (solverStatistics != NULL)
+    {
+        *solverStatistics = statistics;
+    }
+
+    return portfolioWeights;
+}
+
+/**
+ * Finds the assets that the given estimates can optimise a portfolio of:
+ * those whose mean return, variance and covariances with each other are
+ * not NaN. Assets whose own estimates are NaN are dropped first, then,
+ * while any covariance between the remaining assets is NaN, the asset
+ * with the most NaN covariances.
+ * 
+ * @param meanReturns - The column vector of mean returns.
+ * @param covarianceMatrix - The covariance matrix of returns.
+ * @return The indices of the assets, in order.
+ **/
+vector<int> MarkowitzModel::findEstimatedAssets(const vector<vector<double> > &meanReturns, const vector<vector<double> > &covarianceMatrix)
+{
+    int numOfAssets = meanReturns.size();
+    vector<bool> isEstimated(numOfAssets);
+
+    for (int i = 0; i < numOfAssets; i++)
+    {
+        isEstimated[i] = !isnan(meanReturns[i][0]) && !isnan(covarianceMatrix[i][i]);
+    }
+
+    // The number of NaN covariances of each asset with the other assets still in.
+    vector<int> numOfMissingCovariances(numOfAssets, 0);
+
+    for (int i = 0; i < numOfAssets; i++)
+    {
+        for (int j = i + 1; j < numOfAssets; j++)
+        {
+            if (isEstimated[i] && isEstimated[j] && isnan(covarianceMatrix[i][j]))
+            {
+                numOfMissingCovariances[i]++;
+                numOfMissingCovariances[j]++;
+            }
+        }
+    }
+
+    while (true)
+    {
+        int worstAssetIdx = max_element(numOfMissingCovariances.begin(), numOfMissingCovariances.end()) - numOfMissingCovariances.begin();
+
+        if (numOfAssets == 0 || numOfMissingCovariances[worstAssetIdx] == 0)
+        {
+            break;
+        }
+
+        isEstimated[worstAssetIdx] = false;
+        numOfMissingCovariances[worstAssetIdx] = 0;
+
+        for (int j = 0; j < numOfAssets; j++)
+        {
+            if (isEstimated[j] && isnan(covarianceMatrix[worstAssetIdx][j]))
+            {
+                numOfMissingCovariances[j]--;
+            }
+        }
+    }
+
+    vector<int> assetIdxs;
+
+    for (int i = 0; i < numOfAssets; i++)
+    {
+        if (isEstimated[i])
+        {
+            assetIdxs.push_back(i);
+        }
+    }
+
+    return assetIdxs;
+}
+
+/**
+ * Solves the system Q * x = b for the given target return with the
+ * conjugate gradient method, and returns the portfolio weights. The
+ * solve stops once |s| <= toleranceThreshold * |b|, or after
+ * maxNumOfIterationsPerRow iterations per row of Q, in which case it
+ * is counted towards `printWarnings`.
+ * 
+ * The iterations update flat vectors in place and compute Q * p once
+ * each, so that a solve allocates nothing after its set up.
+ * 
+ * @param Q - The matrix Q.
+ * @param numOfAssets - The number of assets in scope.
+ * @param targetReturn - The desired return to be attained by the optimal portfolio.
+ * @param statistics - Optionally populated with the statistics of the solve.
+ * @param solution - Optionally, the solution x = (weights, multipliers) to start
+ *                   from, which is populated with the solution of this solve. The
+ *                   solve starts from equal weights if it is empty.
+ * @return The optimal portfolio weights.
+ **/
+vector<double> MarkowitzModel::solveForPortfolioWeights(vector<vector<double> > &Q, int numOfAssets, double targetReturn, SolverStatistics *statistics, vector<double> *solution)
 {
-    int numOfAssets = returnsMatrix.size();
+    vector<vector<double> > x0;
 
-    vector<vector<double> > weights = initialisePortfolioWeights(numOfAssets);
-    vector<vector<double> > covarianceMatrix = estimateCovarianceMatrix(returnsMatrix, returnsStartIdx, returnsEndIdx);
-    vector<vector<double> > meanReturns = calculateMeanReturns(returnsMatrix, returnsStartIdx, returnsEndIdx);
+    // Initialise variables for the conjugate gradient method. A previous
+    // solution is usually close to the new one, and so needs few iterations.
+    if (solution != NULL && solution->size() == numOfAssets + 2)
+    {
+        x0 = convertFromRowToColumnVector(*solution);
+    }
+    else
+    {
+        x0 = initialiseX(initialisePortfolioWeights(numOfAssets), numOfAssets);
+    }
 
-    // Initialise variables for the conjugate gradient method.
-    vector<vector<double> > Q = calculateQ(meanReturns, returnsMatrix, returnsStartIdx, returnsEndIdx, numOfAssets);
-    vector<vector<double> > x = initialiseX(weights, numOfAssets);
     vector<vector<double> > b = calculateB(numOfAssets, targetReturn);
-    vector<vector<double> > s = subtractMatrices(b, multiplyMatrices(Q, x)); // s_0 = b - Q*x_0
-    vector<vector<double> > p = copyMatrix(s);
+    vector<vector<double> > s0 = subtractMatrices(b, multiplyMatrices(Q, x0)); // s_0 = b - Q*x_0
+
+    vector<double> x = convertFromColumnToRowVector(x0);
+    vector<double> s = convertFromColumnToRowVector(s0);
+    vector<double> p = s;
+    vector<double> Qp(s.size());
 
     double alpha = 0;
     double beta = 0;
     double sProduct = calculateSProduct(s); // s^T * s
     double prevSProduct = sProduct;
 
+    // The residual at which the solve has converged, squared, i.e.
+    // (toleranceThreshold * |b|)^2.
+    double convergedSProduct = toleranceThreshold * toleranceThreshold * calculateSProduct(convertFromColumnToRowVector(b));
+    int maxNumOfIterations = maxNumOfIterationsPerRow * (numOfAssets + 2);
+
     // Apply Conjugate Gradient Method.
-    for (int i = 0; sProduct > toleranceThreshold; i++)
+    int i = 0;
+
+    for (; sProduct > convergedSProduct && i < maxNumOfIterations; i++)
     {
-        alpha = calculateAlpha(Q, p, sProduct);
-        x = updateX(x, p, alpha);
+        calculateQp(Q, p, Qp);
+        alpha = calculateAlpha(p, Qp, sProduct);
+        updateX(x, p, alpha);
 
-        s = updateS(s, Q, p, alpha);
+        updateS(s, Qp, alpha);
         prevSProduct = sProduct;
         sProduct = calculateSProduct(s);
 
         beta = calculateBeta(sProduct, prevSProduct);
-        p = updateP(s, p, beta);
+        updateP(s, p, beta);
+    }
+
+    bool hasReachedIterationLimit = sProduct > convergedSProduct;
+
+    numOfSolves++;
+    numOfUnconvergedSolves += hasReachedIterationLimit;
+
+    if (statistics != NULL)
+    {
+        statistics->numOfIterations = i;
+        statistics->residualNorm = sqrt(sProduct);
+        statistics->hasReachedIterationLimit = hasReachedIterationLimit;
+    }
+
+    if (solution != NULL)
+    {
+        *solution = x;
     }
 
     return parseOutWeights(x, numOfAssets);
 }
 
-/***************** Private Methods *****************/
+/**
+ * Returns the norm of the residual b - Q * x of the given solution for the
+ * given target return.
+ * 
+ * @param Q - The matrix Q.
+ * @param x - The solution x = (weights, multipliers).
+ * @param numOfAssets - The number of assets in scope.
+ * @param targetReturn - The target return of the optimised portfolio.
+ * @return The norm of the residual.
+ **/
+double MarkowitzModel::calculateResidualNorm(const vector<vector<double> > &Q, const vector<double> &x, int numOfAssets, double targetReturn)
+{
+    vector<double> s(x.size());
+
+    calculateQp(Q, x, s);
+
+    for (int i = 0; i < s.size(); i++)
+    {
+        s[i] = -s[i];
+    }
+
+    // b is zero but for its last two entries.
+    s[numOfAssets] -= targetReturn;
+    s[numOfAssets + 1] -= 1;
+
+    return sqrt(calculateSProduct(s));
+}
 
 /**
- * Updates the column vector p.
+ * Updates the vector p in place, i.e. p = s + beta * p.
  * 
- * Dimensions: (no_of_assets + 2) x 1
+ * Dimensions: (no_of_assets + 2)
  * 
- * @param s - The column vector s.
- * @param p - The column vector s.
+ * @param s - The vector s.
+ * @param p - The vector p.
  * @param beta - The scalar value beta.
- * @return The updated column vector p.
  **/
-vector<vector<double> > MarkowitzModel::updateP(vector<vector<double> > &s, vector<vector<double> > &p, double beta)
+void MarkowitzModel::updateP(const vector<double> &s, vector<double> &p, double beta)
 {
-    vector<vector<double> > betaP = multiplyMatrixWithConstant(p, beta);
-
-    return addMatrices(s, betaP);
+    for (int i = 0; i < p.size(); i++)
+    {
+        p[i] = s[i] + p[i] * beta;
+    }
 }
 
 /**
- * Updates the column vector s.
+ * Updates the vector s in place, i.e. s = s - alpha * Q * p.
  * 
- * Dimensions: (no_of_assets + 2) x 1
+ * Dimensions: (no_of_assets + 2)
  * 
- * @param s - The column vector s.
- * @param Q - The matrix Q.
- * @param p - The column vector s.
+ * @param s - The vector s.
+ * @param Qp - The vector Q * p.
  * @param alpha - The scalar value alpha.
- * @return The updated column vector x.
  **/
-vector<vector<double> > MarkowitzModel::updateS(vector<vector<double> > &s, vector<vector<double> > &Q, vector<vector<double> > &p, double alpha)
+void MarkowitzModel::updateS(vector<double> &s, const vector<double> &Qp, double alpha)
 {
-    vector<vector<double> > Qp = multiplyMatrices(Q, p);
-    vector<vector<double> > alphaQp = multiplyMatrixWithConstant(Qp, alpha);
-
-    return subtractMatrices(s, alphaQp);
+    for (int i = 0; i < s.size(); i++)
+    {
+        s[i] = s[i] - Qp[i] * alpha;
+    }
 }
 
 /**
- * Updates the column vector x.
+ * Updates the vector x in place, i.e. x = x + alpha * p.
  * 
- * Dimensions: (no_of_assets + 2) x 1
+ * Dimensions: (no_of_assets + 2)
  * 
- * @param x - The column vector x.
- * @param p - The matrix p.
+ * @param x - The vector x.
+ * @param p - The vector p.
  * @param alpha - The scalar value alpha.
- * @return The updated column vector x.
  **/
-vector<vector<double> > MarkowitzModel::updateX(vector<vector<double> > &x, vector<vector<double> > &p, double alpha)
+void MarkowitzModel::updateX(vector<double> &x, const vector<double> &p, double alpha)
 {
-    vector<vector<double> > alphaP = multiplyMatrixWithConstant(p, alpha);
-
-    return addMatrices(x, alphaP);
+    for (int i = 0; i < x.size(); i++)
+    {
+        x[i] = x[i] + p[i] * alpha;
+    }
 }
 
 /**
@@ -120,31 +614,68 @@ double MarkowitzModel::calculateBeta(double sProduct, double prevSProduct)
 /**
  * Calculate the alpha in the conjugate gradient method.
  * 
- * @param Q - The matrix Q.
- * @param p - The matrix p.
+ * @param p - The vector p.
+ * @param Qp - The vector Q * p.
  * @param sProduct - the scalar value s^T * s.
  * @return The scalar value alpha.
  **/
-double MarkowitzModel::calculateAlpha(vector<vector<double> > &Q, vector<vector<double> > &p, double sProduct)
+double MarkowitzModel::calculateAlpha(const vector<double> &p, const vector<double> &Qp, double sProduct)
 {
-    vector<vector<double> > pTranspose = getMatrixTranspose(p);
-    vector<vector<double> > Qp = multiplyMatrices(Q, p);
-    double denominator = multiplyMatrices(pTranspose, Qp)[0][0];
+    double denominator = 0; // p^T * Q * p
+
+    for (int i = 0; i < p.size(); i++)
+    {
+        denominator += p[i] * Qp[i];
+    }
 
     return sProduct / denominator;
 }
 
 /**
- * Calculate the matrix multiplication of s transpose and s.
+ * Calculate the matrix-vector product Q * p.
  * 
- * @param s - The matrix s. Dimensions = (numOfAssets + 2) x 1.
+ * @param Q - The matrix Q.
+ * @param p - The vector p.
+ * @param Qp - Populated with the vector Q * p.
+ **/
+void MarkowitzModel::calculateQp(const vector<vector<double> > &Q, const vector<double> &p, vector<double> &Qp)
+{
+    int rank = p.size();
+
+    // Both operands are read through raw pointers, which spares the
+    // unoptimised build a call to vector::operator[] per multiply-add.
+    const double *pValues = &p[0];
+
+    for (int i = 0; i < rank; i++)
+    {
+        const double *qRow = &Q[i][0];
+        double qp = 0;
+
+        for (int k = 0; k < rank; k++)
+        {
+            qp += qRow[k] * pValues[k];
+        }
+
+        Qp[i] = qp;
+    }
+}
+
+/**
+ * Calculate the inner product of s with itself.
+ * 
+ * @param s - The vector s. Dimensions = (numOfAssets + 2).
  * @return The scalar value s^T * s.
  **/
-double MarkowitzModel::calculateSProduct(vector<vector<double> > &s)
+double MarkowitzModel::calculateSProduct(const vector<double> &s)
 {
-    vector<vector<double> > sTranspose = getMatrixTranspose(s);
+    double sProduct = 0;
 
-    return multiplyMatrices(sTranspose, s)[0][0]; // s^T * s
+    for (int i = 0; i < s.size(); i++)
+    {
+        sProduct += s[i] * s[i];
+    }
+
+    return sProduct; // s^T * s
 }
 
 /**
@@ -154,21 +685,17 @@ double MarkowitzModel::calculateSProduct(vector<vector<double> > &s)
  * Dimensions: (no_of_assets + 2) x (no_of_assets + 2)
  * 
  * @param meanReturns - The mean returns vector.
- * @param returnsMatrix - The matrix of time-indexed returns.
- * @param returnsStartIdx - The "first day" of the sample of returns.
- * @param returnsEndIdx - The "last day" of the sample of returns.
+ * @param covarianceMatrix - The covariance matrix of returns.
  * @param numOfAssets - The number of assets in scope.
  * @return The column vector of mean returns.
  **/
-vector<vector<double> > MarkowitzModel::calculateQ(const vector<vector<double> > &meanReturns, const vector<vector<double> > &returnsMatrix, int returnsStartIdx, int returnsEndIdx, int numOfAssets)
+vector<vector<double> > MarkowitzModel::calculateQ(const vector<vector<double> > &meanReturns, const vector<vector<double> > &covarianceMatrix, int numOfAssets)
 {
     int rank = numOfAssets + 2;
 
     vector<vector<double> > Q;
     Q.resize(rank);
 
-    vector<vector<double> > covarianceMatrix = estimateCovarianceMatrix(returnsMatrix, returnsStartIdx, returnsEndIdx);
-
     for (int i = 0; i < rank; i++)
     {
         vector<double> qRow;
@@ -289,35 +816,27 @@ vector<vector<double> > MarkowitzModel::calculateB(int numOfAssets, double targe
  * Check to see if the portfolio weights sum to zero.
  * Print an appropriate message to STDOUT.
  * 
- * @param x = The column vector x.
+ * @param x = The vector x.
  * @param numOfAssets - The number of assets in scope.
  **/
-void MarkowitzModel::checkWeights(vector<vector<double> > &x, int numOfAssets)
+void MarkowitzModel::checkWeights(const vector<double> &x, int numOfAssets)
 {
     vector<double> weights = parseOutWeights(x, numOfAssets);
     cout << "Weights sum to: " << sumPortfolioWeights(weights) << endl;
 }
 
 /**
- * Parses out the weights from column vector x. The 
+ * Parses out the weights from the vector x. The 
  * first `numOfAssets` elements in x correspond to the
  * portfolio weights and should sum to 1.
  * 
- * @param x = The column vector x.
+ * @param x = The vector x.
  * @param numOfAssets - The number of assets in scope.
  * @return The vector of portfolio weights.
  **/
-vector<double> MarkowitzModel::parseOutWeights(vector<vector<double> > &x, int numOfAssets)
+vector<double> MarkowitzModel::parseOutWeights(const vector<double> &x, int numOfAssets)
 {
-    vector<double> weights;
-    weights.resize(numOfAssets);
-
-    for (int i = 0; i < numOfAssets; i++)
-    {
-        weights[i] = x[i][0];
-    }
-
-    return weights;
+    return vector<double>(x.begin(), x.begin() + numOfAssets);
 }
 
 /**
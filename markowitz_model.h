@@ -1,11 +1,17 @@
 #ifndef MarkowitzModel_h
 #define MarkowitzModel_h
 
+#include <algorithm>
+#include <atomic>
 #include <iostream>
+#include <math.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string>
 #include <vector>
+#include "ewma_estimator.h"
 #include "portfolio_optimisation_model.h"
+#include "returns_prefix_sums.h"
 #include "matrix.h"
 #include "utils.h"
 
@@ -21,6 +27,15 @@ using namespace std;
 class MarkowitzModel : public virtual PortfolioOptimisationModel
 {
 public:
+    /**
+     * Constructs a Markowitz Model.
+     * 
+     * @param returnsPrefixSums - Optional prefix sums over the returns matrix, used to
+     *                            estimate the mean returns and covariance of a sample
+     *                            without sweeping over it. Must outlive the model.
+     **/
+    MarkowitzModel(const ReturnsPrefixSums *returnsPrefixSums = NULL);
+
     /**
      * Calculates and returns the optimatal portfolio weights for the
      * given subsection of time-indexed returns, as indicated by the
@@ -32,52 +47,237 @@ public:
      * @param targetReturn - The desired return to be attained by the optimal portfolio.
      * @return The optimal portfolio weights.
      **/
-    vector<double> calculatePortfolioWeights(const vector<vector<double> > &returnsMatrix, int returnsStartIdx, int returnsEndIdx, double targetReturn);
+    vector<double> calculatePortfolioWeights(const ReturnsView &returnsMatrix, int returnsStartIdx, int returnsEndIdx, double targetReturn);
+
+    /**
+     * Calculates and returns the optimal portfolio weights for each of the
+     * given target returns. The sample statistics and the matrix Q are built
+     * once and shared by the solves for every target, and only the lowest and
+     * highest targets are solved for; see `solveForPortfolioWeights`.
+     * 
+     * @param returnsMatrix - The matrix of time-indexed returns.
+     * @param returnsStartIdx - The "first day" of the sample of returns.
+     * @param returnsEndIdx - The "last day" of the sample of returns.
+     * @param targetReturns - The desired returns to be attained by the optimal portfolios.
+     * @param solverStatistics - Optionally populated with the statistics of the conjugate
+     *                           gradient solve for each target return.
+     * @return The optimal portfolio weights, one row per target return.
+     **/
+    vector<vector<double> > calculatePortfolioWeights(const ReturnsView &returnsMatrix, int returnsStartIdx, int returnsEndIdx, const vector<double> &targetReturns, vector<SolverStatistics> *solverStatistics = NULL);
+
+    /**
+     * Calculates and returns the optimal portfolio weights for the given
+     * estimates of the mean returns and covariance of returns. Allows
+     * alternative risk inputs, such as EWMA estimates, to be optimised.
+     * 
+     * @param meanReturns - The column vector of mean returns.
+     * @param covarianceMatrix - The covariance matrix of returns.
+     * @param targetReturn - The desired return to be attained by the optimal portfolio.
+     * @return The optimal portfolio weights.
+     **/
+    vector<double> calculatePortfolioWeights(const vector<vector<double> > &meanReturns, const vector<vector<double> > &covarianceMatrix, double targetReturn);
+
+    /**
+     * Calculates and returns the optimal portfolio weights for each of the
+     * given target returns, from the given estimates of the mean returns and
+     * covariance of returns. Each solve starts from the given solution for its
+     * target, so that re-solving after the estimates change a little, e.g.
+     * when a window rolls forward by a day, takes few iterations. As with the
+     * other overloads, only the lowest and highest targets are solved for.
+     * 
+     * @param meanReturns - The column vector of mean returns.
+     * @param covarianceMatrix - The covariance matrix of returns.
+     * @param targetReturns - The desired returns to be attained by the optimal portfolios.
+     * @param solutions - The solutions x = (weights, multipliers) to start from, one per
+     *                    target return, which are populated with the solutions of these
+     *                    solves. Solves whose solution is empty start from equal weights.
+     * @param solverStatistics - Optionally populated with the statistics of the conjugate
+     *                           gradient solve for each target return.
+     * @return The optimal portfolio weights, one row per target return.
+     **/
+    vector<vector<double> > calculatePortfolioWeights(const vector<vector<double> > &meanReturns, const vector<vector<double> > &covarianceMatrix, const vector<double> &targetReturns, vector<vector<double> > &solutions, vector<SolverStatistics> *solverStatistics = NULL);
+
+    /**
+     * Calculates and returns the optimal portfolio weights using the
+     * current estimates of the given EWMA estimator as the risk input.
+     * 
+     * @param estimator - The EWMA estimator of mean returns and covariance.
+     * @param targetReturn - The desired return to be attained by the optimal portfolio.
+     * @return The optimal portfolio weights.
+     **/
+    vector<double> calculatePortfolioWeights(const EwmaEstimator &estimator, double targetReturn);
+
+    /**
+     * Mixes every parameter that the model's portfolios depend on into the
+     * given hash: the lagrange multipliers the solves start from, the solver's
+     * tolerance and iteration limit, and whether prefix sums estimate the
+     * samples' statistics.
+     * 
+     * @param hash - The hash to continue from.
+     * @return The hash.
+     **/
+    uint64_t hashParameters(uint64_t hash) const;
+
+    /**
+     * Returns the most iterations a solve may take per row of Q, which
+     * bounds the cost of a solve that does not converge.
+     * 
+     * @return The most iterations per row of Q.
+     **/
+    int getMaxNumOfIterationsPerRow() const;
+
+    /**
+     * Prints a warning for the solves that stopped at the iteration limit
+     * before converging, and for those that excluded assets without
+     * estimates, if any, with how many there were. Meant to be called once,
+     * at the end of a run, rather than per solve.
+     **/
+    void printWarnings() const;
 
 private:
+    // Optional prefix sums over the returns matrix. May be NULL.
+    const ReturnsPrefixSums *returnsPrefixSums;
+
     // Constants used in the lagrange optimisation.
     const double lagrangeMultiplierOne = 0.1;
     const double lagrangeMultiplierTwo = 0.1;
 
-    // The degree of error acceptable in the conjugate gradient method.
-    const double toleranceThreshold = 0.000001;
+    // The degree of error acceptable in the conjugate gradient method, as
+    // the norm of the residual relative to the norm of b. Q is indefinite
+    // and ill conditioned, so the residual has to be small for the weights
+    // to be settled, rather than to depend on the rounding of Q's estimates.
+    const double toleranceThreshold = 1e-12;
+
+    // The most iterations a solve may take, per row of Q. Rounding costs
+    // the iterations their conjugacy, so a solve can take more iterations
+    // than Q has rows, but one that has not converged within this many
+    // stops, with its residual in its statistics.
+    const int maxNumOfIterationsPerRow = 10;
+
+    // The number of solves, of those that stopped at the iteration limit,
+    // and of those that excluded assets, since the model was constructed,
+    // along with the most assets any solve excluded. Solves may run
+    // concurrently.
+    atomic<long> numOfSolves;
+    atomic<long> numOfUnconvergedSolves;
+    atomic<long> numOfSolvesWithExcludedAssets;
+    atomic<int> maxNumOfExcludedAssets;
 
     /**
-     * Updates the column vector p.
+     * Estimates the mean returns and covariance matrix of the given
+     * subsection of time-indexed returns.
      * 
-     * Dimensions: (no_of_assets + 2) x 1
+     * @param returnsMatrix - The matrix of time-indexed returns.
+     * @param returnsStartIdx - The "first day" of the sample of returns.
+     * @param returnsEndIdx - The "last day" of the sample of returns.
+     * @param meanReturns - Populated with the column vector of mean returns.
+     * @param covarianceMatrix - Populated with the covariance matrix.
+     **/
+    void estimateSampleStatistics(const ReturnsView &returnsMatrix, int returnsStartIdx, int returnsEndIdx, vector<vector<double> > &meanReturns, vector<vector<double> > &covarianceMatrix);
+
+    /**
+     * Calculates and returns the optimal portfolio weights for each of the
+     * given target returns from the given estimates, building Q once for all
+     * of them. Only b depends on the target return, so the optimal x is affine
+     * in it: given more than two targets, only the lowest and highest are
+     * solved for, and the others are interpolated between them, which costs
+     * one Q * x each, for their residuals, rather than a solve.
      * 
-     * @param s - The column vector s.
-     * @param p - The column vector s.
-     * @param beta - The scalar value beta.
-     * @return The updated column vector p.
+     * Assets whose mean return or covariances are NaN, e.g. for want of
+     * returns in the sample, are excluded from the portfolios, and given a
+     * weight of zero, so that the NaNs never reach the solver. The solves are
+     * counted towards `printWarnings`.
+     * 
+     * @param meanReturns - The column vector of mean returns.
+     * @param covarianceMatrix - The covariance matrix of returns.
+     * @param targetReturns - The desired returns to be attained by the optimal portfolios.
+     * @param solutions - Optionally, the solutions x = (weights, multipliers) to start from,
+     *                    one per target return, which are populated with the solutions of
+     *                    these solves. The weights of excluded assets are zero.
+     * @param solverStatistics - Optionally populated with the statistics of the conjugate
+     *                           gradient solve for each target return.
+     * @return The optimal portfolio weights, one row per target return.
      **/
-    vector<vector<double> > updateP(vector<vector<double> > &s, vector<vector<double> > &p, double beta);
+    vector<vector<double> > solveForPortfolioWeights(const vector<vector<double> > &meanReturns, const vector<vector<double> > &covarianceMatrix, const vector<double> &targetReturns, vector<vector<double> > *solutions, vector<SolverStatistics> *solverStatistics);
 
     /**
-     * Updates the column vector s.
+     * Finds the assets that the given estimates can optimise a portfolio of:
+     * those whose mean return, variance and covariances with each other are
+     * not NaN. Assets whose own estimates are NaN are dropped first, then,
+     * while any covariance between the remaining assets is NaN, the asset
+     * with the most NaN covariances.
      * 
-     * Dimensions: (no_of_assets + 2) x 1
+     * @param meanReturns - The column vector of mean returns.
+     * @param covarianceMatrix - The covariance matrix of returns.
+     * @return The indices of the assets, in order.
+     **/
+    vector<int> findEstimatedAssets(const vector<vector<double> > &meanReturns, const vector<vector<double> > &covarianceMatrix);
+
+    /**
+     * Solves the system Q * x = b for the given target return with the
+     * conjugate gradient method, and returns the portfolio weights. The
+     * solve stops once |s| <= toleranceThreshold * |b|, or after
+     * maxNumOfIterationsPerRow iterations per row of Q, in which case it
+     * is counted towards `printWarnings`.
+     * 
+     * The iterations update flat vectors in place and compute Q * p once
+     * each, so that a solve allocates nothing after its set up.
      * 
-     * @param s - The column vector s.
      * @param Q - The matrix Q.
-     * @param p - The column vector s.
+     * @param numOfAssets - The number of assets in scope.
+     * @param targetReturn - The desired return to be attained by the optimal portfolio.
+     * @param statistics - Optionally populated with the statistics of the solve.
+     * @param solution - Optionally, the solution x = (weights, multipliers) to start
+     *                   from, which is populated with the solution of this solve. The
+     *                   solve starts from equal weights if it is empty.
+     * @return The optimal portfolio weights.
+     **/
+    vector<double> solveForPortfolioWeights(vector<vector<double> > &Q, int numOfAssets, double targetReturn, SolverStatistics *statistics = NULL, vector<double> *solution = NULL);
+
+    /**
+     * Returns the norm of the residual b - Q * x of the given solution for the
+     * given target return.
+     * 
+     * @param Q - The matrix Q.
+     * @param x - The solution x = (weights, multipliers).
+     * @param numOfAssets - The number of assets in scope.
+     * @param targetReturn - The target return of the optimised portfolio.
+     * @return The norm of the residual.
+     **/
+    double calculateResidualNorm(const vector<vector<double> > &Q, const vector<double> &x, int numOfAssets, double targetReturn);
+
+    /**
+     * Updates the vector p in place, i.e. p = s + beta * p.
+     * 
+     * Dimensions: (no_of_assets + 2)
+     * 
+     * @param s - The vector s.
+     * @param p - The vector p.
+     * @param beta - The scalar value beta.
+     **/
+    void updateP(const vector<double> &s, vector<double> &p, double beta);
+
+    /**
+     * Updates the vector s in place, i.e. s = s - alpha * Q * p.
+     * 
+     * Dimensions: (no_of_assets + 2)
+     * 
+     * @param s - The vector s.
+     * @param Qp - The vector Q * p.
      * @param alpha - The scalar value alpha.
-     * @return The updated column vector x.
      **/
-    vector<vector<double> > updateS(vector<vector<double> > &s, vector<vector<double> > &Q, vector<vector<double> > &p, double alpha);
+    void updateS(vector<double> &s, const vector<double> &Qp, double alpha);
 
     /**
-     * Updates the column vector x.
+     * Updates the vector x in place, i.e. x = x + alpha * p.
      * 
-     * Dimensions: (no_of_assets + 2) x 1
+     * Dimensions: (no_of_assets + 2)
      * 
-     * @param x - The column vector x.
-     * @param p - The matrix p.
+     * @param x - The vector x.
+     * @param p - The vector p.
      * @param alpha - The scalar value alpha.
-     * @return The updated column vector x.
      **/
-    vector<vector<double> > updateX(vector<vector<double> > &x, vector<vector<double> > &p, double alpha);
+    void updateX(vector<double> &x, const vector<double> &p, double alpha);
 
     /**
      * Calculate the beta in the conjugate gradient method.
@@ -91,20 +291,29 @@ private:
     /**
      * Calculate the alpha in the conjugate gradient method.
      * 
-     * @param Q - The matrix Q.
-     * @param p - The matrix p.
+     * @param p - The vector p.
+     * @param Qp - The vector Q * p.
      * @param sProduct - the scalar value s^T * s.
      * @return The scalar value alpha.
      **/
-    double calculateAlpha(vector<vector<double> > &Q, vector<vector<double> > &p, double sProduct);
+    double calculateAlpha(const vector<double> &p, const vector<double> &Qp, double sProduct);
+
+    /**
+     * Calculate the matrix-vector product Q * p.
+     * 
+     * @param Q - The matrix Q.
+     * @param p - The vector p.
+     * @param Qp - Populated with the vector Q * p.
+     **/
+    void calculateQp(const vector<vector<double> > &Q, const vector<double> &p, vector<double> &Qp);
 
     /**
-     * Calculate the matrix multiplication of s transpose and s.
+     * Calculate the inner product of s with itself.
      * 
-     * @param s - The matrix s. Dimensions = (numOfAssets + 2) x 1.
+     * @param s - The vector s. Dimensions = (numOfAssets + 2).
      * @return The scalar value s^T * s.
      **/
-    double calculateSProduct(vector<vector<double> > &s);
+    double calculateSProduct(const vector<double> &s);
 
     /**
      * Calculate the matrix Q. Consists of the covariance matrix,
@@ -113,13 +322,11 @@ private:
      * Dimensions: (no_of_assets + 2) x (no_of_assets + 2)
      * 
      * @param meanReturns - The mean returns vector.
-     * @param returnsMatrix - The matrix of time-indexed returns.
-     * @param returnsStartIdx - The "first day" of the sample of returns.
-     * @param returnsEndIdx - The "last day" of the sample of returns.
+     * @param covarianceMatrix - The covariance matrix of returns.
      * @param numOfAssets - The number of assets in scope.
      * @return The column vector of mean returns.
      **/
-    vector<vector<double> > calculateQ(const vector<vector<double> > &meanReturns, const vector<vector<double> > &returnsMatrix, int returnsStartIdx, int returnsEndIdx, int numOfAssets);
+    vector<vector<double> > calculateQ(const vector<vector<double> > &meanReturns, const vector<vector<double> > &covarianceMatrix, int numOfAssets);
 
     /**
      * Initialise the column vector x. Consists of the initial, equal
@@ -150,21 +357,21 @@ private:
      * Check to see if the portfolio weights sum to zero.
      * Print an appropriate message to STDOUT.
      * 
-     * @param x = The column vector x.
+     * @param x = The vector x.
      * @param numOfAssets - The number of assets in scope.
      **/
-    void checkWeights(vector<vector<double> > &x, int numOfAssets);
+    void checkWeights(const vector<double> &x, int numOfAssets);
 
     /**
-     * Parses out the weights from column vector x. The 
+     * Parses out the weights from the vector x. The 
      * first `numOfAssets` elements in x correspond to the
      * portfolio weights and should sum to 1.
      * 
-     * @param x = The column vector x.
+     * @param x = The vector x.
      * @param numOfAssets - The number of assets in scope.
      * @return The vector of portfolio weights.
      **/
-    vector<double> parseOutWeights(vector<vector<double> > &x, int numOfAssets);
+    vector<double> parseOutWeights(const vector<double> &x, int numOfAssets);
 
     /**
      * Debugging method for checking that outputted portfolio 
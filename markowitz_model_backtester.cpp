@@ -1,5 +1,166 @@
 #include "markowitz_model_backtester.h"
 
+// The number of values per target return in a window's checkpoint record,
+// ahead of the portfolio weights.
+static const int numOfWindowRecordValues = 9;
+
+/**
+ * Constructs a backtester.
+ * 
+ * @param numOfThreads - The number of threads to run the backtest on. Above one, the
+ *                       windows are optimised in parallel, so the model's
+ *                       `calculatePortfolioWeights` must be reentrant.
+ *                       Non-positive values mean one thread per hardware thread.
+ * @param scheme - How the in sample period moves between windows.
+ * @param stepSize - The number of days between consecutive windows.
+ *                   Non-positive values mean the out of sample size.
+ **/
+MarkowitzModelBacktester::MarkowitzModelBacktester(int numOfThreads, WalkForwardScheme scheme, int stepSize)
+{
+    this->numOfThreads = ThreadPool::resolveNumOfThreads(numOfThreads);
+    this->scheme = scheme;
+    this->stepSize = stepSize;
+    this->shardIdx = 0;
+    this->numOfShards = 1;
+    this->evaluationReturnsPanel = NULL;
+}
+
+/**
+ * Checkpoints every completed window to the given file. A later run of the
+ * same backtest on the same data resumes from the windows in the file. The
+ * shard files of a sharded backtest are named after the file, see
+ * `getShardFileName`, so that its shards resume too.
+ * 
+ * @param fileName - The name of the checkpoint file.
+ **/
+void MarkowitzModelBacktester::enableCheckpointing(const string &fileName)
+{
+    this->checkpointFileName = fileName;
+}
+
+/**
+ * Also stores the results of every window, target return by target return,
+ * in the given binary columnar file, together with the portfolio weights
+ * and the statistics of the solve. See `ResultsStore` for the format.
+ * 
+ * @param fileName - The name of the results store file.
+ **/
+void MarkowitzModelBacktester::enableResultsStore(const string &fileName)
+{
+    this->resultsStoreFileName = fileName;
+}
+
+/**
+ * Runs only one shard of the windows, e.g. in one of several processes.
+ * The shard's windows are recorded to its shard file, which is also its
+ * checkpoint, instead of to the CSV files; `mergeShards` then combines
+ * the shard files.
+ * 
+ * @param shardIdx - The index of the shard, in [0, numOfShards).
+ * @param numOfShards - The number of shards.
+ **/
+void MarkowitzModelBacktester::enableSharding(int shardIdx, int numOfShards)
+{
+    this->shardIdx = shardIdx;
+    this->numOfShards = numOfShards;
+}
+
+/**
+ * Backtests the portfolios of the given target returns instead of the
+ * default grid, see `initialiseTargetReturns`.
+ * 
+ * @param targetReturns - The target returns. Empty restores the default grid.
+ **/
+void MarkowitzModelBacktester::setTargetReturns(const vector<double> &targetReturns)
+{
+    this->targetReturns = targetReturns;
+}
+
+/**
+ * Combines the shard files written by the shards of a backtest into the
+ * CSV files that a single run of the backtest writes. The shard files are
+ * then deleted, unless they are checkpoints kept by request.
+ * 
+ * @param returnsMatrix - The matrix of returns.
+ * @param model - The portfolio optimisation model that the shards ran.
+ * @param inSampleSize - The window size of the insample.
+ * @param outOfSampleSize - The window size of the out of sample.
+ * @param numOfShards - The number of shards.
+ **/
+void MarkowitzModelBacktester::mergeShards(const ReturnsView &returnsMatrix, const PortfolioOptimisationModel &model, int inSampleSize, int outOfSampleSize, int numOfShards)
+{
+    cout << "Merging " << numOfShards << " backtest shards" << endl;
+
+    vector<double> targetReturns = initialiseTargetReturns();
+    uint64_t fingerprint = calculateFingerprint(returnsMatrix, model, targetReturns, inSampleSize, outOfSampleSize);
+
+    BacktestResults results;
+
+    WalkForwardSchedule fullSchedule(returnsMatrix.getNumOfReturns(), inSampleSize, outOfSampleSize, scheme, stepSize);
+    ResultsStore *resultsStore = createResultsStore(fullSchedule.getNumOfWindows(), targetReturns.size(), returnsMatrix.getNumOfAssets());
+
+    AsyncResultWriter resultWriter([&](vector<BacktestWindowResults> &batch) {
+        writeWindowResults(batch, targetReturns, results, resultsStore, NULL);
+    }, numOfQueuedWindows);
+
+    for (int i = 0; i < numOfShards; i++)
+    {
+        WalkForwardSchedule schedule(returnsMatrix.getNumOfReturns(), inSampleSize, outOfSampleSize, scheme, stepSize);
+        schedule.selectShard(i, numOfShards);
+
+        BacktestCheckpoint shard(getShardFileName(i, numOfShards), fingerprint, true);
+
+        for (int windowIdx = schedule.getFirstWindowIdx(); windowIdx < schedule.getEndWindowIdx(); windowIdx++)
+        {
+            const vector<double> *record = shard.getRecord(windowIdx);
+
+            if (record == NULL)
+            {
+                cout << "Shard " << i << " of " << numOfShards << " has not completed window " << windowIdx << "." << endl;
+                exit(EXIT_FAILURE);
+            }
+
+            BacktestWindowResults windowResults;
+            windowResults.window = schedule.getWindow(windowIdx);
+            windowResults.weights.assign(targetReturns.size(), vector<double>(returnsMatrix.getNumOfAssets()));
+            windowResults.isRestored = true;
+
+            restoreWindowRecord(*record, windowResults.performances, windowResults.turnovers, windowResults.solverStatistics, windowResults.weights);
+            resultWriter.push(windowResults);
+        }
+    }
+
+    resultWriter.close();
+    delete resultsStore;
+
+    writeResults(results, targetReturns);
+
+    // Without checkpointing, the shard files were only the shards' output.
+    for (int i = 0; i < numOfShards && checkpointFileName.empty(); i++)
+    {
+        remove(getShardFileName(i, numOfShards).c_str());
+    }
+}
+
+/**
+ * Returns the name of the file that the given shard of a backtest records to:
+ * the checkpoint file's name with the shard appended, if checkpointing is
+ * enabled, or otherwise a name in the working directory.
+ * 
+ * @param shardIdx - The index of the shard.
+ * @param numOfShards - The number of shards.
+ * @return The name of the shard file.
+ **/
+string MarkowitzModelBacktester::getShardFileName(int shardIdx, int numOfShards) const
+{
+    if (!checkpointFileName.empty())
+    {
+        return checkpointFileName + ".shard_" + to_string(shardIdx) + "_of_" + to_string(numOfShards);
+    }
+
+    return "backtest_shard_" + to_string(shardIdx) + "_of_" + to_string(numOfShards) + ".ckpt";
+}
+
 /**
  * Evaluates the given models performance on the given data set `returnsMatrix`.
  * 
@@ -8,18 +169,36 @@
  * @param inSampleSize - The window size of the insample.
  * @param outOfSampleSize - The window size of the out of sample.
  **/
-void MarkowitzModelBacktester::evaluatePerformance(const vector<vector<double> > &returnsMatrix, PortfolioOptimisationModel &model, int inSampleSize, int outOfSampleSize)
+void MarkowitzModelBacktester::evaluatePerformance(const ReturnsView &returnsMatrix, PortfolioOptimisationModel &model, int inSampleSize, int outOfSampleSize)
 {
     cout << "Running backtest" << endl;
 
-    int numOfAssets = returnsMatrix.size();
-    int numOfReturns = returnsMatrix[0].size();
+    int numOfAssets = returnsMatrix.getNumOfAssets();
+    int numOfReturns = returnsMatrix.getNumOfReturns();
 
     vector<double> targetReturns = initialiseTargetReturns();
 
     recordBacktestResults(returnsMatrix, model, targetReturns, inSampleSize, outOfSampleSize, numOfReturns);
 }
 
+/**
+ * Evaluates the given models performance on the given asset major or
+ * time major panel of returns, which is read in place, without a copy.
+ * The portfolios of a panel in `portfolioReturnSeriesLayout` are
+ * evaluated a day at a time, and those of any other an asset at a time.
+ * 
+ * @param returnsPanel - The panel of returns.
+ * @param model - The portfolio optimisation model.
+ * @param inSampleSize - The window size of the insample.
+ * @param outOfSampleSize - The window size of the out of sample.
+ **/
+void MarkowitzModelBacktester::evaluatePerformance(const ReturnsPanel &returnsPanel, PortfolioOptimisationModel &model, int inSampleSize, int outOfSampleSize)
+{
+    this->evaluationReturnsPanel = returnsPanel.getLayout() == portfolioReturnSeriesLayout ? &returnsPanel : NULL;
+    evaluatePerformance(returnsPanel.getView(), model, inSampleSize, outOfSampleSize);
+    this->evaluationReturnsPanel = NULL;
+}
+
 /**
  * Writes out all backtest returns for different portfolios and
  * different sample period to a csv file. Each portfolio
@@ -32,62 +211,487 @@ void MarkowitzModelBacktester::evaluatePerformance(const vector<vector<double> >
  * @param outOfSampleSize - The window size of the out of sample.
  * @param numOfReturns - The number of returns in scope
  **/
-void MarkowitzModelBacktester::recordBacktestResults(const vector<vector<double> > &returnsMatrix, PortfolioOptimisationModel &model, vector<double> targetReturns, int inSampleSize, int outOfSampleSize, int numOfReturns)
+void MarkowitzModelBacktester::recordBacktestResults(const ReturnsView &returnsMatrix, PortfolioOptimisationModel &model, vector<double> targetReturns, int inSampleSize, int outOfSampleSize, int numOfReturns)
 {
-    int firstInSampleDay = 0;
-    int lastInSampleDay = firstInSampleDay + inSampleSize - 1;
-    int firstOutOfSampleDay = firstInSampleDay + inSampleSize;
-    int lastOutOfSampleDay = firstOutOfSampleDay + outOfSampleSize - 1;
+    int numOfTargetReturns = targetReturns.size();
+
+    // The windows are derived from the length of the data and generated lazily.
+    WalkForwardSchedule schedule(numOfReturns, inSampleSize, outOfSampleSize, scheme, stepSize);
+    int numOfWindows = schedule.getNumOfWindows();
+
+    if (numOfWindows == 0)
+    {
+        cout << "There are too few returns for a single backtest window." << endl;
+        return;
+    }
+
+    // A shard runs its own range of windows, always checkpointed to its shard file.
+    bool isShard = numOfShards > 1;
+    string recordFileName = checkpointFileName;
+
+    if (isShard)
+    {
+        schedule.selectShard(shardIdx, numOfShards);
+        recordFileName = getShardFileName(shardIdx, numOfShards);
+    }
+
+    // Each grid gains one row, of a value per target return, as each window is written.
+    BacktestResults results;
+    int numOfRestoredWindows = 0;
+
+    // The portfolios start from cash, i.e. zero weights.
+    vector<vector<double> > previousWeights(numOfTargetReturns, vector<double>(returnsMatrix.getNumOfAssets(), 0));
+
+    BacktestCheckpoint *checkpoint = recordFileName.empty() ? NULL : new BacktestCheckpoint(recordFileName, calculateFingerprint(returnsMatrix, model, targetReturns, inSampleSize, outOfSampleSize));
+    BacktestWindow window;
+
+    // Shards leave the results store to the merge.
+    ResultsStore *resultsStore = isShard ? NULL : createResultsStore(numOfWindows, numOfTargetReturns, returnsMatrix.getNumOfAssets());
+
+    // Completed windows are checkpointed, stored and gathered for the CSV
+    // files on a background thread, while later windows are computed.
+    AsyncResultWriter resultWriter([&](vector<BacktestWindowResults> &batch) {
+        writeWindowResults(batch, targetReturns, results, resultsStore, checkpoint);
+    }, numOfQueuedWindows);
+
+    // Precomputed weights have no solver statistics until they are fitted.
+    SolverStatistics unknownStatistics = {-1, NAN};
+
+    if (checkpoint != NULL)
+    {
+        // Windows are checkpointed in order, so the completed ones form a prefix.
+        const vector<double> *record;
+
+        while ((record = checkpoint->getRecord(schedule.getFirstWindowIdx() + numOfRestoredWindows)) != NULL && schedule.next(window))
+        {
+            BacktestWindowResults windowResults;
+            windowResults.window = window;
+            windowResults.isRestored = true;
+
+            restoreWindowRecord(*record, windowResults.performances, windowResults.turnovers, windowResults.solverStatistics, previousWeights);
+            windowResults.weights = previousWeights;
+
+            resultWriter.push(windowResults);
+            numOfRestoredWindows++;
+        }
+
+        if (numOfRestoredWindows > 0)
+        {
+            cout << "Resuming backtest after " << numOfRestoredWindows << " checkpointed windows" << endl;
+        }
+    }
+
+    // An anchored schedule fits the model once, on the shared in sample period.
+    vector<vector<double> > fixedWeights;
+    vector<SolverStatistics> fixedStatistics(numOfTargetReturns, unknownStatistics);
+
+    if (schedule.hasFixedInSample())
+    {
+        BacktestWindow firstWindow = schedule.getWindow(0);
+        fixedWeights = model.calculatePortfolioWeights(returnsMatrix, firstWindow.firstInSampleDay, firstWindow.lastInSampleDay, targetReturns, &fixedStatistics);
+    }
+
+    // A shard that starts mid schedule refits the window before its first, so
+    // that its first turnover matches that of an unsharded run.
+    if (numOfRestoredWindows == 0 && schedule.getFirstWindowIdx() > 0)
+    {
+        BacktestWindow precedingWindow = schedule.getWindow(schedule.getFirstWindowIdx() - 1);
+        previousWeights = schedule.hasFixedInSample() ? fixedWeights : model.calculatePortfolioWeights(returnsMatrix, precedingWindow.firstInSampleDay, precedingWindow.lastInSampleDay, targetReturns);
+    }
+
+    // Windows are processed in batches, each window fanning out to every
+    // target return. A batch runs in parallel when there are several threads;
+    // its results, and the turnover between consecutive windows, are then
+    // recorded in window order.
+    ThreadPool *threadPool = numOfThreads > 1 ? new ThreadPool(numOfThreads) : NULL;
+    int batchSize = numOfThreads > 1 ? 4 * numOfThreads : 1;
+
+    vector<BacktestWindow> batchWindows;
+
+    while (true)
+    {
+        batchWindows.clear();
+
+        while (batchWindows.size() < batchSize && schedule.next(window))
+        {
+            batchWindows.push_back(window);
+        }
+
+        int numOfBatchWindows = batchWindows.size();
+
+        if (numOfBatchWindows == 0)
+        {
+            break;
+        }
+
+        vector<vector<vector<double> > > batchWeights(numOfBatchWindows);
+        vector<vector<PortfolioPerformance> > batchPerformances(numOfBatchWindows);
+        vector<vector<SolverStatistics> > batchStatistics(numOfBatchWindows, fixedStatistics);
+        const vector<vector<double> > *inSampleWeights = schedule.hasFixedInSample() ? &fixedWeights : NULL;
+
+        if (threadPool != NULL)
+        {
+            // Every task writes only its own window's slot, so the output is
+            // identical to, and ordered as, the serial backtest.
+            threadPool->parallelFor(numOfBatchWindows, [&](int i) {
+                batchWeights[i] = runBacktestWindow(returnsMatrix, model, targetReturns, batchWindows[i], inSampleWeights, batchPerformances[i], batchStatistics[i]);
+            });
+        }
+        else
+        {
+            batchWeights[0] = runBacktestWindow(returnsMatrix, model, targetReturns, batchWindows[0], inSampleWeights, batchPerformances[0], batchStatistics[0]);
+        }
+
+        for (int i = 0; i < numOfBatchWindows; i++)
+        {
+            BacktestWindowResults windowResults;
+            windowResults.window = batchWindows[i];
+            windowResults.turnovers.resize(numOfTargetReturns);
+            windowResults.isRestored = false;
+
+            for (int targetReturnIdx = 0; targetReturnIdx < numOfTargetReturns; targetReturnIdx++)
+            {
+                windowResults.turnovers[targetReturnIdx] = calculateTurnover(previousWeights[targetReturnIdx], batchWeights[i][targetReturnIdx]);
+            }
+
+            previousWeights = batchWeights[i];
+
+            windowResults.performances = move(batchPerformances[i]);
+            windowResults.weights = move(batchWeights[i]);
+            windowResults.solverStatistics = move(batchStatistics[i]);
+
+            resultWriter.push(windowResults);
+        }
+    }
+
+    // Everything queued must be written before the checkpoint and store close.
+    resultWriter.close();
 
+    delete threadPool;
+    delete checkpoint;
+    delete resultsStore;
+
+    if (isShard)
+    {
+        cout << "Recorded shard " << shardIdx << " of " << numOfShards << " to " << recordFileName << endl;
+        return;
+    }
+
+    writeResults(results, targetReturns);
+}
+
+/**
+ * Writes the results of every window of a backtest to the CSV files.
+ * 
+ * @param results - The backtest results.
+ * @param targetReturns - The target returns.
+ **/
+void MarkowitzModelBacktester::writeResults(const BacktestResults &results, const vector<double> &targetReturns)
+{
     int numOfTargetReturns = targetReturns.size();
-    int numOfWindows = 50; // Inferred from values of `windowIdx`;
+    int numOfWindows = results.returns.size();
+
+    // The CSV files hold a row per target return and a column per window.
+    writeToCsv(getMatrixTranspose(results.returns), targetReturns, "backtest_returns.csv", numOfTargetReturns, numOfWindows);
+    writeToCsv(getMatrixTranspose(results.sharpeRatios), targetReturns, "backtest_sharpe_ratios.csv", numOfTargetReturns, numOfWindows);
+    writeToCsv(getMatrixTranspose(results.standardDeviations), targetReturns, "backtest_standard_deviations.csv", numOfTargetReturns, numOfWindows);
+    writeToCsv(getMatrixTranspose(results.maxDrawdowns), targetReturns, "backtest_max_drawdowns.csv", numOfTargetReturns, numOfWindows);
+    writeToCsv(getMatrixTranspose(results.turnovers), targetReturns, "backtest_turnovers.csv", numOfTargetReturns, numOfWindows);
+}
+
+/**
+ * Optimises the portfolios for every target return on the in sample period
+ * of one window, and evaluates their out of sample performance. Each portfolio
+ * is evaluated from its realised out of sample return series, in O(no_of_assets
+ * x no_of_days) rather than through an out of sample covariance matrix, and the
+ * series of all the portfolios come from a single matrix product.
+ * 
+ * @param returnsMatrix - The matrix of returns.
+ * @param model - The portfolio optimisation model.
+ * @param targetReturns - The target returns.
+ * @param window - The in sample and out of sample periods of the window.
+ * @param fixedWeights - Weights already fitted on the window's in sample period,
+ *                       one row per target return, or NULL to fit them.
+ * @param performances - Populated with the out of sample performance per target return.
+ * @param solverStatistics - Populated with the statistics of the solve per target return.
+ * @return The in sample portfolio weights, one row per target return.
+ **/
+vector<vector<double> > MarkowitzModelBacktester::runBacktestWindow(const ReturnsView &returnsMatrix, PortfolioOptimisationModel &model, const vector<double> &targetReturns, const BacktestWindow &window, const vector<vector<double> > *fixedWeights, vector<PortfolioPerformance> &performances, vector<SolverStatistics> &solverStatistics)
+{
+    vector<vector<double> > inSampleWeights = fixedWeights != NULL ? *fixedWeights : model.calculatePortfolioWeights(returnsMatrix, window.firstInSampleDay, window.lastInSampleDay, targetReturns, &solverStatistics);
+
+    // Every frontier portfolio's out of sample series comes from one W . R product.
+    vector<vector<double> > portfolioReturns;
+
+    if (evaluationReturnsPanel != NULL)
+    {
+        portfolioReturns = calculatePortfolioReturnSeries(*evaluationReturnsPanel, window.firstOutOfSampleDay, window.lastOutOfSampleDay, inSampleWeights);
+    }
+    else
+    {
+        portfolioReturns = calculatePortfolioReturnSeries(returnsMatrix, window.firstOutOfSampleDay, window.lastOutOfSampleDay, inSampleWeights);
+    }
+
+    performances = evaluatePortfolioReturnSeries(portfolioReturns, riskFreeRate);
 
-    // Temp variables in later for loop.
-    vector<double> inSampleWeights;
-    vector<vector<double> > inSampleWeightsColumnVector;
-    double portfolioMeanReturn = 0;
+    return inSampleWeights;
+}
 
-    // Dimensions are (numOfTargetReturns x windowIdx).
-    vector<vector<double> > backtestingReturns;
-    backtestingReturns.resize(numOfTargetReturns);
+/**
+ * Appends the results of the next window to the backtest results.
+ * 
+ * @param performances - The out of sample performance per target return.
+ * @param turnovers - The turnover per target return.
+ * @param results - The backtest results, each grid of which gains a row.
+ **/
+void MarkowitzModelBacktester::appendWindowResults(const vector<PortfolioPerformance> &performances, const vector<double> &turnovers, BacktestResults &results)
+{
+    int numOfTargetReturns = performances.size();
 
-    // Dimensions are (numOfTargetReturns x windowIdx).
-    vector<vector<double> > backtestingSharpeRatios;
-    backtestingSharpeRatios.resize(numOfTargetReturns);
+    results.returns.push_back(vector<double>(numOfTargetReturns));
+    results.sharpeRatios.push_back(vector<double>(numOfTargetReturns));
+    results.standardDeviations.push_back(vector<double>(numOfTargetReturns));
+    results.maxDrawdowns.push_back(vector<double>(numOfTargetReturns));
+    results.turnovers.push_back(turnovers);
 
     for (int targetReturnIdx = 0; targetReturnIdx < numOfTargetReturns; targetReturnIdx++)
     {
-        vector<double> backtestingReturnsRow;
-        backtestingReturnsRow.resize(numOfWindows);
-        backtestingReturns[targetReturnIdx] = backtestingReturnsRow;
+        results.returns.back()[targetReturnIdx] = performances[targetReturnIdx].meanReturn;
+        results.sharpeRatios.back()[targetReturnIdx] = performances[targetReturnIdx].sharpeRatio;
+        results.standardDeviations.back()[targetReturnIdx] = performances[targetReturnIdx].standardDeviation;
+        results.maxDrawdowns.back()[targetReturnIdx] = performances[targetReturnIdx].maxDrawdown;
+    }
+}
 
-        vector<double> backtestingSharpeRatiosRow;
-        backtestingSharpeRatiosRow.resize(numOfWindows);
-        backtestingSharpeRatios[targetReturnIdx] = backtestingSharpeRatiosRow;
+/**
+ * Writes a batch of window results: appends them to the backtest results,
+ * checkpoints the computed ones, and stores them all in the results store.
+ * Runs on the writer thread.
+ * 
+ * @param batch - The window results, in window order.
+ * @param targetReturns - The target returns.
+ * @param results - The backtest results, each grid of which gains a row per window.
+ * @param resultsStore - The results store, or NULL if it is not enabled.
+ * @param checkpoint - The checkpoint, or NULL if checkpointing is not enabled.
+ **/
+void MarkowitzModelBacktester::writeWindowResults(vector<BacktestWindowResults> &batch, const vector<double> &targetReturns, BacktestResults &results, ResultsStore *resultsStore, BacktestCheckpoint *checkpoint)
+{
+    for (int i = 0; i < batch.size(); i++)
+    {
+        appendWindowResults(batch[i].performances, batch[i].turnovers, results);
 
-        for (int windowIdx = 0; windowIdx < numOfWindows; windowIdx++)
+        if (checkpoint != NULL && !batch[i].isRestored)
         {
-            inSampleWeights = model.calculatePortfolioWeights(returnsMatrix, firstInSampleDay, lastInSampleDay, targetReturns[targetReturnIdx]);
-            inSampleWeightsColumnVector = convertFromRowToColumnVector(inSampleWeights);
-
-            backtestingReturns[targetReturnIdx][windowIdx] = calculatePortfolioMeanReturn(returnsMatrix, firstOutOfSampleDay, lastOutOfSampleDay, inSampleWeightsColumnVector);
-            backtestingSharpeRatios[targetReturnIdx][windowIdx] = calculateSharpeRatio(returnsMatrix, firstOutOfSampleDay, lastOutOfSampleDay, inSampleWeights);
+            checkpoint->append(batch[i].window.windowIdx, createWindowRecord(batch[i].performances, batch[i].turnovers, batch[i].solverStatistics, batch[i].weights));
+        }
 
-            firstInSampleDay += outOfSampleSize;
-            lastInSampleDay += outOfSampleSize;
-            firstOutOfSampleDay += outOfSampleSize;
-            lastOutOfSampleDay += outOfSampleSize;
+        if (resultsStore != NULL)
+        {
+            storeWindowResults(*resultsStore, batch[i].window, targetReturns, batch[i].performances, batch[i].turnovers, batch[i].weights, batch[i].solverStatistics);
         }
+    }
+
+    // The whole batch is published to the store at once.
+    if (resultsStore != NULL)
+    {
+        resultsStore->commitRows();
+    }
+}
 
-        // Reset sample space boundaries.
-        firstInSampleDay = 0;
-        lastInSampleDay = firstInSampleDay + inSampleSize - 1;
-        firstOutOfSampleDay = firstInSampleDay + inSampleSize;
-        lastOutOfSampleDay = firstOutOfSampleDay + outOfSampleSize - 1;
+/**
+ * Creates the results store, with room for every window of the backtest.
+ * 
+ * @param numOfWindows - The number of windows.
+ * @param numOfTargetReturns - The number of target returns.
+ * @param numOfAssets - The number of assets.
+ * @return The results store, or NULL if it is not enabled.
+ **/
+ResultsStore *MarkowitzModelBacktester::createResultsStore(int numOfWindows, int numOfTargetReturns, int numOfAssets)
+{
+    if (resultsStoreFileName.empty())
+    {
+        return NULL;
     }
 
-    writeToCsv(backtestingReturns, targetReturns, "backtest_returns.csv", numOfTargetReturns, numOfWindows);
-    writeToCsv(backtestingSharpeRatios, targetReturns, "backtest_sharpe_ratios.csv", numOfTargetReturns, numOfWindows);
+    vector<ResultsColumn> columns = {
+        {"window", INT32_COLUMN, 1},
+        {"target_return", FLOAT64_COLUMN, 1},
+        {"first_in_sample_day", INT32_COLUMN, 1},
+        {"last_in_sample_day", INT32_COLUMN, 1},
+        {"first_out_of_sample_day", INT32_COLUMN, 1},
+        {"last_out_of_sample_day", INT32_COLUMN, 1},
+        {"mean_return", FLOAT64_COLUMN, 1},
+        {"standard_deviation", FLOAT64_COLUMN, 1},
+        {"sharpe_ratio", FLOAT64_COLUMN, 1},
+        {"max_drawdown", FLOAT64_COLUMN, 1},
+        {"turnover", FLOAT64_COLUMN, 1},
+        {"solver_iterations", INT32_COLUMN, 1},
+        {"solver_residual", FLOAT64_COLUMN, 1},
+        {"solver_reached_iteration_limit", INT32_COLUMN, 1},
+        {"excluded_assets", INT32_COLUMN, 1},
+        {"weights", FLOAT64_COLUMN, numOfAssets}};
+
+    return new ResultsStore(resultsStoreFileName, columns, (long)numOfWindows * numOfTargetReturns);
+}
+
+/**
+ * Stages the results of a window in the results store, one row per target
+ * return. The rows are written on the store's next commit.
+ * 
+ * @param resultsStore - The results store.
+ * @param window - The in sample and out of sample periods of the window.
+ * @param targetReturns - The target returns.
+ * @param performances - The out of sample performance per target return.
+ * @param turnovers - The turnover per target return.
+ * @param weights - The portfolio weights, one row per target return.
+ * @param solverStatistics - The statistics of the solve per target return.
+ **/
+void MarkowitzModelBacktester::storeWindowResults(ResultsStore &resultsStore, const BacktestWindow &window, const vector<double> &targetReturns, const vector<PortfolioPerformance> &performances, const vector<double> &turnovers, const vector<vector<double> > &weights, const vector<SolverStatistics> &solverStatistics)
+{
+    int windowColumnIdx = resultsStore.getColumnIdx("window");
+    int targetReturnColumnIdx = resultsStore.getColumnIdx("target_return");
+    int firstInSampleDayColumnIdx = resultsStore.getColumnIdx("first_in_sample_day");
+    int lastInSampleDayColumnIdx = resultsStore.getColumnIdx("last_in_sample_day");
+    int firstOutOfSampleDayColumnIdx = resultsStore.getColumnIdx("first_out_of_sample_day");
+    int lastOutOfSampleDayColumnIdx = resultsStore.getColumnIdx("last_out_of_sample_day");
+    int meanReturnColumnIdx = resultsStore.getColumnIdx("mean_return");
+    int standardDeviationColumnIdx = resultsStore.getColumnIdx("standard_deviation");
+    int sharpeRatioColumnIdx = resultsStore.getColumnIdx("sharpe_ratio");
+    int maxDrawdownColumnIdx = resultsStore.getColumnIdx("max_drawdown");
+    int turnoverColumnIdx = resultsStore.getColumnIdx("turnover");
+    int iterationsColumnIdx = resultsStore.getColumnIdx("solver_iterations");
+    int residualColumnIdx = resultsStore.getColumnIdx("solver_residual");
+    int iterationLimitColumnIdx = resultsStore.getColumnIdx("solver_reached_iteration_limit");
+    int excludedAssetsColumnIdx = resultsStore.getColumnIdx("excluded_assets");
+    int weightsColumnIdx = resultsStore.getColumnIdx("weights");
+
+    for (int targetReturnIdx = 0; targetReturnIdx < targetReturns.size(); targetReturnIdx++)
+    {
+        resultsStore.append(windowColumnIdx, window.windowIdx);
+        resultsStore.append(targetReturnColumnIdx, targetReturns[targetReturnIdx]);
+        resultsStore.append(firstInSampleDayColumnIdx, window.firstInSampleDay);
+        resultsStore.append(lastInSampleDayColumnIdx, window.lastInSampleDay);
+        resultsStore.append(firstOutOfSampleDayColumnIdx, window.firstOutOfSampleDay);
+        resultsStore.append(lastOutOfSampleDayColumnIdx, window.lastOutOfSampleDay);
+        resultsStore.append(meanReturnColumnIdx, performances[targetReturnIdx].meanReturn);
+        resultsStore.append(standardDeviationColumnIdx, performances[targetReturnIdx].standardDeviation);
+        resultsStore.append(sharpeRatioColumnIdx, performances[targetReturnIdx].sharpeRatio);
+        resultsStore.append(maxDrawdownColumnIdx, performances[targetReturnIdx].maxDrawdown);
+        resultsStore.append(turnoverColumnIdx, turnovers[targetReturnIdx]);
+        resultsStore.append(iterationsColumnIdx, solverStatistics[targetReturnIdx].numOfIterations);
+        resultsStore.append(residualColumnIdx, solverStatistics[targetReturnIdx].residualNorm);
+        resultsStore.append(iterationLimitColumnIdx, (int)solverStatistics[targetReturnIdx].hasReachedIterationLimit);
+        resultsStore.append(excludedAssetsColumnIdx, solverStatistics[targetReturnIdx].numOfExcludedAssets);
+        resultsStore.append(weightsColumnIdx, weights[targetReturnIdx]);
+    }
+}
+
+/**
+ * Packs the results of a window into a checkpoint record: the performance,
+ * turnover and solver statistics of each target return, followed by the
+ * portfolio weights, from which the turnover of the next window is calculated.
+ * 
+ * @param performances - The out of sample performance per target return.
+ * @param turnovers - The turnover per target return.
+ * @param solverStatistics - The statistics of the solve per target return.
+ * @param weights - The portfolio weights, one row per target return.
+ * @return The record.
+ **/
+vector<double> MarkowitzModelBacktester::createWindowRecord(const vector<PortfolioPerformance> &performances, const vector<double> &turnovers, const vector<SolverStatistics> &solverStatistics, const vector<vector<double> > &weights)
+{
+    vector<double> record;
+
+    for (int targetReturnIdx = 0; targetReturnIdx < performances.size(); targetReturnIdx++)
+    {
+        record.push_back(performances[targetReturnIdx].meanReturn);
+        record.push_back(performances[targetReturnIdx].sharpeRatio);
+        record.push_back(performances[targetReturnIdx].standardDeviation);
+        record.push_back(performances[targetReturnIdx].maxDrawdown);
+        record.push_back(turnovers[targetReturnIdx]);
+        record.push_back(solverStatistics[targetReturnIdx].numOfIterations);
+        record.push_back(solverStatistics[targetReturnIdx].residualNorm);
+        record.push_back(solverStatistics[targetReturnIdx].hasReachedIterationLimit);
+        record.push_back(solverStatistics[targetReturnIdx].numOfExcludedAssets);
+    }
+
+    for (int targetReturnIdx = 0; targetReturnIdx < weights.size(); targetReturnIdx++)
+    {
+        record.insert(record.end(), weights[targetReturnIdx].begin(), weights[targetReturnIdx].end());
+    }
+
+    return record;
+}
+
+/**
+ * Unpacks the results of a window from a checkpoint record.
+ * 
+ * @param record - The record.
+ * @param performances - Populated with the out of sample performance per target return.
+ * @param turnovers - Populated with the turnover per target return.
+ * @param solverStatistics - Populated with the statistics of the solve per target return.
+ * @param weights - The portfolio weights, one row per target return, which must
+ *                  already have their dimensions. Populated from the record.
+ **/
+void MarkowitzModelBacktester::restoreWindowRecord(const vector<double> &record, vector<PortfolioPerformance> &performances, vector<double> &turnovers, vector<SolverStatistics> &solverStatistics, vector<vector<double> > &weights)
+{
+    int numOfTargetReturns = weights.size();
+    int numOfAssets = weights[0].size();
+
+    if (record.size() != numOfTargetReturns * (numOfWindowRecordValues + numOfAssets))
+    {
+        cout << "Checkpoint record does not match the dimensions of the backtest." << endl;
+        exit(EXIT_FAILURE);
+    }
+
+    performances.resize(numOfTargetReturns);
+    turnovers.resize(numOfTargetReturns);
+    solverStatistics.resize(numOfTargetReturns);
+
+    const double *values = &record[0];
+
+    for (int targetReturnIdx = 0; targetReturnIdx < numOfTargetReturns; targetReturnIdx++, values += numOfWindowRecordValues)
+    {
+        performances[targetReturnIdx].meanReturn = values[0];
+        performances[targetReturnIdx].sharpeRatio = values[1];
+        performances[targetReturnIdx].standardDeviation = values[2];
+        performances[targetReturnIdx].maxDrawdown = values[3];
+        turnovers[targetReturnIdx] = values[4];
+        solverStatistics[targetReturnIdx].numOfIterations = values[5];
+        solverStatistics[targetReturnIdx].residualNorm = values[6];
+        solverStatistics[targetReturnIdx].hasReachedIterationLimit = values[7] != 0;
+        solverStatistics[targetReturnIdx].numOfExcludedAssets = values[8];
+    }
+
+    for (int targetReturnIdx = 0; targetReturnIdx < numOfTargetReturns; targetReturnIdx++, values += numOfAssets)
+    {
+        weights[targetReturnIdx].assign(values, values + numOfAssets);
+    }
+}
+
+/**
+ * Returns a fingerprint of the backtest configuration and the data, which
+ * identifies the backtest that wrote a checkpoint.
+ * 
+ * @param returnsMatrix - The matrix of returns.
+ * @param model - The portfolio optimisation model.
+ * @param targetReturns - The target returns.
+ * @param inSampleSize - The window size of the insample.
+ * @param outOfSampleSize - The window size of the out of sample.
+ * @return The fingerprint.
+ **/
+uint64_t MarkowitzModelBacktester::calculateFingerprint(const ReturnsView &returnsMatrix, const PortfolioOptimisationModel &model, const vector<double> &targetReturns, int inSampleSize, int outOfSampleSize)
+{
+    // The layout of the records is included, so that records of another layout are not resumed from.
+    int parameters[] = {(int)returnsMatrix.getNumOfAssets(), inSampleSize, outOfSampleSize, scheme, stepSize, numOfWindowRecordValues};
+
+    // A checkpoint is only resumed by the same model with the same parameters.
+    const char *modelTypeName = typeid(model).name();
+
+    uint64_t fingerprint = model.hashParameters(calculateFnv1aHash(modelTypeName, strlen(modelTypeName)));
+    fingerprint = calculateFnv1aHash(returnsMatrix, fingerprint);
+    fingerprint = calculateFnv1aHash(parameters, sizeof(parameters), fingerprint);
+
+    return calculateFnv1aHash(targetReturns.data(), targetReturns.size() * sizeof(double), fingerprint);
 }
 
 /**
@@ -99,7 +703,7 @@ void MarkowitzModelBacktester::recordBacktestResults(const vector<vector<double>
  * @param numOfRows - The number of rows.
  * @param numOfColumns - The number of columns.
  **/
-void MarkowitzModelBacktester::writeToCsv(vector<vector<double> > backtestResults, vector<double> targetReturns, string filename, int numOfRows, int numOfColumns)
+void MarkowitzModelBacktester::writeToCsv(const vector<vector<double> > &backtestResults, const vector<double> &targetReturns, const string &filename, int numOfRows, int numOfColumns)
 {
     ofstream resultsFile;
     resultsFile.open(filename);
@@ -111,7 +715,7 @@ void MarkowitzModelBacktester::writeToCsv(vector<vector<double> > backtestResult
     {
         resultsFile << i + 1 << ",";
     }
-    resultsFile << endl;
+    resultsFile << "\n";
 
     // Write out backtest returns row by row into CSV file.
     for (int i = 0; i < numOfRows; i++)
@@ -129,82 +733,22 @@ void MarkowitzModelBacktester::writeToCsv(vector<vector<double> > backtestResult
             resultsFile << backtestResults[i][j] << ",";
         }
 
-        resultsFile << endl;
+        // The file is flushed once, on closing, rather than per row.
+        resultsFile << "\n";
     }
 
     resultsFile.close();
 }
 
-/**
- * Calculates the Sharpe Ratio of the portfolio that corresponds to the
- * given weights.
- * 
- * @param returnsMatrix - The matrix of time-indexed returns.
- * @param returnsStartIdx - The "first day" of the sample of returns.
- * @param returnsEndIdx - The "last day" of the sample of returns.
- * @param weights - The portfolio weights.
- * @return The Sharpe ratio.
- **/
-double MarkowitzModelBacktester::calculateSharpeRatio(const vector<vector<double> > &returnsMatrix, int returnsStartIdx, int returnsEndIdx, vector<double> weights)
-{
-    vector<vector<double> > weightsColumnVector = convertFromRowToColumnVector(weights);
-    double portfolioMeanReturn = calculatePortfolioMeanReturn(returnsMatrix, returnsStartIdx, returnsEndIdx, weightsColumnVector);
-    double portfolioStandardDeviation = calculatePortfolioStandardDeviation(returnsMatrix, returnsStartIdx, returnsEndIdx, weightsColumnVector);
-
-    return (portfolioMeanReturn - riskFreeRate) / portfolioStandardDeviation;
-}
-
-/**
- * Calculate the mean return of the portfolio that corresponds to the
- * given weights.
- * 
- * @param returnsMatrix - The matrix of time-indexed returns.
- * @param returnsStartIdx - The "first day" of the sample of returns.
- * @param returnsEndIdx - The "last day" of the sample of returns.
- * @param weights - The portfolio weights in column form.
- * @return The average return of the portfolio.
- **/
-double MarkowitzModelBacktester::calculatePortfolioMeanReturn(const vector<vector<double> > &returnsMatrix, int returnsStartIdx, int returnsEndIdx, vector<vector<double> > weights)
-{
-    vector<vector<double> > assetMeanReturns = calculateMeanReturns(returnsMatrix, returnsStartIdx, returnsEndIdx);
-    vector<double> assetMeanReturnsRowVector = convertFromColumnToRowVector(assetMeanReturns);
-    vector<vector<double> > portfolioMeanReturn = multiplyMatrices(assetMeanReturnsRowVector, weights);
-
-    return portfolioMeanReturn[0][0];
-}
+// const ReturnsView &returnsMatrix, int returnsStartIdx, int returnsEndIdx, vector<double> weightsTranspose
 
 /**
- * Calculate the standard deviation of the portfolio that corresponds to the
- * given weights.
- * 
- * @param returnsMatrix - The matrix of time-indexed returns.
- * @param returnsStartIdx - The "first day" of the sample of returns.
- * @param returnsEndIdx - The "last day" of the sample of returns.
- * @param weights - The portfolio weights in column vector form.
- * @return The standard deviation of the portfolio.
- **/
-double MarkowitzModelBacktester::calculatePortfolioStandardDeviation(const vector<vector<double> > &returnsMatrix, int returnsStartIdx, int returnsEndIdx, vector<vector<double> > weights)
-{
-    vector<vector<double> > covarianceMatrix = estimateCovarianceMatrix(returnsMatrix, returnsStartIdx, returnsEndIdx);
-    vector<double> weightsTranspose = convertFromColumnToRowVector(weights);
-
-    vector<vector<double> > covarianceWeights = multiplyMatrices(covarianceMatrix, weights);
-    vector<vector<double> > weightsTransposeCovarianceWeights = multiplyMatrices(weightsTranspose, covarianceWeights);
-
-    double portfolioVariance = weightsTransposeCovarianceWeights[0][0];
-
-    return sqrt(portfolioVariance);
-}
-
-// const vector<vector<double> > &returnsMatrix, int returnsStartIdx, int returnsEndIdx, vector<double> weightsTranspose
-
-/**
- * Initialise target returns - i.e. values starting from zero, increasing
- * in increment of 0.005 and ending in 0.01.
+ * Returns the default grid of target returns: values starting from 0.005,
+ * increasing in increments of 0.005 and ending in 0.1.
  * 
  * @return The target returns.
  **/
-vector<double> MarkowitzModelBacktester::initialiseTargetReturns()
+vector<double> MarkowitzModelBacktester::getDefaultTargetReturns()
 {
     int numOfTargetReturns = 20;
     double value = 1. / 200;
@@ -218,4 +762,20 @@ vector<double> MarkowitzModelBacktester::initialiseTargetReturns()
     }
 
     return targetReturns;
+}
+
+/**
+ * Initialise target returns - i.e. those set by `setTargetReturns`, or else
+ * the default grid, see `getDefaultTargetReturns`.
+ * 
+ * @return The target returns.
+ **/
+vector<double> MarkowitzModelBacktester::initialiseTargetReturns()
+{
+    if (!this->targetReturns.empty())
+    {
+        return this->targetReturns;
+    }
+
+    return getDefaultTargetReturns();
 }
\ No newline at end of file
@@ -4,15 +4,40 @@
 #include <fstream>
 #include <iostream>
 #include <math.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <typeinfo>
 #include <vector>
+#include "async_result_writer.h"
+#include "backtest_checkpoint.h"
 #include "backtester.h"
 #include "matrix.h"
+#include "performance_metrics.h"
+#include "results_store.h"
+#include "thread_pool.h"
 #include "utils.h"
+#include "walk_forward_schedule.h"
 
 using namespace std;
 
+/**
+ * The out of sample results of a backtest. Each grid has a row per window,
+ * holding a value per target return, and grows as the windows are run.
+ **/
+struct BacktestResults
+{
+    vector<vector<double> > returns;
+    vector<vector<double> > sharpeRatios;
+    vector<vector<double> > standardDeviations;
+    vector<vector<double> > maxDrawdowns;
+
+    // Turnover from the previous window's portfolio (from cash for the first window).
+    vector<vector<double> > turnovers;
+};
+
 /**
  * Represents a backtester for the markowitz model. Assesses the performance of this
  * model both in an in sample context and an out of sample context.
@@ -20,6 +45,89 @@ using namespace std;
 class MarkowitzModelBacktester : public virtual Backtester
 {
 public:
+    /**
+     * Constructs a backtester.
+     * 
+     * @param numOfThreads - The number of threads to run the backtest on. Above one, the
+     *                       windows are optimised in parallel, so the model's
+     *                       `calculatePortfolioWeights` must be reentrant.
+     *                       Non-positive values mean one thread per hardware thread.
+     * @param scheme - How the in sample period moves between windows.
+     * @param stepSize - The number of days between consecutive windows.
+     *                   Non-positive values mean the out of sample size.
+     **/
+    MarkowitzModelBacktester(int numOfThreads = 1, WalkForwardScheme scheme = ROLLING, int stepSize = 0);
+
+    /**
+     * Checkpoints every completed window to the given file. A later run of the
+     * same backtest on the same data resumes from the windows in the file. The
+     * shard files of a sharded backtest are named after the file, see
+     * `getShardFileName`, so that its shards resume too.
+     * 
+     * @param fileName - The name of the checkpoint file.
+     **/
+    void enableCheckpointing(const string &fileName);
+
+    /**
+     * Also stores the results of every window, target return by target return,
+     * in the given binary columnar file, together with the portfolio weights
+     * and the statistics of the solve. See `ResultsStore` for the format.
+     * 
+     * @param fileName - The name of the results store file.
+     **/
+    void enableResultsStore(const string &fileName);
+
+    /**
+     * Runs only one shard of the windows, e.g. in one of several processes.
+     * The shard's windows are recorded to its shard file, which is also its
+     * checkpoint, instead of to the CSV files; `mergeShards` then combines
+     * the shard files.
+     * 
+     * @param shardIdx - The index of the shard, in [0, numOfShards).
+     * @param numOfShards - The number of shards.
+     **/
+    void enableSharding(int shardIdx, int numOfShards);
+
+    /**
+     * Backtests the portfolios of the given target returns instead of the
+     * default grid, see `initialiseTargetReturns`.
+     * 
+     * @param targetReturns - The target returns. Empty restores the default grid.
+     **/
+    void setTargetReturns(const vector<double> &targetReturns);
+
+    /**
+     * Returns the default grid of target returns: values starting from 0.005,
+     * increasing in increments of 0.005 and ending in 0.1.
+     * 
+     * @return The target returns.
+     **/
+    static vector<double> getDefaultTargetReturns();
+
+    /**
+     * Combines the shard files written by the shards of a backtest into the
+     * CSV files that a single run of the backtest writes. The shard files are
+     * then deleted, unless they are checkpoints kept by request.
+     * 
+     * @param returnsMatrix - The matrix of returns.
+     * @param model - The portfolio optimisation model that the shards ran.
+     * @param inSampleSize - The window size of the insample.
+     * @param outOfSampleSize - The window size of the out of sample.
+     * @param numOfShards - The number of shards.
+     **/
+    void mergeShards(const ReturnsView &returnsMatrix, const PortfolioOptimisationModel &model, int inSampleSize, int outOfSampleSize, int numOfShards);
+
+    /**
+     * Returns the name of the file that the given shard of a backtest records to:
+     * the checkpoint file's name with the shard appended, if checkpointing is
+     * enabled, or otherwise a name in the working directory.
+     * 
+     * @param shardIdx - The index of the shard.
+     * @param numOfShards - The number of shards.
+     * @return The name of the shard file.
+     **/
+    string getShardFileName(int shardIdx, int numOfShards) const;
+
     /**
      * Evaluates the given models performance on the given data set `returnsMatrix`.
      * 
@@ -28,13 +136,54 @@ public:
      * @param inSampleSize - The window size of the insample.
      * @param outOfSampleSize - The window size of the out of sample.
      **/
-    void evaluatePerformance(const vector<vector<double> > &returnsMatrix, PortfolioOptimisationModel &model, int inSampleSize, int outOfSampleSize);
+    void evaluatePerformance(const ReturnsView &returnsMatrix, PortfolioOptimisationModel &model, int inSampleSize, int outOfSampleSize);
+
+    /**
+     * Evaluates the given models performance on the given asset major or
+     * time major panel of returns, which is read in place, without a copy.
+     * The portfolios of a panel in `portfolioReturnSeriesLayout` are
+     * evaluated a day at a time, and those of any other an asset at a time.
+     * 
+     * @param returnsPanel - The panel of returns.
+     * @param model - The portfolio optimisation model.
+     * @param inSampleSize - The window size of the insample.
+     * @param outOfSampleSize - The window size of the out of sample.
+     **/
+    void evaluatePerformance(const ReturnsPanel &returnsPanel, PortfolioOptimisationModel &model, int inSampleSize, int outOfSampleSize);
 
 private:
+    // The number of threads to run the backtest on.
+    int numOfThreads;
+
+    // The walk forward schedule of the windows.
+    WalkForwardScheme scheme;
+    int stepSize;
+
+    // The target returns to backtest, or empty for the default grid.
+    vector<double> targetReturns;
+
+    // The checkpoint file, if checkpointing is enabled.
+    string checkpointFileName;
+
+    // The binary results store, if enabled.
+    string resultsStoreFileName;
+
+    // The returns to evaluate portfolios on, in `portfolioReturnSeriesLayout`,
+    // or NULL to evaluate them on the matrix of returns.
+    const ReturnsPanel *evaluationReturnsPanel;
+
+    // The shard of the windows to run, when split over several processes.
+    int shardIdx;
+    int numOfShards;
+
     // The risk free rate used to calculate sharpe ratios.
     // Sources from UK risk free rate data between 2015 and 2019.
     const double riskFreeRate = 0.021;
 
+    // The number of completed windows that may wait to be written, which
+    // bounds the memory held by their portfolio weights.
+    const int numOfQueuedWindows = 64;
+
     /**
      * Writes out all backtest returns for different portfolios and
      * different sample period to a csv file. Each portfolio
@@ -47,57 +196,133 @@ private:
      * @param outOfSampleSize - The window size of the out of sample.
      * @param numOfReturns - The number of returns in scope
      **/
-    void recordBacktestResults(const vector<vector<double> > &returnsMatrix, PortfolioOptimisationModel &model, vector<double> targetReturns, int inSampleSize, int outOfSampleSize, int numOfReturns);
+    void recordBacktestResults(const ReturnsView &returnsMatrix, PortfolioOptimisationModel &model, vector<double> targetReturns, int inSampleSize, int outOfSampleSize, int numOfReturns);
 
     /**
-     * Writes backtest results to CSV corresponding to the given filename.
+     * Writes the results of every window of a backtest to the CSV files.
      * 
-     * @param backtestResults - The backtest results.
+     * @param results - The backtest results.
      * @param targetReturns - The target returns.
-     * @param filename - The string filename.
-     * @param numOfRows - The number of rows.
-     * @param numOfColumns - The number of columns.
      **/
-    void writeToCsv(vector<vector<double> > backtestResults, vector<double> targetReturns, string filename, int numOfRows, int numOfColumns);
+    void writeResults(const BacktestResults &results, const vector<double> &targetReturns);
+
+    /**
+     * Optimises the portfolios for every target return on the in sample period
+     * of one window, and evaluates their out of sample performance. Each portfolio
+     * is evaluated from its realised out of sample return series, in O(no_of_assets
+     * x no_of_days) rather than through an out of sample covariance matrix, and the
+     * series of all the portfolios come from a single matrix product.
+     * 
+     * @param returnsMatrix - The matrix of returns.
+     * @param model - The portfolio optimisation model.
+     * @param targetReturns - The target returns.
+     * @param window - The in sample and out of sample periods of the window.
+     * @param fixedWeights - Weights already fitted on the window's in sample period,
+     *                       one row per target return, or NULL to fit them.
+     * @param performances - Populated with the out of sample performance per target return.
+     * @param solverStatistics - Populated with the statistics of the solve per target return.
+     * @return The in sample portfolio weights, one row per target return.
+     **/
+    vector<vector<double> > runBacktestWindow(const ReturnsView &returnsMatrix, PortfolioOptimisationModel &model, const vector<double> &targetReturns, const BacktestWindow &window, const vector<vector<double> > *fixedWeights, vector<PortfolioPerformance> &performances, vector<SolverStatistics> &solverStatistics);
 
     /**
-     * Calculates the Sharpe Ratio of the portfolio that corresponds to the
-     * given weights.
+     * Appends the results of the next window to the backtest results.
      * 
-     * @param returnsMatrix - The matrix of time-indexed returns.
-     * @param returnsStartIdx - The "first day" of the sample of returns.
-     * @param returnsEndIdx - The "last day" of the sample of returns.
-     * @param weights - The portfolio weights.
-     * @return The Sharpe ratio.
+     * @param performances - The out of sample performance per target return.
+     * @param turnovers - The turnover per target return.
+     * @param results - The backtest results, each grid of which gains a row.
      **/
-    double calculateSharpeRatio(const vector<vector<double> > &returnsMatrix, int returnsStartIdx, int returnsEndIdx, vector<double> weights);
+    void appendWindowResults(const vector<PortfolioPerformance> &performances, const vector<double> &turnovers, BacktestResults &results);
 
     /**
-     * Calculate the mean return of the portfolio that corresponds to the
-     * given weights.
+     * Writes a batch of window results: appends them to the backtest results,
+     * checkpoints the computed ones, and stores them all in the results store.
+     * Runs on the writer thread.
      * 
-     * @param returnsMatrix - The matrix of time-indexed returns.
-     * @param returnsStartIdx - The "first day" of the sample of returns.
-     * @param returnsEndIdx - The "last day" of the sample of returns.
-     * @param weights - The portfolio weights in column form.
-     * @return The average return of the portfolio.
+     * @param batch - The window results, in window order.
+     * @param targetReturns - The target returns.
+     * @param results - The backtest results, each grid of which gains a row per window.
+     * @param resultsStore - The results store, or NULL if it is not enabled.
+     * @param checkpoint - The checkpoint, or NULL if checkpointing is not enabled.
      **/
-    double calculatePortfolioMeanReturn(const vector<vector<double> > &returnsMatrix, int returnsStartIdx, int returnsEndIdx, vector<vector<double> > weights);
+    void writeWindowResults(vector<BacktestWindowResults> &batch, const vector<double> &targetReturns, BacktestResults &results, ResultsStore *resultsStore, BacktestCheckpoint *checkpoint);
 
     /**
-     * Calculate the standard deviation of the portfolio that corresponds to the
-     * given weights.
+     * Creates the results store, with room for every window of the backtest.
      * 
-     * @param returnsMatrix - The matrix of time-indexed returns.
-     * @param returnsStartIdx - The "first day" of the sample of returns.
-     * @param returnsEndIdx - The "last day" of the sample of returns.
-     * @param weights - The portfolio weights in column vector form.
-     * @return The standard deviation of the portfolio.
+     * @param numOfWindows - The number of windows.
+     * @param numOfTargetReturns - The number of target returns.
+     * @param numOfAssets - The number of assets.
+     * @return The results store, or NULL if it is not enabled.
+     **/
+    ResultsStore *createResultsStore(int numOfWindows, int numOfTargetReturns, int numOfAssets);
+
+    /**
+     * Stages the results of a window in the results store, one row per target
+     * return. The rows are written on the store's next commit.
+     * 
+     * @param resultsStore - The results store.
+     * @param window - The in sample and out of sample periods of the window.
+     * @param targetReturns - The target returns.
+     * @param performances - The out of sample performance per target return.
+     * @param turnovers - The turnover per target return.
+     * @param weights - The portfolio weights, one row per target return.
+     * @param solverStatistics - The statistics of the solve per target return.
+     **/
+    void storeWindowResults(ResultsStore &resultsStore, const BacktestWindow &window, const vector<double> &targetReturns, const vector<PortfolioPerformance> &performances, const vector<double> &turnovers, const vector<vector<double> > &weights, const vector<SolverStatistics> &solverStatistics);
+
+    /**
+     * Packs the results of a window into a checkpoint record: the performance,
+     * turnover and solver statistics of each target return, followed by the
+     * portfolio weights, from which the turnover of the next window is calculated.
+     * 
+     * @param performances - The out of sample performance per target return.
+     * @param turnovers - The turnover per target return.
+     * @param solverStatistics - The statistics of the solve per target return.
+     * @param weights - The portfolio weights, one row per target return.
+     * @return The record.
+     **/
+    vector<double> createWindowRecord(const vector<PortfolioPerformance> &performances, const vector<double> &turnovers, const vector<SolverStatistics> &solverStatistics, const vector<vector<double> > &weights);
+
+    /**
+     * Unpacks the results of a window from a checkpoint record.
+     * 
+     * @param record - The record.
+     * @param performances - Populated with the out of sample performance per target return.
+     * @param turnovers - Populated with the turnover per target return.
+     * @param solverStatistics - Populated with the statistics of the solve per target return.
+     * @param weights - The portfolio weights, one row per target return, which must
+     *                  already have their dimensions. Populated from the record.
+     **/
+    void restoreWindowRecord(const vector<double> &record, vector<PortfolioPerformance> &performances, vector<double> &turnovers, vector<SolverStatistics> &solverStatistics, vector<vector<double> > &weights);
+
+    /**
+     * Returns a fingerprint of the backtest configuration and the data, which
+     * identifies the backtest that wrote a checkpoint.
+     * 
+     * @param returnsMatrix - The matrix of returns.
+     * @param model - The portfolio optimisation model.
+     * @param targetReturns - The target returns.
+     * @param inSampleSize - The window size of the insample.
+     * @param outOfSampleSize - The window size of the out of sample.
+     * @return The fingerprint.
+     **/
+    uint64_t calculateFingerprint(const ReturnsView &returnsMatrix, const PortfolioOptimisationModel &model, const vector<double> &targetReturns, int inSampleSize, int outOfSampleSize);
+
+    /**
+     * Writes backtest results to CSV corresponding to the given filename.
+     * 
+     * @param backtestResults - The backtest results.
+     * @param targetReturns - The target returns.
+     * @param filename - The string filename.
+     * @param numOfRows - The number of rows.
+     * @param numOfColumns - The number of columns.
      **/
-    double calculatePortfolioStandardDeviation(const vector<vector<double> > &returnsMatrix, int returnsStartIdx, int returnsEndIdx, vector<vector<double> > weights);
+    void writeToCsv(const vector<vector<double> > &backtestResults, const vector<double> &targetReturns, const string &filename, int numOfRows, int numOfColumns);
 
     /**
-     * Initialise target returns.
+     * Initialise target returns: those set by `setTargetReturns`, or else
+     * the default grid.
      * 
      * @return The target returns.
      **/
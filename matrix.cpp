@@ -213,7 +213,7 @@ vector<vector<T> > applyBinaryOperatorToMatrices(vector<vector<T> > matrix, vect
  * @return The transpose of the matrix.
  **/
 template <typename T>
-vector<vector<T> > getMatrixTranspose(vector<vector<T> > &matrix)
+vector<vector<T> > getMatrixTranspose(const vector<vector<T> > &matrix)
 {
     int numberOfRows = matrix[0].size();
     int numberOfColumns = matrix.size();
@@ -360,7 +360,7 @@ template vector<vector<double> > subtractMatrices(vector<vector<double> > matrix
 template double add(double x, double y);
 template double subtract(double x, double y);
 template vector<vector<double> > applyBinaryOperatorToMatrices(vector<vector<double> > matrix, vector<vector<double> > otherMatrix, double (*operatorFunction)(double, double));
-template vector<vector<double> > getMatrixTranspose(vector<vector<double> > &matrix);
+template vector<vector<double> > getMatrixTranspose(const vector<vector<double> > &matrix);
 template vector<double> convertFromColumnToRowVector(vector<vector<double> > &columnVector);
 template vector<vector<double> > convertFromRowToColumnVector(vector<double> &rowVector);
 template vector<vector<double> > copyMatrix(vector<vector<double> > &matrix);
@@ -45,7 +45,7 @@ vector<vector<T> > multiplyMatrices(vector<T> &rowVector, vector<vector<T> > &ot
  * @return The transpose of the matrix.
  **/
 template <typename T>
-vector<vector<T> > getMatrixTranspose(vector<vector<T> > &matrix);
+vector<vector<T> > getMatrixTranspose(const vector<vector<T> > &matrix);
 
 /**
  * Multiplies each element in a matrix with a constant.
@@ -0,0 +1,244 @@
+#include "performance_metrics.h"
+
+/**
+ * Returns the realised returns of the portfolio with the given weights on each day
+ * in the (inclusive) range bounded by `returnsStartIdx` and `returnsEndIdx`, i.e.
+ * r_t = w . R_t. Missing (NaN) returns are treated as zero, as a halted asset
+ * neither gains nor loses.
+ *
+ * @param returnsMatrix - The matrix of time-indexed returns.
+ * @param returnsStartIdx - The "first day" of the sample of returns.
+ * @param returnsEndIdx - The "last day" of the sample of returns.
+ * @param weights - The portfolio weights.
+ * @return The portfolio return series.
+ **/
+vector<double> calculatePortfolioReturnSeries(const ReturnsView &returnsMatrix, int returnsStartIdx, int returnsEndIdx, const vector<double> &weights)
+{
+    int numOfAssets = returnsMatrix.getNumOfAssets();
+    int numOfDays = returnsEndIdx + 1 - returnsStartIdx;
+
+    vector<double> portfolioReturns(numOfDays, 0);
+    vector<double> windowReturns;
+
+    // Walk each asset's returns contiguously, accumulating its weighted
+    // contribution to every day of the series.
+    for (int assetIdx = 0; assetIdx < numOfAssets; assetIdx++)
+    {
+        const double *returns = returnsMatrix.readAssetReturns(assetIdx, returnsStartIdx, returnsEndIdx, windowReturns);
+        double weight = weights[assetIdx];
+
+        for (int t = 0; t < numOfDays; t++)
+        {
+            portfolioReturns[t] += weight * (returns[t] == returns[t] ? returns[t] : 0);
+        }
+    }
+
+    return portfolioReturns;
+}
+
+/**
+ * Returns the realised return series of several portfolios at once, i.e. the
+ * product W . R of the stacked weights with the returns over the (inclusive)
+ * range bounded by `returnsStartIdx` and `returnsEndIdx`. Row p is identical to
+ * the series given by `calculatePortfolioReturnSeries` for portfolio p.
+ *
+ * Each asset's returns are cleaned of missing values once and then streamed
+ * into every portfolio's row, so the cost of a portfolio is one multiply-add
+ * per asset per day.
+ *
+ * @param returnsMatrix - The matrix of time-indexed returns.
+ * @param returnsStartIdx - The "first day" of the sample of returns.
+ * @param returnsEndIdx - The "last day" of the sample of returns.
+ * @param portfolioWeights - The weights of each portfolio, one row per portfolio.
+ * @return The (no_of_portfolios x no_of_days) matrix of portfolio returns.
+ **/
+vector<vector<double> > calculatePortfolioReturnSeries(const ReturnsView &returnsMatrix, int returnsStartIdx, int returnsEndIdx, const vector<vector<double> > &portfolioWeights)
+{
+    int numOfAssets = returnsMatrix.getNumOfAssets();
+    int numOfPortfolios = portfolioWeights.size();
+    int numOfDays = returnsEndIdx + 1 - returnsStartIdx;
+
+    vector<vector<double> > portfolioReturns(numOfPortfolios, vector<double>(numOfDays, 0));
+    vector<double> returns(numOfDays);
+    vector<double> windowReturns;
+
+    for (int assetIdx = 0; assetIdx < numOfAssets; assetIdx++)
+    {
+        const double *assetReturns = returnsMatrix.readAssetReturns(assetIdx, returnsStartIdx, returnsEndIdx, windowReturns);
+
+        for (int t = 0; t < numOfDays; t++)
+        {
+            returns[t] = assetReturns[t] == assetReturns[t] ? assetReturns[t] : 0;
+        }
+
+        for (int p = 0; p < numOfPortfolios; p++)
+        {
+            double weight = portfolioWeights[p][assetIdx];
+            double *series = &portfolioReturns[p][0];
+
+            for (int t = 0; t < numOfDays; t++)
+            {
+                series[t] += weight * returns[t];
+            }
+        }
+    }
+
+    return portfolioReturns;
+}
+
+/**
+ * Accumulates the realised return series of several portfolios from a time
+ * major panel whose returns are stored as `Real`, in double precision.
+ *
+ * @param returnsPanel - The time major panel of returns.
+ * @param returnsStartIdx - The "first day" of the sample of returns.
+ * @param portfolioWeights - The weights of each portfolio, one row per portfolio.
+ * @param portfolioReturns - The (no_of_portfolios x no_of_days) matrix of portfolio
+ *                           returns, populated with the series.
+ **/
+template <typename Real>
+static void accumulatePortfolioReturnSeries(const ReturnsPanel &returnsPanel, int returnsStartIdx, const vector<vector<double> > &portfolioWeights, vector<vector<double> > &portfolioReturns)
+{
+    int numOfAssets = returnsPanel.getNumOfAssets();
+    int numOfPortfolios = portfolioWeights.size();
+    int numOfDays = numOfPortfolios > 0 ? portfolioReturns[0].size() : 0;
+
+    vector<double> returns(numOfAssets);
+
+    for (int t = 0; t < numOfDays; t++)
+    {
+        const Real *dayReturns = returnsPanel.getDayReturns<Real>(returnsStartIdx + t);
+
+        for (int assetIdx = 0; assetIdx < numOfAssets; assetIdx++)
+        {
+            returns[assetIdx] = dayReturns[assetIdx] == dayReturns[assetIdx] ? dayReturns[assetIdx] : 0;
+        }
+
+        for (int p = 0; p < numOfPortfolios; p++)
+        {
+            const double *weights = &portfolioWeights[p][0];
+            double portfolioReturn = 0;
+
+            for (int assetIdx = 0; assetIdx < numOfAssets; assetIdx++)
+            {
+                portfolioReturn += weights[assetIdx] * returns[assetIdx];
+            }
+
+            portfolioReturns[p][t] = portfolioReturn;
+        }
+    }
+}
+
+/**
+ * Returns the realised return series of several portfolios at once, as the
+ * matrix overload does, from a panel in `portfolioReturnSeriesLayout`. Each
+ * day's returns are contiguous, so every portfolio's return on the day is a
+ * dot product over contiguous memory. The returns may be stored as floats,
+ * but are always accumulated as doubles.
+ *
+ * The assets are summed in the same order as by the matrix overload, so the
+ * two give identical results on a panel of doubles.
+ *
+ * @param returnsPanel - The time major panel of returns.
+ * @param returnsStartIdx - The "first day" of the sample of returns.
+ * @param returnsEndIdx - The "last day" of the sample of returns.
+ * @param portfolioWeights - The weights of each portfolio, one row per portfolio.
+ * @return The (no_of_portfolios x no_of_days) matrix of portfolio returns.
+ **/
+vector<vector<double> > calculatePortfolioReturnSeries(const ReturnsPanel &returnsPanel, int returnsStartIdx, int returnsEndIdx, const vector<vector<double> > &portfolioWeights)
+{
+    int numOfDays = returnsEndIdx + 1 - returnsStartIdx;
+
+    vector<vector<double> > portfolioReturns(portfolioWeights.size(), vector<double>(numOfDays, 0));
+
+    if (returnsPanel.getPrecision() == FLOAT32_RETURNS)
+    {
+        accumulatePortfolioReturnSeries<float>(returnsPanel, returnsStartIdx, portfolioWeights, portfolioReturns);
+    }
+    else
+    {
+        accumulatePortfolioReturnSeries<double>(returnsPanel, returnsStartIdx, portfolioWeights, portfolioReturns);
+    }
+
+    return portfolioReturns;
+}
+
+/**
+ * Evaluates the performance of a portfolio from its realised return series,
+ * in a single pass.
+ *
+ * The mean and variance are accumulated with Welford's algorithm, and the
+ * drawdown tracks compounded wealth (starting at 1) against its running peak.
+ *
+ * @param portfolioReturns - The portfolio return series.
+ * @param riskFreeRate - The risk free rate used in the Sharpe ratio.
+ * @return The performance of the portfolio.
+ **/
+PortfolioPerformance evaluatePortfolioReturnSeries(const vector<double> &portfolioReturns, double riskFreeRate)
+{
+    int numOfDays = portfolioReturns.size();
+
+    double meanReturn = 0;
+    double sumOfSquaredDeviations = 0;
+    double wealth = 1;
+    double peakWealth = 1;
+    double maxDrawdown = 0;
+
+    for (int t = 0; t < numOfDays; t++)
+    {
+        double deviation = portfolioReturns[t] - meanReturn;
+        meanReturn += deviation / (t + 1);
+        sumOfSquaredDeviations += deviation * (portfolioReturns[t] - meanReturn);
+
+        wealth *= 1 + portfolioReturns[t];
+        peakWealth = max(peakWealth, wealth);
+        maxDrawdown = max(maxDrawdown, 1 - wealth / peakWealth);
+    }
+
+    PortfolioPerformance performance;
+    performance.meanReturn = meanReturn;
+    performance.standardDeviation = sqrt(sumOfSquaredDeviations / (numOfDays - 1));
+    performance.sharpeRatio = (meanReturn - riskFreeRate) / performance.standardDeviation;
+    performance.maxDrawdown = maxDrawdown;
+
+    return performance;
+}
+
+/**
+ * Evaluates the performance of every portfolio from its row of realised returns.
+ *
+ * @param portfolioReturns - The portfolio return series, one row per portfolio.
+ * @param riskFreeRate - The risk free rate used in the Sharpe ratio.
+ * @return The performance of each portfolio.
+ **/
+vector<PortfolioPerformance> evaluatePortfolioReturnSeries(const vector<vector<double> > &portfolioReturns, double riskFreeRate)
+{
+    vector<PortfolioPerformance> performances(portfolioReturns.size());
+
+    for (int p = 0; p < portfolioReturns.size(); p++)
+    {
+        performances[p] = evaluatePortfolioReturnSeries(portfolioReturns[p], riskFreeRate);
+    }
+
+    return performances;
+}
+
+/**
+ * Returns the turnover from rebalancing between two sets of portfolio
+ * weights, i.e. the sum of the absolute changes in the weights.
+ *
+ * @param previousWeights - The portfolio weights before rebalancing.
+ * @param weights - The portfolio weights after rebalancing.
+ * @return The turnover.
+ **/
+double calculateTurnover(const vector<double> &previousWeights, const vector<double> &weights)
+{
+    double turnover = 0;
+
+    for (int i = 0; i < weights.size(); i++)
+    {
+        turnover += fabs(weights[i] - previousWeights[i]);
+    }
+
+    return turnover;
+}
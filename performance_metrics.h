@@ -0,0 +1,102 @@
+#ifndef performance_metrics_h
+#define performance_metrics_h
+
+#include <algorithm>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+#include "returns_panel.h"
+
+using namespace std;
+
+// The layout that the panel overload of `calculatePortfolioReturnSeries`
+// reads returns in, as it evaluates every portfolio a day at a time.
+const ReturnsLayout portfolioReturnSeriesLayout = TIME_MAJOR;
+
+/**
+ * The out of sample performance of a portfolio.
+ **/
+struct PortfolioPerformance
+{
+    double meanReturn;
+    double standardDeviation;
+    double sharpeRatio;
+
+    // The largest fall in compounded wealth from a previous peak, as a fraction of the peak.
+    double maxDrawdown;
+};
+
+/**
+ * Returns the realised returns of the portfolio with the given weights on each day
+ * in the (inclusive) range bounded by `returnsStartIdx` and `returnsEndIdx`, i.e.
+ * r_t = w . R_t. Missing (NaN) returns are treated as zero, as a halted asset
+ * neither gains nor loses.
+ *
+ * @param returnsMatrix - The matrix of time-indexed returns.
+ * @param returnsStartIdx - The "first day" of the sample of returns.
+ * @param returnsEndIdx - The "last day" of the sample of returns.
+ * @param weights - The portfolio weights.
+ * @return The portfolio return series.
+ **/
+vector<double> calculatePortfolioReturnSeries(const ReturnsView &returnsMatrix, int returnsStartIdx, int returnsEndIdx, const vector<double> &weights);
+
+/**
+ * Returns the realised return series of several portfolios at once, i.e. the
+ * product W . R of the stacked weights with the returns over the (inclusive)
+ * range bounded by `returnsStartIdx` and `returnsEndIdx`. Row p is identical to
+ * the series given by `calculatePortfolioReturnSeries` for portfolio p.
+ *
+ * @param returnsMatrix - The matrix of time-indexed returns.
+ * @param returnsStartIdx - The "first day" of the sample of returns.
+ * @param returnsEndIdx - The "last day" of the sample of returns.
+ * @param portfolioWeights - The weights of each portfolio, one row per portfolio.
+ * @return The (no_of_portfolios x no_of_days) matrix of portfolio returns.
+ **/
+vector<vector<double> > calculatePortfolioReturnSeries(const ReturnsView &returnsMatrix, int returnsStartIdx, int returnsEndIdx, const vector<vector<double> > &portfolioWeights);
+
+/**
+ * Returns the realised return series of several portfolios at once, as the
+ * matrix overload does, from a panel in `portfolioReturnSeriesLayout`. Each
+ * day's returns are contiguous, so every portfolio's return on the day is a
+ * dot product over contiguous memory. The returns may be stored as floats,
+ * but are always accumulated as doubles.
+ *
+ * @param returnsPanel - The time major panel of returns.
+ * @param returnsStartIdx - The "first day" of the sample of returns.
+ * @param returnsEndIdx - The "last day" of the sample of returns.
+ * @param portfolioWeights - The weights of each portfolio, one row per portfolio.
+ * @return The (no_of_portfolios x no_of_days) matrix of portfolio returns.
+ **/
+vector<vector<double> > calculatePortfolioReturnSeries(const ReturnsPanel &returnsPanel, int returnsStartIdx, int returnsEndIdx, const vector<vector<double> > &portfolioWeights);
+
+/**
+ * Evaluates the performance of a portfolio from its realised return series,
+ * in a single pass.
+ *
+ * @param portfolioReturns - The portfolio return series.
+ * @param riskFreeRate - The risk free rate used in the Sharpe ratio.
+ * @return The performance of the portfolio.
+ **/
+PortfolioPerformance evaluatePortfolioReturnSeries(const vector<double> &portfolioReturns, double riskFreeRate);
+
+/**
+ * Evaluates the performance of every portfolio from its row of realised returns.
+ *
+ * @param portfolioReturns - The portfolio return series, one row per portfolio.
+ * @param riskFreeRate - The risk free rate used in the Sharpe ratio.
+ * @return The performance of each portfolio.
+ **/
+vector<PortfolioPerformance> evaluatePortfolioReturnSeries(const vector<vector<double> > &portfolioReturns, double riskFreeRate);
+
+/**
+ * Returns the turnover from rebalancing between two sets of portfolio
+ * weights, i.e. the sum of the absolute changes in the weights.
+ *
+ * @param previousWeights - The portfolio weights before rebalancing.
+ * @param weights - The portfolio weights after rebalancing.
+ * @return The turnover.
+ **/
+double calculateTurnover(const vector<double> &previousWeights, const vector<double> &weights);
+
+#endif
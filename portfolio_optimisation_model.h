@@ -1,10 +1,33 @@
 #ifndef PortfolioOptimisationModel_h
 #define PortfolioOptimisationModel_h
 
+#include <limits>
+#include <stdint.h>
 #include <vector>
+#include "returns_view.h"
 
 using namespace std;
 
+/**
+ * Statistics of the numerical solve for one portfolio.
+ **/
+struct SolverStatistics
+{
+    // The number of iterations taken, 0 if the portfolio was derived from
+    // others rather than solved for, or -1 if the model does not report it.
+    int numOfIterations;
+
+    // The norm of the final residual, or NaN if the model does not report it.
+    double residualNorm;
+
+    // Whether the solve stopped at its iteration limit before converging.
+    bool hasReachedIterationLimit = false;
+
+    // The number of assets left out of the solve for want of estimates, or
+    // -1 if the model does not report it.
+    int numOfExcludedAssets = -1;
+};
+
 /**
  * An abstract class for a portfolio optimisation model. This portfolio 
  * outputted is optimised by varying the weights in the portfolio.
@@ -17,13 +40,62 @@ public:
      * given subsection of time-indexed returns, as indicated by the
      * `returnsStartIdx` and `returnsEndIdx` values.
      * 
+     * Implementations should be reentrant - safe to call concurrently
+     * from several threads - so that backtests can run in parallel.
+     * 
      * @param returnsMatrix - The matrix of time-indexed returns.
      * @param returnsStartIdx - The "first day" of the sample of returns.
      * @param returnsEndIdx - The "last day" of the sample of returns.
      * @param targetReturn - The desired return to be attained by the optimal portfolio.
      * @return The optimal portfolio weights.
      **/
-    virtual vector<double> calculatePortfolioWeights(const vector<vector<double> > &returnsMatrix, int returnsStartIdx, int returnsEndIdx, double targetReturn) = 0;
+    virtual vector<double> calculatePortfolioWeights(const ReturnsView &returnsMatrix, int returnsStartIdx, int returnsEndIdx, double targetReturn) = 0;
+
+    /**
+     * Calculates and returns the optimal portfolio weights for each of the
+     * given target returns, over the same subsection of time-indexed returns.
+     * Models should override this to share the work common to every target,
+     * such as estimating the statistics of the sample.
+     * 
+     * @param returnsMatrix - The matrix of time-indexed returns.
+     * @param returnsStartIdx - The "first day" of the sample of returns.
+     * @param returnsEndIdx - The "last day" of the sample of returns.
+     * @param targetReturns - The desired returns to be attained by the optimal portfolios.
+     * @param solverStatistics - Optionally populated with the statistics of the solve
+     *                           for each target return.
+     * @return The optimal portfolio weights, one row per target return.
+     **/
+    virtual vector<vector<double> > calculatePortfolioWeights(const ReturnsView &returnsMatrix, int returnsStartIdx, int returnsEndIdx, const vector<double> &targetReturns, vector<SolverStatistics> *solverStatistics = NULL)
+    {
+        vector<vector<double> > portfolioWeights;
+
+        for (int i = 0; i < targetReturns.size(); i++)
+        {
+            portfolioWeights.push_back(calculatePortfolioWeights(returnsMatrix, returnsStartIdx, returnsEndIdx, targetReturns[i]));
+        }
+
+        if (solverStatistics != NULL)
+        {
+            SolverStatistics unknownStatistics = {-1, numeric_limits<double>::quiet_NaN()};
+            solverStatistics->assign(targetReturns.size(), unknownStatistics);
+        }
+
+        return portfolioWeights;
+    }
+
+    /**
+     * Mixes every parameter that the model's portfolios depend on into the
+     * given hash, so that stored portfolios are only reused by a model that
+     * would calculate the same ones. Models with parameters should override
+     * this.
+     * 
+     * @param hash - The hash to continue from.
+     * @return The hash.
+     **/
+    virtual uint64_t hashParameters(uint64_t hash) const
+    {
+        return hash;
+    }
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,61 @@
+#include "random_stream.h"
+
+/**
+ * Constructs a stream.
+ *
+ * @param seed - The seed shared by all the streams of an experiment.
+ * @param streamIdx - The index of this stream.
+ **/
+RandomStream::RandomStream(uint64_t seed, uint64_t streamIdx)
+{
+    this->key = mix(mix(seed) ^ (streamIdx * 0xd1b54a32d192ed03ULL));
+    this->counter = 0;
+}
+
+/**
+ * Returns the next 64 random bits of the stream.
+ *
+ * @return The random bits.
+ **/
+uint64_t RandomStream::nextBits()
+{
+    // Hashing the key with a Weyl sequence of the counter.
+    return mix(key + 0x9e3779b97f4a7c15ULL * ++counter);
+}
+
+/**
+ * Returns the next random integer of the stream, uniform in [0, bound).
+ *
+ * @param bound - The exclusive upper bound. Must be positive.
+ * @return The random integer.
+ **/
+int RandomStream::nextInt(int bound)
+{
+    // Multiply-shift mapping of 32 random bits; its bias, at most bound / 2^32,
+    // is negligible for bounds the size of a sample of returns.
+    return (int)(((nextBits() >> 32) * (uint64_t)bound) >> 32);
+}
+
+/**
+ * Returns the next random number of the stream, uniform in [0, 1).
+ *
+ * @return The random number.
+ **/
+double RandomStream::nextUniform()
+{
+    return (nextBits() >> 11) * (1.0 / 9007199254740992.0);
+}
+
+/**
+ * The SplitMix64 finaliser, a bijective mix of the 64 bits of `x`.
+ *
+ * @param x - The value to be mixed.
+ * @return The mixed value.
+ **/
+uint64_t RandomStream::mix(uint64_t x)
+{
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+
+    return x ^ (x >> 31);
+}
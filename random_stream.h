@@ -0,0 +1,61 @@
+#ifndef RandomStream_h
+#define RandomStream_h
+
+#include <stdint.h>
+
+using namespace std;
+
+/**
+ * A counter based stream of pseudo random numbers. The i-th number of a
+ * stream is a hash of the seed, the stream index and i, so any stream can
+ * be split off and regenerated independently - e.g. one stream per Monte
+ * Carlo path - and the numbers do not depend on which thread draws them.
+ **/
+class RandomStream
+{
+public:
+    /**
+     * Constructs a stream.
+     *
+     * @param seed - The seed shared by all the streams of an experiment.
+     * @param streamIdx - The index of this stream.
+     **/
+    RandomStream(uint64_t seed, uint64_t streamIdx);
+
+    /**
+     * Returns the next 64 random bits of the stream.
+     *
+     * @return The random bits.
+     **/
+    uint64_t nextBits();
+
+    /**
+     * Returns the next random integer of the stream, uniform in [0, bound).
+     *
+     * @param bound - The exclusive upper bound. Must be positive.
+     * @return The random integer.
+     **/
+    int nextInt(int bound);
+
+    /**
+     * Returns the next random number of the stream, uniform in [0, 1).
+     *
+     * @return The random number.
+     **/
+    double nextUniform();
+
+private:
+    // The hashed seed and stream index, and the index of the next number.
+    uint64_t key;
+    uint64_t counter;
+
+    /**
+     * The SplitMix64 finaliser, a bijective mix of the 64 bits of `x`.
+     *
+     * @param x - The value to be mixed.
+     * @return The mixed value.
+     **/
+    static uint64_t mix(uint64_t x);
+};
+
+#endif
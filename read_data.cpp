@@ -22,9 +22,66 @@ double stringToDouble(const string &s)
     return x;
 }
 
+/**
+ * Parses a return from a CSV field.
+ * 
+ * @param s - The field to be parsed.
+ * @return The return, or NaN (a missing return) if `s` is empty or not a double.
+ **/
+double parseReturn(const string &s)
+{
+    std::istringstream i(s);
+
+    double x;
+
+    if (!(i >> x))
+    {
+        return NAN;
+    }
+
+    return x;
+}
+
+/**
+ * Parses a return from a CSV field in place, giving the same value as
+ * `parseReturn` on a copy of the field.
+ * 
+ * @param fieldBegin - The first character of the field.
+ * @param fieldEnd - One past the last character of the field.
+ * @return The return, or NaN (a missing return) if the field is empty or not a double.
+ **/
+double parseReturn(const char *fieldBegin, const char *fieldEnd)
+{
+    if (fieldBegin == fieldEnd)
+    {
+        return NAN;
+    }
+
+    // `from_chars` also reads "inf" and "nan", which a stream rejects, so it
+    // is only used on fields that start like a decimal number.
+    const char *digits = *fieldBegin == '-' ? fieldBegin + 1 : fieldBegin;
+
+    if (digits < fieldEnd && (isdigit((unsigned char)*digits) || *digits == '.'))
+    {
+        double x;
+        from_chars_result result = from_chars(fieldBegin, fieldEnd, x);
+
+        if (result.ec == errc() && result.ptr == fieldEnd)
+        {
+            return x;
+        }
+    }
+
+    // Anything unusual - whitespace, a plus sign, trailing characters or an
+    // out of range value - is left to the stream, so that both overloads agree.
+    return parseReturn(string(fieldBegin, fieldEnd));
+}
+
 /**
  * Reads the asset returns from the file corresponding to `fileName` into
- * the `data` array.
+ * the `data` array. Returns that are empty, unparseable or beyond the end
+ * of the file are missing, and stored as NaN. Lines and fields beyond the
+ * given dimensions are ignored.
  * 
  * @param fileName The name of the file to read the asset returns from.
  * @param numOfAssets - The number of rows to read from the CSV file.
@@ -33,8 +90,7 @@ double stringToDouble(const string &s)
  **/
 vector<vector<double> > readData(const string &fileName, int numOfAssets, int numOfReturns)
 {
-    char tmp[20];
-    ifstream file(strcpy(tmp, fileName.c_str()));
+    ifstream file(fileName.c_str());
     Csv csv(file);
     string line;
 
@@ -53,16 +109,17 @@ vector<vector<double> > readData(const string &fileName, int numOfAssets, int nu
     // Allocate memory for return data.
     for (int i = 0; i < numOfAssets; i++)
     {
-        returnsMatrix[i].resize(numOfReturns, -1);
+        returnsMatrix[i].resize(numOfReturns, NAN);
     }
 
     // Read through the file line by line, reading return values into returns matrix.
     // returnsMatrix[i][j] will store the asset i, return j value.
-    for (int returnIdx = 0; csv.getline(line) != 0; returnIdx++)
+    for (int returnIdx = 0; returnIdx < numOfReturns && csv.getline(line) != 0; returnIdx++)
     {
-        for (int assetIdx = 0; assetIdx < csv.getnfield(); assetIdx++)
+        // Fields beyond the given number of assets are ignored.
+        for (int assetIdx = 0; assetIdx < numOfAssets && assetIdx < csv.getnfield(); assetIdx++)
         {
-            double temp = stringToDouble(csv.getfield(assetIdx));
+            double temp = parseReturn(csv.getfield(assetIdx));
             // cout << "Asset " << assetIdx << ", Return " << returnIdx << "=" << temp << "\n"; // TODO
             returnsMatrix[assetIdx][returnIdx] = temp;
         }
@@ -74,3 +131,238 @@ vector<vector<double> > readData(const string &fileName, int numOfAssets, int nu
 
     return returnsMatrix;
 }
+
+/**
+ * Parses the lines of a CSV file in the given range into the returns matrix.
+ * 
+ * @param rangeBegin - The first byte of the range, which starts a line.
+ * @param rangeEnd - One past the last byte of the range.
+ * @param firstReturnIdx - The return index of the first line of the range.
+ * @param returnsMatrix - The returns matrix, already of its full dimensions.
+ **/
+static void parseReturnsRange(const char *rangeBegin, const char *rangeEnd, int firstReturnIdx, vector<vector<double> > &returnsMatrix)
+{
+    CsvScanner scanner(rangeBegin, rangeEnd);
+
+    int numOfAssets = returnsMatrix.size();
+    int numOfReturns = numOfAssets > 0 ? returnsMatrix[0].size() : 0;
+
+    // Each line holds one return per asset: returnsMatrix[i][j] is asset i's return j.
+    for (int returnIdx = firstReturnIdx; returnIdx < numOfReturns && scanner.nextLine(); returnIdx++)
+    {
+        const char *fieldBegin;
+        const char *fieldEnd;
+
+        for (int assetIdx = 0; assetIdx < numOfAssets && scanner.nextField(fieldBegin, fieldEnd); assetIdx++)
+        {
+            returnsMatrix[assetIdx][returnIdx] = parseReturn(fieldBegin, fieldEnd);
+        }
+    }
+}
+
+/**
+ * Splits the bytes of a CSV file into ranges of whole lines for the given
+ * number of threads to parse, with a few ranges per thread to even out the
+ * work. Files too small to be worth splitting form a single range.
+ * 
+ * @param begin - The first byte of the file.
+ * @param end - One past the last byte of the file.
+ * @param numOfThreads - The number of threads.
+ * @return The start of every range, followed by `end`.
+ **/
+static vector<const char *> splitIntoLineRanges(const char *begin, const char *end, int numOfThreads)
+{
+    // Ranges of under a megabyte are not worth a thread.
+    const size_t minRangeSize = 1 << 20;
+
+    size_t size = end - begin;
+    int numOfRanges = numOfThreads > 1 ? max((size_t)1, min((size_t)4 * numOfThreads, size / minRangeSize)) : 1;
+
+    // Split the file evenly, moving each split forward to the start of a line.
+    vector<const char *> rangeBegins(numOfRanges + 1);
+
+    for (int i = 0; i <= numOfRanges; i++)
+    {
+        rangeBegins[i] = i < numOfRanges ? CsvScanner::findLineStart(begin, begin + size / numOfRanges * i, end) : end;
+    }
+
+    return rangeBegins;
+}
+
+/**
+ * Reads the asset returns from the file corresponding to `fileName`, as
+ * `readData` does, but maps the file into memory and parses every field in
+ * place, with no allocation or copy per line or field. Fields beyond the
+ * given dimensions are ignored, and unlike `readData`, a last line without
+ * a line ending is read.
+ * 
+ * With several threads, the file is split into byte ranges of whole lines.
+ * A first parallel pass counts the lines of each range, which fixes the
+ * return index of its first line, and a second parses every range straight
+ * into its returns. The result is identical to that of a single thread.
+ * 
+ * @param fileName The name of the file to read the asset returns from.
+ * @param numOfAssets - The number of rows to read from the CSV file.
+ * @param numOfReturns - The number of columns to read from the CSV file.
+ * @param numOfThreads - The number of threads to parse on. Non-positive
+ *                       values mean one thread per hardware thread.
+ * @return A vector of vectors representing the returns matrix.
+ **/
+vector<vector<double> > readMappedData(const string &fileName, int numOfAssets, int numOfReturns, int numOfThreads)
+{
+    MappedFile file(fileName);
+    const char *begin = file.getData();
+    const char *end = begin + file.getSize();
+
+    vector<vector<double> > returnsMatrix(numOfAssets, vector<double>(numOfReturns, NAN));
+
+    numOfThreads = ThreadPool::resolveNumOfThreads(numOfThreads);
+    vector<const char *> rangeBegins = splitIntoLineRanges(begin, end, numOfThreads);
+    int numOfRanges = rangeBegins.size() - 1;
+
+    if (numOfRanges == 1)
+    {
+        parseReturnsRange(begin, end, 0, returnsMatrix);
+
+        return returnsMatrix;
+    }
+
+    ThreadPool threadPool(numOfThreads);
+    vector<int> firstReturnIdxs(numOfRanges + 1, 0);
+
+    threadPool.parallelFor(numOfRanges, [&](int i) {
+        firstReturnIdxs[i + 1] = CsvScanner::countLines(rangeBegins[i], rangeBegins[i + 1]);
+    });
+
+    for (int i = 0; i < numOfRanges; i++)
+    {
+        firstReturnIdxs[i + 1] += firstReturnIdxs[i];
+    }
+
+    // Every range writes a disjoint set of returns.
+    threadPool.parallelFor(numOfRanges, [&](int i) {
+        parseReturnsRange(rangeBegins[i], rangeBegins[i + 1], firstReturnIdxs[i], returnsMatrix);
+    });
+
+    return returnsMatrix;
+}
+
+/**
+ * Finds the shape of the returns in the lines of a CSV file in the given range.
+ * 
+ * @param rangeBegin - The first byte of the range, which starts a line.
+ * @param rangeEnd - One past the last byte of the range.
+ * @param numOfLines - Populated with the number of lines.
+ * @param maxNumOfFields - Populated with the number of fields of the widest line.
+ **/
+static void measureReturnsRange(const char *rangeBegin, const char *rangeEnd, int &numOfLines, int &maxNumOfFields)
+{
+    CsvScanner scanner(rangeBegin, rangeEnd);
+
+    numOfLines = 0;
+    maxNumOfFields = 0;
+
+    for (; scanner.nextLine(); numOfLines++)
+    {
+        const char *fieldBegin;
+        const char *fieldEnd;
+        int numOfFields = 0;
+
+        while (scanner.nextField(fieldBegin, fieldEnd))
+        {
+            numOfFields++;
+        }
+
+        maxNumOfFields = max(maxNumOfFields, numOfFields);
+    }
+}
+
+/**
+ * Reads the asset returns from the file corresponding to `fileName` into a
+ * panel, discovering its dimensions from the file: a return per line, and
+ * an asset per field of the widest line. Returns that are empty, unparseable
+ * or absent from a shorter line are missing, and stored as NaN. A returns
+ * panel file is mapped rather than parsed, giving a read only panel.
+ * 
+ * A single thread reads the file in one streaming pass, growing the panel
+ * geometrically as lines and assets are found. Several threads first measure
+ * their ranges of the file in parallel, then parse them into a panel of the
+ * measured shape, as `readMappedData` does.
+ * 
+ * @param fileName The name of the file to read the asset returns from.
+ * @param numOfThreads - The number of threads to parse on. Non-positive
+ *                       values mean one thread per hardware thread.
+ * @return The panel of returns.
+ **/
+ReturnsPanel readReturnsPanel(const string &fileName, int numOfThreads)
+{
+    if (isReturnsPanelFile(fileName))
+    {
+        return mapReturnsPanelFile(fileName);
+    }
+
+    MappedFile file(fileName);
+    const char *begin = file.getData();
+    const char *end = begin + file.getSize();
+
+    numOfThreads = ThreadPool::resolveNumOfThreads(numOfThreads);
+    vector<const char *> rangeBegins = splitIntoLineRanges(begin, end, numOfThreads);
+    int numOfRanges = rangeBegins.size() - 1;
+
+    if (numOfRanges == 1)
+    {
+        CsvScanner scanner(begin, end);
+        vector<vector<double> > returnsMatrix;
+        int numOfReturns = 0;
+
+        for (; scanner.nextLine(); numOfReturns++)
+        {
+            const char *fieldBegin;
+            const char *fieldEnd;
+            int assetIdx = 0;
+
+            for (; scanner.nextField(fieldBegin, fieldEnd); assetIdx++)
+            {
+                // An asset first seen on a later line is missing its earlier returns.
+                if (assetIdx == returnsMatrix.size())
+                {
+                    returnsMatrix.push_back(vector<double>());
+                    returnsMatrix.back().reserve(assetIdx > 0 ? returnsMatrix[0].capacity() : 0);
+                    returnsMatrix.back().resize(numOfReturns, NAN);
+                }
+
+                returnsMatrix[assetIdx].push_back(parseReturn(fieldBegin, fieldEnd));
+            }
+
+            for (; assetIdx < returnsMatrix.size(); assetIdx++)
+            {
+                returnsMatrix[assetIdx].push_back(NAN);
+            }
+        }
+
+        // A file of empty lines has returns, but no assets to hold them.
+        return returnsMatrix.empty() ? ReturnsPanel(0, numOfReturns) : ReturnsPanel(move(returnsMatrix));
+    }
+
+    ThreadPool threadPool(numOfThreads);
+    vector<int> firstReturnIdxs(numOfRanges + 1, 0);
+    vector<int> numOfFields(numOfRanges, 0);
+
+    threadPool.parallelFor(numOfRanges, [&](int i) {
+        measureReturnsRange(rangeBegins[i], rangeBegins[i + 1], firstReturnIdxs[i + 1], numOfFields[i]);
+    });
+
+    for (int i = 0; i < numOfRanges; i++)
+    {
+        firstReturnIdxs[i + 1] += firstReturnIdxs[i];
+    }
+
+    ReturnsPanel returnsPanel(*max_element(numOfFields.begin(), numOfFields.end()), firstReturnIdxs[numOfRanges]);
+
+    // Every range writes a disjoint set of returns.
+    threadPool.parallelFor(numOfRanges, [&](int i) {
+        parseReturnsRange(rangeBegins[i], rangeBegins[i + 1], firstReturnIdxs[i], returnsPanel.getWritableReturnsMatrix());
+    });
+
+    return returnsPanel;
+}
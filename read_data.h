@@ -2,11 +2,19 @@
 #define read_data_h
 
 #include <stdio.h>
+#include <charconv>
+#include <ctype.h>
 #include <fstream>
+#include <math.h>
 #include <stdlib.h>
 #include <sstream>
 #include <vector>
 #include "csv.h"
+#include "csv_scanner.h"
+#include "mapped_file.h"
+#include "returns_panel.h"
+#include "returns_panel_file.h"
+#include "thread_pool.h"
 
 using namespace std;
 
@@ -18,9 +26,29 @@ using namespace std;
  **/
 double stringToDouble(const string &s);
 
+/**
+ * Parses a return from a CSV field.
+ * 
+ * @param s - The field to be parsed.
+ * @return The return, or NaN (a missing return) if `s` is empty or not a double.
+ **/
+double parseReturn(const string &s);
+
+/**
+ * Parses a return from a CSV field in place, giving the same value as
+ * `parseReturn` on a copy of the field.
+ * 
+ * @param fieldBegin - The first character of the field.
+ * @param fieldEnd - One past the last character of the field.
+ * @return The return, or NaN (a missing return) if the field is empty or not a double.
+ **/
+double parseReturn(const char *fieldBegin, const char *fieldEnd);
+
 /**
  * Reads the asset returns from the file corresponding to `fileName` into
- * the `data` array.
+ * the `data` array. Returns that are empty, unparseable or beyond the end
+ * of the file are missing, and stored as NaN. Lines and fields beyond the
+ * given dimensions are ignored.
  * 
  * @param fileName The name of the file to read the asset returns from.
  * @param numOfAssets - The number of rows to read from the CSV file.
@@ -29,4 +57,39 @@ double stringToDouble(const string &s);
  **/
 vector<vector<double> > readData(const string &fileName, int numOfAssets, int numOfReturns);
 
+/**
+ * Reads the asset returns from the file corresponding to `fileName`, as
+ * `readData` does, but maps the file into memory and parses every field in
+ * place, with no allocation or copy per line or field. Fields beyond the
+ * given dimensions are ignored, and unlike `readData`, a last line without
+ * a line ending is read.
+ * 
+ * With several threads, the file is split into byte ranges of whole lines.
+ * A first parallel pass counts the lines of each range, which fixes the
+ * return index of its first line, and a second parses every range straight
+ * into its returns. The result is identical to that of a single thread.
+ * 
+ * @param fileName The name of the file to read the asset returns from.
+ * @param numOfAssets - The number of rows to read from the CSV file.
+ * @param numOfReturns - The number of columns to read from the CSV file.
+ * @param numOfThreads - The number of threads to parse on. Non-positive
+ *                       values mean one thread per hardware thread.
+ * @return A vector of vectors representing the returns matrix.
+ **/
+vector<vector<double> > readMappedData(const string &fileName, int numOfAssets, int numOfReturns, int numOfThreads = 1);
+
+/**
+ * Reads the asset returns from the file corresponding to `fileName` into a
+ * panel, discovering its dimensions from the file: a return per line, and
+ * an asset per field of the widest line. Returns that are empty, unparseable
+ * or absent from a shorter line are missing, and stored as NaN. A returns
+ * panel file is mapped rather than parsed, giving a read only panel.
+ * 
+ * @param fileName The name of the file to read the asset returns from.
+ * @param numOfThreads - The number of threads to parse on. Non-positive
+ *                       values mean one thread per hardware thread.
+ * @return The panel of returns.
+ **/
+ReturnsPanel readReturnsPanel(const string &fileName, int numOfThreads = 1);
+
 #endif
\ No newline at end of file
@@ -0,0 +1,187 @@
+#include "resampled_frontier.h"
+
+/**
+ * Constructs a resampled frontier engine.
+ *
+ * @param numOfPaths - The number of bootstrap paths.
+ * @param blockSize - The number of consecutive days in each bootstrap block.
+ * @param seed - The seed of the random streams.
+ * @param numOfThreads - The number of threads to run the paths on. Above one, the
+ *                       model's `calculatePortfolioWeights` must be reentrant.
+ *                       Non-positive values mean one thread per hardware thread.
+ **/
+ResampledFrontier::ResampledFrontier(int numOfPaths, int blockSize, uint64_t seed, int numOfThreads)
+{
+    if (numOfPaths < 1 || blockSize < 1)
+    {
+        cout << "The number of paths and the block size must be positive." << endl;
+        exit(EXIT_FAILURE);
+    }
+
+    this->numOfPaths = numOfPaths;
+    this->blockSize = blockSize;
+    this->seed = seed;
+    this->numOfThreads = ThreadPool::resolveNumOfThreads(numOfThreads);
+}
+
+/**
+ * Calculates and returns the resampled portfolio weights for each of the
+ * given target returns, over the given subsection of time-indexed returns.
+ *
+ * @param returnsMatrix - The matrix of time-indexed returns.
+ * @param model - The portfolio optimisation model.
+ * @param returnsStartIdx - The "first day" of the sample of returns.
+ * @param returnsEndIdx - The "last day" of the sample of returns.
+ * @param targetReturns - The desired returns to be attained by the optimal portfolios.
+ * @return The weights averaged over the paths, one row per target return.
+ **/
+vector<vector<double> > ResampledFrontier::calculatePortfolioWeights(const ReturnsView &returnsMatrix, PortfolioOptimisationModel &model, int returnsStartIdx, int returnsEndIdx, const vector<double> &targetReturns)
+{
+    int numOfAssets = returnsMatrix.getNumOfAssets();
+    int numOfDays = returnsEndIdx + 1 - returnsStartIdx;
+    int numOfTargetReturns = targetReturns.size();
+    int numOfChunks = (numOfPaths + numOfPathsPerChunk - 1) / numOfPathsPerChunk;
+
+    if (returnsStartIdx < 0 || returnsEndIdx >= returnsMatrix.getNumOfReturns() || numOfDays < 2)
+    {
+        cout << "Returns range [" << returnsStartIdx << ", " << returnsEndIdx << "] is out of bounds." << endl;
+        exit(EXIT_FAILURE);
+    }
+
+    // The sum of the weights over the paths of each chunk.
+    vector<vector<vector<double> > > chunkSums(numOfChunks, vector<vector<double> >(numOfTargetReturns, vector<double>(numOfAssets, 0)));
+
+    // A resampled returns matrix per worker, reused by all the paths it runs.
+    ThreadPool *threadPool = numOfThreads > 1 ? new ThreadPool(numOfThreads) : NULL;
+    vector<vector<vector<double> > > workspaces(max(numOfThreads, 1), vector<vector<double> >(numOfAssets, vector<double>(numOfDays)));
+
+    function<void(int)> runChunk = [&](int chunkIdx) {
+        int workerIdx = threadPool != NULL ? threadPool->getWorkerIdx() : 0;
+        vector<vector<double> > &pathReturns = workspaces[workerIdx];
+        int lastPathIdx = min(numOfPaths, (chunkIdx + 1) * numOfPathsPerChunk);
+
+        for (int pathIdx = chunkIdx * numOfPathsPerChunk; pathIdx < lastPathIdx; pathIdx++)
+        {
+            resampleReturns(returnsMatrix, returnsStartIdx, returnsEndIdx, pathIdx, pathReturns);
+
+            vector<vector<double> > pathWeights = model.calculatePortfolioWeights(pathReturns, 0, numOfDays - 1, targetReturns);
+
+            for (int targetReturnIdx = 0; targetReturnIdx < numOfTargetReturns; targetReturnIdx++)
+            {
+                for (int assetIdx = 0; assetIdx < numOfAssets; assetIdx++)
+                {
+                    chunkSums[chunkIdx][targetReturnIdx][assetIdx] += pathWeights[targetReturnIdx][assetIdx];
+                }
+            }
+        }
+    };
+
+    if (threadPool != NULL)
+    {
+        threadPool->parallelFor(numOfChunks, runChunk);
+        delete threadPool;
+    }
+    else
+    {
+        for (int chunkIdx = 0; chunkIdx < numOfChunks; chunkIdx++)
+        {
+            runChunk(chunkIdx);
+        }
+    }
+
+    // Combine the chunks in order, so the sum does not depend on the scheduling.
+    vector<vector<double> > portfolioWeights(numOfTargetReturns, vector<double>(numOfAssets, 0));
+
+    for (int chunkIdx = 0; chunkIdx < numOfChunks; chunkIdx++)
+    {
+        for (int targetReturnIdx = 0; targetReturnIdx < numOfTargetReturns; targetReturnIdx++)
+        {
+            for (int assetIdx = 0; assetIdx < numOfAssets; assetIdx++)
+            {
+                portfolioWeights[targetReturnIdx][assetIdx] += chunkSums[chunkIdx][targetReturnIdx][assetIdx];
+            }
+        }
+    }
+
+    for (int targetReturnIdx = 0; targetReturnIdx < numOfTargetReturns; targetReturnIdx++)
+    {
+        for (int assetIdx = 0; assetIdx < numOfAssets; assetIdx++)
+        {
+            portfolioWeights[targetReturnIdx][assetIdx] /= numOfPaths;
+        }
+    }
+
+    return portfolioWeights;
+}
+
+/**
+ * Writes resampled portfolio weights to CSV corresponding to the given filename.
+ *
+ * @param portfolioWeights - The portfolio weights, one row per target return.
+ * @param targetReturns - The target returns.
+ * @param fileName - The name of the CSV file.
+ **/
+void ResampledFrontier::writeToCsv(const vector<vector<double> > &portfolioWeights, const vector<double> &targetReturns, string fileName)
+{
+    ofstream resultsFile;
+    resultsFile.open(fileName);
+    resultsFile << "Target Return";
+
+    for (int assetIdx = 0; assetIdx < portfolioWeights[0].size(); assetIdx++)
+    {
+        resultsFile << "," << assetIdx + 1;
+    }
+    resultsFile << "\n";
+
+    for (int i = 0; i < portfolioWeights.size(); i++)
+    {
+        resultsFile << targetReturns[i];
+
+        for (int j = 0; j < portfolioWeights[i].size(); j++)
+        {
+            resultsFile << "," << portfolioWeights[i][j];
+        }
+
+        resultsFile << "\n";
+    }
+
+    resultsFile.close();
+}
+
+/**
+ * Fills `pathReturns` with a moving block bootstrap of the days in the
+ * (inclusive) range bounded by `returnsStartIdx` and `returnsEndIdx`.
+ *
+ * @param returnsMatrix - The matrix of time-indexed returns.
+ * @param returnsStartIdx - The "first day" of the sample of returns.
+ * @param returnsEndIdx - The "last day" of the sample of returns.
+ * @param pathIdx - The index of the path, which selects its random stream.
+ * @param pathReturns - A (no_of_assets x no_of_days) workspace, populated with the
+ *                      resampled returns.
+ **/
+void ResampledFrontier::resampleReturns(const ReturnsView &returnsMatrix, int returnsStartIdx, int returnsEndIdx, int pathIdx, vector<vector<double> > &pathReturns)
+{
+    int numOfAssets = returnsMatrix.getNumOfAssets();
+    int numOfDays = returnsEndIdx + 1 - returnsStartIdx;
+    int pathBlockSize = min(blockSize, numOfDays);
+    int numOfBlockStarts = numOfDays - pathBlockSize + 1;
+
+    vector<double> blockReturns;
+
+    RandomStream randomStream(seed, pathIdx);
+
+    // Blocks of consecutive days, which keep the short term dependence of the
+    // returns, are laid end to end and the last one cut to length.
+    for (int day = 0; day < numOfDays; day += pathBlockSize)
+    {
+        int blockStartIdx = returnsStartIdx + randomStream.nextInt(numOfBlockStarts);
+        int numOfBlockDays = min(pathBlockSize, numOfDays - day);
+
+        for (int assetIdx = 0; assetIdx < numOfAssets; assetIdx++)
+        {
+            const double *returns = returnsMatrix.readAssetReturns(assetIdx, blockStartIdx, blockStartIdx + numOfBlockDays - 1, blockReturns);
+
+            copy(returns, returns + numOfBlockDays, &pathReturns[assetIdx][day]);
+        }
+    }
+}
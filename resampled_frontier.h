@@ -0,0 +1,88 @@
+#ifndef ResampledFrontier_h
+#define ResampledFrontier_h
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <vector>
+#include "portfolio_optimisation_model.h"
+#include "random_stream.h"
+#include "thread_pool.h"
+
+using namespace std;
+
+/**
+ * A Monte Carlo engine for resampled (Michaud style) efficient frontiers.
+ * Each path block bootstraps the days of a sample of returns, re-optimises
+ * the portfolios of every target return on the resampled returns, and the
+ * resampled frontier is the average of the weights over the paths.
+ *
+ * Every path draws from its own counter based random stream, and paths are
+ * summed in fixed chunks that are then combined in order, so the result is
+ * identical for any number of threads.
+ **/
+class ResampledFrontier
+{
+public:
+    /**
+     * Constructs a resampled frontier engine.
+     *
+     * @param numOfPaths - The number of bootstrap paths.
+     * @param blockSize - The number of consecutive days in each bootstrap block.
+     * @param seed - The seed of the random streams.
+     * @param numOfThreads - The number of threads to run the paths on. Above one, the
+     *                       model's `calculatePortfolioWeights` must be reentrant.
+     *                       Non-positive values mean one thread per hardware thread.
+     **/
+    ResampledFrontier(int numOfPaths, int blockSize, uint64_t seed, int numOfThreads = 0);
+
+    /**
+     * Calculates and returns the resampled portfolio weights for each of the
+     * given target returns, over the given subsection of time-indexed returns.
+     *
+     * @param returnsMatrix - The matrix of time-indexed returns.
+     * @param model - The portfolio optimisation model.
+     * @param returnsStartIdx - The "first day" of the sample of returns.
+     * @param returnsEndIdx - The "last day" of the sample of returns.
+     * @param targetReturns - The desired returns to be attained by the optimal portfolios.
+     * @return The weights averaged over the paths, one row per target return.
+     **/
+    vector<vector<double> > calculatePortfolioWeights(const ReturnsView &returnsMatrix, PortfolioOptimisationModel &model, int returnsStartIdx, int returnsEndIdx, const vector<double> &targetReturns);
+
+    /**
+     * Writes resampled portfolio weights to CSV corresponding to the given filename.
+     *
+     * @param portfolioWeights - The portfolio weights, one row per target return.
+     * @param targetReturns - The target returns.
+     * @param fileName - The name of the CSV file.
+     **/
+    void writeToCsv(const vector<vector<double> > &portfolioWeights, const vector<double> &targetReturns, string fileName);
+
+private:
+    int numOfPaths;
+    int blockSize;
+    uint64_t seed;
+    int numOfThreads;
+
+    // The number of paths summed together before the chunks are combined.
+    static const int numOfPathsPerChunk = 64;
+
+    /**
+     * Fills `pathReturns` with a moving block bootstrap of the days in the
+     * (inclusive) range bounded by `returnsStartIdx` and `returnsEndIdx`.
+     *
+     * @param returnsMatrix - The matrix of time-indexed returns.
+     * @param returnsStartIdx - The "first day" of the sample of returns.
+     * @param returnsEndIdx - The "last day" of the sample of returns.
+     * @param pathIdx - The index of the path, which selects its random stream.
+     * @param pathReturns - A (no_of_assets x no_of_days) workspace, populated with the
+     *                      resampled returns.
+     **/
+    void resampleReturns(const ReturnsView &returnsMatrix, int returnsStartIdx, int returnsEndIdx, int pathIdx, vector<vector<double> > &pathReturns);
+};
+
+#endif
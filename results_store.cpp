@@ -0,0 +1,366 @@
+#include "results_store.h"
+
+// Identifies files written by `ResultsStore`.
+static const char resultsStoreMagic[8] = {'M', 'K', 'W', 'R', 'E', 'S', 'L', 'T'};
+static const int resultsStoreVersion = 1;
+
+// The header and each column descriptor are 64 bytes, and every column's
+// region starts on a 64 byte boundary, i.e. a cache line.
+static const int blockSize = 64;
+static const int maxColumnNameLength = 40;
+static const int dtypeLength = 8;
+
+// The byte offset of the row count within the header.
+static const int numOfRowsOffset = sizeof(resultsStoreMagic) + 2 * sizeof(int32_t);
+
+/**
+ * Rounds the given number of bytes up to a multiple of the block size.
+ *
+ * @param numOfBytes - The number of bytes.
+ * @return The aligned number of bytes.
+ **/
+static int64_t alignToBlock(int64_t numOfBytes)
+{
+    return (numOfBytes + blockSize - 1) / blockSize * blockSize;
+}
+
+/**
+ * Creates the results store, replacing any existing file.
+ *
+ * @param fileName - The name of the file.
+ * @param columns - The columns of the store.
+ * @param rowCapacity - The number of rows to reserve space for.
+ **/
+ResultsStore::ResultsStore(const string &fileName, const vector<ResultsColumn> &columns, long rowCapacity)
+{
+    this->fileName = fileName;
+    this->columns = columns;
+    this->numOfRows = 0;
+    this->rowCapacity = rowCapacity > 0 ? rowCapacity : 1;
+
+    for (int i = 0; i < columns.size(); i++)
+    {
+        if (columns[i].name.empty() || columns[i].name.size() >= maxColumnNameLength || columns[i].width < 1)
+        {
+            cout << "Results store column \"" << columns[i].name << "\" must have a name of under " << maxColumnNameLength << " characters and a positive width." << endl;
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    pendingIntValues.resize(columns.size());
+    pendingDoubleValues.resize(columns.size());
+
+    file.open(fileName.c_str(), ios::in | ios::out | ios::binary | ios::trunc);
+
+    if (!file.is_open())
+    {
+        cout << "Could not open " << fileName << " to store the results." << endl;
+        exit(EXIT_FAILURE);
+    }
+
+    writeLayout();
+}
+
+/**
+ * Returns the index of the column with the given name.
+ *
+ * @param name - The name of the column.
+ * @return The index of the column.
+ **/
+int ResultsStore::getColumnIdx(const string &name) const
+{
+    for (int i = 0; i < columns.size(); i++)
+    {
+        if (columns[i].name == name)
+        {
+            return i;
+        }
+    }
+
+    cout << "Results store " << fileName << " has no column \"" << name << "\"." << endl;
+    exit(EXIT_FAILURE);
+}
+
+/**
+ * Returns the number of committed rows.
+ *
+ * @return The number of rows.
+ **/
+long ResultsStore::getNumOfRows() const
+{
+    return numOfRows;
+}
+
+/**
+ * Appends a value to an integer column of the pending rows.
+ *
+ * @param columnIdx - The index of the column.
+ * @param value - The value.
+ **/
+void ResultsStore::append(int columnIdx, int value)
+{
+    checkColumn(columnIdx, INT32_COLUMN);
+    pendingIntValues[columnIdx].push_back(value);
+}
+
+/**
+ * Appends a value to a floating point column of the pending rows.
+ *
+ * @param columnIdx - The index of the column.
+ * @param value - The value.
+ **/
+void ResultsStore::append(int columnIdx, double value)
+{
+    checkColumn(columnIdx, FLOAT64_COLUMN);
+    pendingDoubleValues[columnIdx].push_back(value);
+}
+
+/**
+ * Appends a row's worth of values to a floating point column of the pending rows.
+ *
+ * @param columnIdx - The index of the column.
+ * @param values - The `width` values of the row.
+ **/
+void ResultsStore::append(int columnIdx, const vector<double> &values)
+{
+    checkColumn(columnIdx, FLOAT64_COLUMN);
+
+    if (values.size() != columns[columnIdx].width)
+    {
+        cout << "Results store column \"" << columns[columnIdx].name << "\" expects " << columns[columnIdx].width << " values per row, not " << values.size() << "." << endl;
+        exit(EXIT_FAILURE);
+    }
+
+    pendingDoubleValues[columnIdx].insert(pendingDoubleValues[columnIdx].end(), values.begin(), values.end());
+}
+
+/**
+ * Writes the pending rows to the file, then publishes them by updating
+ * the row count in the header. Every column must have been given the
+ * same number of rows.
+ **/
+void ResultsStore::commitRows()
+{
+    if (columns.empty())
+    {
+        return;
+    }
+
+    long numOfPendingRows = getNumOfPendingRows(0);
+
+    for (int i = 1; i < columns.size(); i++)
+    {
+        if (getNumOfPendingRows(i) != numOfPendingRows)
+        {
+            cout << "Results store column \"" << columns[i].name << "\" has " << getNumOfPendingRows(i) << " pending rows, not " << numOfPendingRows << "." << endl;
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    if (numOfPendingRows == 0)
+    {
+        return;
+    }
+
+    if (numOfRows + numOfPendingRows > rowCapacity)
+    {
+        grow(numOfRows + numOfPendingRows);
+    }
+
+    // One contiguous write per column.
+    for (int i = 0; i < columns.size(); i++)
+    {
+        const char *values = columns[i].type == INT32_COLUMN ? (const char *)pendingIntValues[i].data() : (const char *)pendingDoubleValues[i].data();
+
+        file.seekp(columnOffsets[i] + numOfRows * getRowSize(i));
+        file.write(values, numOfPendingRows * getRowSize(i));
+
+        pendingIntValues[i].clear();
+        pendingDoubleValues[i].clear();
+    }
+
+    file.flush();
+
+    numOfRows += numOfPendingRows;
+
+    int64_t storedNumOfRows = numOfRows;
+    file.seekp(numOfRowsOffset);
+    file.write((const char *)&storedNumOfRows, sizeof(storedNumOfRows));
+    file.flush();
+
+    checkFile();
+}
+
+/**
+ * Writes the header and column descriptors, and sizes the file for the
+ * row capacity.
+ **/
+void ResultsStore::writeLayout()
+{
+    int numOfColumns = columns.size();
+    int64_t storedNumOfRows = numOfRows;
+    int64_t storedRowCapacity = rowCapacity;
+
+    char header[blockSize] = {};
+    char *position = header;
+
+    copy(resultsStoreMagic, resultsStoreMagic + sizeof(resultsStoreMagic), position);
+    position += sizeof(resultsStoreMagic);
+    *(int32_t *)position = resultsStoreVersion;
+    position += sizeof(int32_t);
+    *(int32_t *)position = numOfColumns;
+    position += sizeof(int32_t);
+    *(int64_t *)position = storedNumOfRows;
+    position += sizeof(int64_t);
+    *(int64_t *)position = storedRowCapacity;
+
+    file.seekp(0);
+    file.write(header, blockSize);
+
+    int64_t offset = blockSize * (1 + numOfColumns);
+    columnOffsets.resize(numOfColumns);
+
+    for (int i = 0; i < numOfColumns; i++)
+    {
+        char descriptor[blockSize] = {};
+        const char *dtype = columns[i].type == INT32_COLUMN ? "<i4" : "<f8";
+
+        columnOffsets[i] = offset;
+
+        position = descriptor;
+        columns[i].name.copy(position, maxColumnNameLength - 1);
+        position += maxColumnNameLength;
+        copy(dtype, dtype + 3, position);
+        position += dtypeLength;
+        *(int32_t *)position = columns[i].width;
+        position += sizeof(int32_t);
+        *(int32_t *)position = columns[i].type == INT32_COLUMN ? sizeof(int32_t) : sizeof(double);
+        position += sizeof(int32_t);
+        *(int64_t *)position = offset;
+
+        file.write(descriptor, blockSize);
+
+        offset += alignToBlock(rowCapacity * getRowSize(i));
+    }
+
+    file.flush();
+    checkFile();
+
+    // Reserve the column regions up front, so every column can be mapped
+    // at its full capacity.
+    if (truncate(fileName.c_str(), offset) != 0)
+    {
+        cout << "Could not size " << fileName << " for " << rowCapacity << " rows." << endl;
+        exit(EXIT_FAILURE);
+    }
+}
+
+/**
+ * Rewrites the file with room for at least the given number of rows,
+ * preserving the committed rows.
+ *
+ * @param minRowCapacity - The number of rows needed.
+ **/
+void ResultsStore::grow(long minRowCapacity)
+{
+    vector<vector<char> > columnData(columns.size());
+
+    for (int i = 0; i < columns.size(); i++)
+    {
+        columnData[i].resize(numOfRows * getRowSize(i));
+        file.seekg(columnOffsets[i]);
+        file.read(columnData[i].data(), columnData[i].size());
+    }
+
+    checkFile();
+    file.close();
+
+    while (rowCapacity < minRowCapacity)
+    {
+        rowCapacity *= 2;
+    }
+
+    // The grown file is written aside and renamed over the original, so the
+    // file on disk is always a complete store.
+    string grownFileName = fileName + ".grow";
+    string originalFileName = fileName;
+
+    fileName = grownFileName;
+    file.open(fileName.c_str(), ios::in | ios::out | ios::binary | ios::trunc);
+
+    if (!file.is_open())
+    {
+        cout << "Could not open " << fileName << " to grow the results store." << endl;
+        exit(EXIT_FAILURE);
+    }
+
+    writeLayout();
+
+    for (int i = 0; i < columns.size(); i++)
+    {
+        file.seekp(columnOffsets[i]);
+        file.write(columnData[i].data(), columnData[i].size());
+    }
+
+    file.flush();
+    checkFile();
+
+    fileName = originalFileName;
+
+    if (rename(grownFileName.c_str(), fileName.c_str()) != 0)
+    {
+        cout << "Could not replace " << fileName << " with its grown copy." << endl;
+        exit(EXIT_FAILURE);
+    }
+}
+
+/**
+ * Returns the number of bytes taken by one row of the given column.
+ *
+ * @param columnIdx - The index of the column.
+ * @return The row size in bytes.
+ **/
+int ResultsStore::getRowSize(int columnIdx) const
+{
+    return columns[columnIdx].width * (columns[columnIdx].type == INT32_COLUMN ? sizeof(int32_t) : sizeof(double));
+}
+
+/**
+ * Returns the number of pending rows of the given column.
+ *
+ * @param columnIdx - The index of the column.
+ * @return The number of pending rows.
+ **/
+long ResultsStore::getNumOfPendingRows(int columnIdx) const
+{
+    long numOfValues = columns[columnIdx].type == INT32_COLUMN ? pendingIntValues[columnIdx].size() : pendingDoubleValues[columnIdx].size();
+
+    return numOfValues / columns[columnIdx].width;
+}
+
+/**
+ * Exits if the given column is not of the given type.
+ *
+ * @param columnIdx - The index of the column.
+ * @param type - The expected type.
+ **/
+void ResultsStore::checkColumn(int columnIdx, ResultsColumnType type) const
+{
+    if (columnIdx < 0 || columnIdx >= columns.size() || columns[columnIdx].type != type)
+    {
+        cout << "Results store column " << columnIdx << " does not exist or holds a different type." << endl;
+        exit(EXIT_FAILURE);
+    }
+}
+
+/**
+ * Exits if the file is in a failed state.
+ **/
+void ResultsStore::checkFile()
+{
+    if (!file)
+    {
+        cout << "Could not write to the results store " << fileName << "." << endl;
+        exit(EXIT_FAILURE);
+    }
+}
@@ -0,0 +1,165 @@
+#ifndef ResultsStore_h
+#define ResultsStore_h
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+using namespace std;
+
+/**
+ * The type of the values in a column of a results store.
+ **/
+enum ResultsColumnType
+{
+    INT32_COLUMN,
+    FLOAT64_COLUMN
+};
+
+/**
+ * A column of a results store. A column holds `width` values per row,
+ * e.g. one per asset for a column of portfolio weights.
+ **/
+struct ResultsColumn
+{
+    string name;
+    ResultsColumnType type;
+    int width;
+};
+
+/**
+ * An append only, binary, columnar file of results, laid out so that each
+ * column can be memory mapped directly as a typed array, e.g. with
+ * `numpy.memmap`.
+ *
+ * The file starts with a 64 byte header (magic, version, number of columns,
+ * number of rows, row capacity), followed by a 64 byte descriptor per column
+ * (name, numpy dtype string, width, item size, byte offset). Each column then
+ * occupies a 64 byte aligned region of `rowCapacity x width` values. Rows are
+ * written column by column, and the row count in the header is only updated
+ * once the rows are complete, so a reader never sees a partial row. When the
+ * capacity is exhausted the file is rewritten with double the capacity.
+ **/
+class ResultsStore
+{
+public:
+    /**
+     * Creates the results store, replacing any existing file.
+     *
+     * @param fileName - The name of the file.
+     * @param columns - The columns of the store.
+     * @param rowCapacity - The number of rows to reserve space for.
+     **/
+    ResultsStore(const string &fileName, const vector<ResultsColumn> &columns, long rowCapacity);
+
+    /**
+     * Returns the index of the column with the given name.
+     *
+     * @param name - The name of the column.
+     * @return The index of the column.
+     **/
+    int getColumnIdx(const string &name) const;
+
+    /**
+     * Returns the number of committed rows.
+     *
+     * @return The number of rows.
+     **/
+    long getNumOfRows() const;
+
+    /**
+     * Appends a value to an integer column of the pending rows.
+     *
+     * @param columnIdx - The index of the column.
+     * @param value - The value.
+     **/
+    void append(int columnIdx, int value);
+
+    /**
+     * Appends a value to a floating point column of the pending rows.
+     *
+     * @param columnIdx - The index of the column.
+     * @param value - The value.
+     **/
+    void append(int columnIdx, double value);
+
+    /**
+     * Appends a row's worth of values to a floating point column of the pending rows.
+     *
+     * @param columnIdx - The index of the column.
+     * @param values - The `width` values of the row.
+     **/
+    void append(int columnIdx, const vector<double> &values);
+
+    /**
+     * Writes the pending rows to the file, then publishes them by updating
+     * the row count in the header. Every column must have been given the
+     * same number of rows.
+     **/
+    void commitRows();
+
+private:
+    string fileName;
+    fstream file;
+    vector<ResultsColumn> columns;
+    long numOfRows;
+    long rowCapacity;
+
+    // The byte offset of each column's region in the file.
+    vector<int64_t> columnOffsets;
+
+    // The values appended to each column since the last commit.
+    vector<vector<int32_t> > pendingIntValues;
+    vector<vector<double> > pendingDoubleValues;
+
+    /**
+     * Writes the header and column descriptors, and sizes the file for the
+     * row capacity.
+     **/
+    void writeLayout();
+
+    /**
+     * Rewrites the file with room for at least the given number of rows,
+     * preserving the committed rows.
+     *
+     * @param minRowCapacity - The number of rows needed.
+     **/
+    void grow(long minRowCapacity);
+
+    /**
+     * Returns the number of bytes taken by one row of the given column.
+     *
+     * @param columnIdx - The index of the column.
+     * @return The row size in bytes.
+     **/
+    int getRowSize(int columnIdx) const;
+
+    /**
+     * Returns the number of pending rows of the given column.
+     *
+     * @param columnIdx - The index of the column.
+     * @return The number of pending rows.
+     **/
+    long getNumOfPendingRows(int columnIdx) const;
+
+    /**
+     * Exits if the given column is not of the given type.
+     *
+     * @param columnIdx - The index of the column.
+     * @param type - The expected type.
+     **/
+    void checkColumn(int columnIdx, ResultsColumnType type) const;
+
+    /**
+     * Exits if the file is in a failed state.
+     **/
+    void checkFile();
+};
+
+#endif
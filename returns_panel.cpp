@@ -0,0 +1,627 @@
+#include "returns_panel.h"
+
+// The number of assets, and of returns, in a block of a transposition. Two
+// blocks of doubles fit comfortably in the L1 cache.
+static const int transposeBlockSize = 32;
+
+/**
+ * Returns the position of a return within the contiguous storage of a panel.
+ *
+ * @param layout - The layout of the panel, other than an unmapped asset major one.
+ * @param tileSize - The size of a tile, if the layout is tiled.
+ * @param numOfAssets - The number of assets.
+ * @param numOfReturns - The number of returns per asset.
+ * @param assetIdx - The index of the asset.
+ * @param returnIdx - The index of the return.
+ * @return The position of the return.
+ **/
+static size_t calculateStoredReturnIdx(ReturnsLayout layout, int tileSize, int numOfAssets, int numOfReturns, int assetIdx, int returnIdx)
+{
+    if (layout == ASSET_MAJOR)
+    {
+        return (size_t)assetIdx * numOfReturns + returnIdx;
+    }
+
+    if (layout == TIME_MAJOR)
+    {
+        return (size_t)returnIdx * numOfAssets + assetIdx;
+    }
+
+    size_t numOfAssetTiles = (numOfAssets + tileSize - 1) / tileSize;
+    size_t tileIdx = (returnIdx / tileSize) * numOfAssetTiles + assetIdx / tileSize;
+
+    return (tileIdx * tileSize + assetIdx % tileSize) * tileSize + returnIdx % tileSize;
+}
+
+/**
+ * Calls `visit(assetIdx, returnIdx)` for every return of a panel, a square
+ * block at a time, so that a transposition stays within the cache.
+ *
+ * @param numOfAssets - The number of assets.
+ * @param numOfReturns - The number of returns per asset.
+ * @param visit - The function to call.
+ **/
+template <typename Visitor>
+static void visitInBlocks(int numOfAssets, int numOfReturns, Visitor visit)
+{
+    for (int assetBlockIdx = 0; assetBlockIdx < numOfAssets; assetBlockIdx += transposeBlockSize)
+    {
+        int assetBlockEndIdx = min(assetBlockIdx + transposeBlockSize, numOfAssets);
+
+        for (int returnBlockIdx = 0; returnBlockIdx < numOfReturns; returnBlockIdx += transposeBlockSize)
+        {
+            int returnBlockEndIdx = min(returnBlockIdx + transposeBlockSize, numOfReturns);
+
+            for (int assetIdx = assetBlockIdx; assetIdx < assetBlockEndIdx; assetIdx++)
+            {
+                for (int returnIdx = returnBlockIdx; returnIdx < returnBlockEndIdx; returnIdx++)
+                {
+                    visit(assetIdx, returnIdx);
+                }
+            }
+        }
+    }
+}
+
+/**
+ * Constructs an empty panel.
+ **/
+ReturnsPanel::ReturnsPanel()
+{
+    this->numOfAssets = 0;
+    this->numOfReturns = 0;
+    this->layout = ASSET_MAJOR;
+    this->tileSize = 0;
+    this->precision = FLOAT64_RETURNS;
+    this->mappedReturns = NULL;
+}
+
+/**
+ * Constructs an asset major panel of the given shape, with every return missing.
+ *
+ * @param numOfAssets - The number of assets.
+ * @param numOfReturns - The number of returns per asset.
+ **/
+ReturnsPanel::ReturnsPanel(int numOfAssets, int numOfReturns)
+{
+    this->numOfAssets = numOfAssets;
+    this->numOfReturns = numOfReturns;
+    this->layout = ASSET_MAJOR;
+    this->tileSize = 0;
+    this->precision = FLOAT64_RETURNS;
+    this->mappedReturns = NULL;
+
+    returnsMatrix.assign(numOfAssets, vector<double>(numOfReturns, NAN));
+    createDefaultIndex();
+}
+
+/**
+ * Constructs an asset major panel from a matrix of returns, taking its
+ * contents. Every asset must have the same number of returns.
+ *
+ * @param returnsMatrix - The matrix of time-indexed returns, which is moved from.
+ **/
+ReturnsPanel::ReturnsPanel(vector<vector<double> > &&returnsMatrix)
+{
+    this->returnsMatrix = move(returnsMatrix);
+    this->numOfAssets = this->returnsMatrix.size();
+    this->numOfReturns = numOfAssets > 0 ? this->returnsMatrix[0].size() : 0;
+    this->layout = ASSET_MAJOR;
+    this->tileSize = 0;
+    this->precision = FLOAT64_RETURNS;
+    this->mappedReturns = NULL;
+
+    for (int i = 0; i < numOfAssets; i++)
+    {
+        if (this->returnsMatrix[i].size() != numOfReturns)
+        {
+            cout << "Asset " << i << " has " << this->returnsMatrix[i].size() << " returns, not " << numOfReturns << "." << endl;
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    createDefaultIndex();
+}
+
+/**
+ * Constructs a read only panel over returns held in a mapped file, which
+ * the panel keeps mapped for as long as it, or any copy of it, exists.
+ *
+ * @param mappedFile - The mapped file.
+ * @param returns - The returns within the mapping, in the given layout.
+ * @param layout - The layout of the returns.
+ * @param tileSize - The size of a tile, if the layout is tiled.
+ * @param precision - The type of the returns.
+ * @param numOfAssets - The number of assets.
+ * @param numOfReturns - The number of returns per asset.
+ * @param assetIds - The ID of each asset.
+ * @param dateIndex - The date of each return.
+ **/
+ReturnsPanel::ReturnsPanel(shared_ptr<const MappedFile> mappedFile, const void *returns, ReturnsLayout layout, int tileSize, ReturnsPrecision precision, int numOfAssets, int numOfReturns, const vector<string> &assetIds, const vector<int64_t> &dateIndex)
+{
+    if (assetIds.size() != numOfAssets || dateIndex.size() != numOfReturns)
+    {
+        cout << "A panel of " << numOfAssets << " assets x " << numOfReturns << " returns needs an ID per asset and a date per return." << endl;
+        exit(EXIT_FAILURE);
+    }
+
+    if (layout == TILED && tileSize < 1)
+    {
+        cout << "A tiled panel needs a positive tile size, not " << tileSize << "." << endl;
+        exit(EXIT_FAILURE);
+    }
+
+    this->numOfAssets = numOfAssets;
+    this->numOfReturns = numOfReturns;
+    this->layout = layout;
+    this->tileSize = layout == TILED ? tileSize : 0;
+    this->precision = precision;
+    this->assetIds = assetIds;
+    this->dateIndex = dateIndex;
+    this->mappedFile = mappedFile;
+    this->mappedReturns = returns;
+}
+
+/**
+ * Returns the number of assets.
+ *
+ * @return The number of assets.
+ **/
+int ReturnsPanel::getNumOfAssets() const
+{
+    return numOfAssets;
+}
+
+/**
+ * Returns the number of returns per asset.
+ *
+ * @return The number of returns.
+ **/
+int ReturnsPanel::getNumOfReturns() const
+{
+    return numOfReturns;
+}
+
+/**
+ * Returns the ID of each asset. Unless given otherwise, an asset's ID is
+ * "asset_" followed by its index.
+ *
+ * @return The asset IDs.
+ **/
+const vector<string> &ReturnsPanel::getAssetIds() const
+{
+    return assetIds;
+}
+
+/**
+ * Returns the date of each return. Unless given otherwise, a return's
+ * date is its index.
+ *
+ * @return The date index.
+ **/
+const vector<int64_t> &ReturnsPanel::getDateIndex() const
+{
+    return dateIndex;
+}
+
+/**
+ * Returns whether the returns are read in place from a mapped file.
+ *
+ * @return True if the panel is mapped.
+ **/
+bool ReturnsPanel::isMapped() const
+{
+    return mappedReturns != NULL;
+}
+
+/**
+ * Returns the layout the returns are stored in.
+ *
+ * @return The layout.
+ **/
+ReturnsLayout ReturnsPanel::getLayout() const
+{
+    return layout;
+}
+
+/**
+ * Returns the size of a tile of a tiled panel.
+ *
+ * @return The number of assets, and of returns, in a tile, or 0 if the panel is not tiled.
+ **/
+int ReturnsPanel::getTileSize() const
+{
+    return tileSize;
+}
+
+/**
+ * Returns the type the returns are stored as.
+ *
+ * @return The precision.
+ **/
+ReturnsPrecision ReturnsPanel::getPrecision() const
+{
+    return precision;
+}
+
+/**
+ * Returns a single return, in any layout.
+ *
+ * @param assetIdx - The index of the asset.
+ * @param returnIdx - The index of the return.
+ * @return The return.
+ **/
+double ReturnsPanel::getReturn(int assetIdx, int returnIdx) const
+{
+    const void *storedReturns = getStoredReturns();
+
+    if (storedReturns == NULL)
+    {
+        return returnsMatrix[assetIdx][returnIdx];
+    }
+
+    size_t storedReturnIdx = calculateStoredReturnIdx(layout, tileSize, numOfAssets, numOfReturns, assetIdx, returnIdx);
+
+    return precision == FLOAT32_RETURNS ? ((const float *)storedReturns)[storedReturnIdx] : ((const double *)storedReturns)[storedReturnIdx];
+}
+
+/**
+ * Returns the contiguous returns of the given asset of an asset major
+ * panel, without any copy. `Real` must be the type the returns are
+ * stored as: double, or float for a float32 panel.
+ *
+ * @param assetIdx - The index of the asset.
+ * @return The asset's `numOfReturns` returns.
+ **/
+template <typename Real>
+const Real *ReturnsPanel::getAssetReturns(int assetIdx) const
+{
+    checkStorage(ASSET_MAJOR, sizeof(Real));
+
+    const Real *storedReturns = (const Real *)getStoredReturns();
+
+    return storedReturns != NULL ? storedReturns + (size_t)assetIdx * numOfReturns : (const Real *)returnsMatrix[assetIdx].data();
+}
+
+/**
+ * Returns the contiguous returns of every asset on the given day of a
+ * time major panel, without any copy. `Real` must be the type the
+ * returns are stored as.
+ *
+ * @param returnIdx - The index of the return.
+ * @return The day's `numOfAssets` returns.
+ **/
+template <typename Real>
+const Real *ReturnsPanel::getDayReturns(int returnIdx) const
+{
+    checkStorage(TIME_MAJOR, sizeof(Real));
+
+    return (const Real *)getStoredReturns() + (size_t)returnIdx * numOfAssets;
+}
+
+/**
+ * Returns the contiguous returns of the given tile of a tiled panel,
+ * without any copy. `Real` must be the type the returns are stored as.
+ *
+ * @param assetTileIdx - The index of the tile's first asset, divided by the tile size.
+ * @param returnTileIdx - The index of the tile's first return, divided by the tile size.
+ * @return The tile's `tileSize x tileSize` returns, asset major.
+ **/
+template <typename Real>
+const Real *ReturnsPanel::getTileReturns(int assetTileIdx, int returnTileIdx) const
+{
+    checkStorage(TILED, sizeof(Real));
+
+    return (const Real *)getStoredReturns() + calculateStoredReturnIdx(layout, tileSize, numOfAssets, numOfReturns, assetTileIdx * tileSize, returnTileIdx * tileSize);
+}
+
+/**
+ * Returns a view of the returns, in place, as a matrix with a row per
+ * asset. Only asset major and time major panels, of either precision,
+ * have a fixed stride between an asset's returns, so a tiled panel
+ * must be transposed first. The view is invalidated along with any
+ * pointers to the panel's returns.
+ *
+ * @return The view of the returns.
+ **/
+ReturnsView ReturnsPanel::getView() const
+{
+    if (layout == TILED)
+    {
+        cout << "A tiled returns panel cannot be viewed in place, so must be transposed first." << endl;
+        exit(EXIT_FAILURE);
+    }
+
+    vector<const void *> assetReturns(numOfAssets);
+
+    // The returns are viewed as they are stored, so floats are widened only
+    // as the kernels read them.
+    for (int i = 0; i < numOfAssets; i++)
+    {
+        if (layout == ASSET_MAJOR)
+        {
+            assetReturns[i] = precision == FLOAT32_RETURNS ? (const void *)getAssetReturns<float>(i) : getAssetReturns<double>(i);
+        }
+        else if (numOfReturns > 0)
+        {
+            assetReturns[i] = precision == FLOAT32_RETURNS ? (const void *)(getDayReturns<float>(0) + i) : getDayReturns<double>(0) + i;
+        }
+    }
+
+    return ReturnsView(assetReturns, numOfReturns, layout == TIME_MAJOR ? numOfAssets : 1, precision);
+}
+
+/**
+ * Returns the returns in their layout and type as one contiguous array,
+ * as stored in a returns panel file.
+ *
+ * @return The stored returns, or NULL for an unmapped asset major
+ *         panel of doubles, whose assets are stored separately.
+ **/
+const void *ReturnsPanel::getStoredReturns() const
+{
+    if (isMapped())
+    {
+        return mappedReturns;
+    }
+
+    if (precision == FLOAT32_RETURNS)
+    {
+        return singleReturns.data();
+    }
+
+    return layout == ASSET_MAJOR ? NULL : returns.data();
+}
+
+/**
+ * Returns the number of values a panel of the given shape and layout
+ * stores, including the padding of partial tiles.
+ *
+ * @param layout - The layout.
+ * @param tileSize - The size of a tile, if the layout is tiled.
+ * @param numOfAssets - The number of assets.
+ * @param numOfReturns - The number of returns per asset.
+ * @return The number of stored values.
+ **/
+size_t ReturnsPanel::calculateNumOfStoredReturns(ReturnsLayout layout, int tileSize, int numOfAssets, int numOfReturns)
+{
+    if (layout != TILED)
+    {
+        return (size_t)numOfAssets * numOfReturns;
+    }
+
+    size_t numOfAssetTiles = (numOfAssets + tileSize - 1) / tileSize;
+    size_t numOfReturnTiles = (numOfReturns + tileSize - 1) / tileSize;
+
+    return numOfAssetTiles * numOfReturnTiles * tileSize * tileSize;
+}
+
+/**
+ * Returns a copy of the panel in the given layout. The transposition is
+ * done a block at a time, so that both panels are read and written
+ * within the cache.
+ *
+ * @param layout - The layout of the copy.
+ * @param tileSize - The size of a tile, if the layout is tiled.
+ * @return The panel in the given layout.
+ **/
+ReturnsPanel ReturnsPanel::toLayout(ReturnsLayout layout, int tileSize) const
+{
+    return convert(layout, tileSize, precision);
+}
+
+/**
+ * Returns a copy of the panel, in the same layout, with its returns
+ * stored as the given type. Returns narrowed to floats are rounded to
+ * the nearest float.
+ *
+ * @param precision - The type of the copy's returns.
+ * @return The panel of the given precision.
+ **/
+ReturnsPanel ReturnsPanel::toPrecision(ReturnsPrecision precision) const
+{
+    return convert(layout, tileSize, precision);
+}
+
+/**
+ * Returns the matrix of returns, with a row per asset. The returns of a
+ * mapped or not asset major panel are copied into the matrix on the
+ * first call.
+ *
+ * @return The matrix of time-indexed returns.
+ **/
+const vector<vector<double> > &ReturnsPanel::getReturnsMatrix() const
+{
+    if (getStoredReturns() != NULL && returnsMatrix.size() != numOfAssets)
+    {
+        vector<vector<double> > copiedReturnsMatrix(numOfAssets, vector<double>(numOfReturns));
+
+        if (layout == ASSET_MAJOR && precision == FLOAT32_RETURNS)
+        {
+            for (int i = 0; i < numOfAssets; i++)
+            {
+                copy(getAssetReturns<float>(i), getAssetReturns<float>(i) + numOfReturns, copiedReturnsMatrix[i].begin());
+            }
+        }
+        else if (layout == ASSET_MAJOR)
+        {
+            for (int i = 0; i < numOfAssets; i++)
+            {
+                copy(getAssetReturns(i), getAssetReturns(i) + numOfReturns, copiedReturnsMatrix[i].begin());
+            }
+        }
+        else
+        {
+            visitInBlocks(numOfAssets, numOfReturns, [&](int assetIdx, int returnIdx) {
+                copiedReturnsMatrix[assetIdx][returnIdx] = getReturn(assetIdx, returnIdx);
+            });
+        }
+
+        returnsMatrix = move(copiedReturnsMatrix);
+    }
+
+    return returnsMatrix;
+}
+
+/**
+ * Returns the matrix of returns, with a row per asset, for populating.
+ * The shape of the matrix may not be changed, and only an unmapped
+ * asset major panel may be populated.
+ *
+ * @return The matrix of time-indexed returns.
+ **/
+vector<vector<double> > &ReturnsPanel::getWritableReturnsMatrix()
+{
+    if (getStoredReturns() != NULL)
+    {
+        cout << "Only an unmapped, asset major returns panel of doubles can be populated." << endl;
+        exit(EXIT_FAILURE);
+    }
+
+    return returnsMatrix;
+}
+
+/**
+ * Appends a day of returns to an unmapped time major panel. Appending
+ * costs O(no_of_assets), amortised, and invalidates any pointers to the
+ * panel's returns.
+ *
+ * @param dayReturns - The return of every asset on the day, with missing returns as NaN.
+ * @param date - The date of the day.
+ **/
+void ReturnsPanel::appendReturns(const vector<double> &dayReturns, int64_t date)
+{
+    if (isMapped() || layout != TIME_MAJOR)
+    {
+        cout << "Only an unmapped, time major returns panel can be appended to." << endl;
+        exit(EXIT_FAILURE);
+    }
+
+    if (dayReturns.size() != numOfAssets)
+    {
+        cout << "A day of " << dayReturns.size() << " returns cannot be appended to a panel of " << numOfAssets << " assets." << endl;
+        exit(EXIT_FAILURE);
+    }
+
+    if (precision == FLOAT32_RETURNS)
+    {
+        singleReturns.insert(singleReturns.end(), dayReturns.begin(), dayReturns.end());
+    }
+    else
+    {
+        returns.insert(returns.end(), dayReturns.begin(), dayReturns.end());
+    }
+
+    dateIndex.push_back(date);
+    numOfReturns++;
+
+    // Any copy of the returns as a matrix is now a day short.
+    returnsMatrix.clear();
+}
+
+/**
+ * Exits unless the panel is stored in the given layout, with values of
+ * the given size.
+ *
+ * @param layout - The layout needed.
+ * @param valueSize - The size of the values needed, in bytes.
+ **/
+void ReturnsPanel::checkStorage(ReturnsLayout layout, size_t valueSize) const
+{
+    size_t storedValueSize = precision == FLOAT32_RETURNS ? sizeof(float) : sizeof(double);
+
+    if (this->layout != layout || storedValueSize != valueSize)
+    {
+        cout << "The returns panel is stored in layout " << this->layout << " with " << storedValueSize << " byte returns, not layout " << layout << " with " << valueSize << " byte returns." << endl;
+        exit(EXIT_FAILURE);
+    }
+}
+
+/**
+ * Returns a copy of the panel in the given layout and precision.
+ *
+ * @param layout - The layout of the copy.
+ * @param tileSize - The size of a tile, if the layout is tiled.
+ * @param precision - The type of the copy's returns.
+ * @return The converted panel.
+ **/
+ReturnsPanel ReturnsPanel::convert(ReturnsLayout layout, int tileSize, ReturnsPrecision precision) const
+{
+    if (layout == TILED && tileSize < 1)
+    {
+        cout << "A tiled panel needs a positive tile size, not " << tileSize << "." << endl;
+        exit(EXIT_FAILURE);
+    }
+
+    if (layout == this->layout && (layout != TILED || tileSize == this->tileSize) && precision == this->precision)
+    {
+        return *this;
+    }
+
+    ReturnsPanel returnsPanel;
+    returnsPanel.numOfAssets = numOfAssets;
+    returnsPanel.numOfReturns = numOfReturns;
+    returnsPanel.layout = layout;
+    returnsPanel.tileSize = layout == TILED ? tileSize : 0;
+    returnsPanel.precision = precision;
+    returnsPanel.assetIds = assetIds;
+    returnsPanel.dateIndex = dateIndex;
+
+    if (layout == ASSET_MAJOR && precision == FLOAT64_RETURNS)
+    {
+        returnsPanel.returnsMatrix = getReturnsMatrix();
+
+        return returnsPanel;
+    }
+
+    size_t numOfStoredReturns = calculateNumOfStoredReturns(layout, tileSize, numOfAssets, numOfReturns);
+
+    if (precision == FLOAT32_RETURNS)
+    {
+        returnsPanel.singleReturns.assign(numOfStoredReturns, NAN);
+        float *storedReturns = returnsPanel.singleReturns.data();
+
+        visitInBlocks(numOfAssets, numOfReturns, [&](int assetIdx, int returnIdx) {
+            storedReturns[calculateStoredReturnIdx(layout, tileSize, numOfAssets, numOfReturns, assetIdx, returnIdx)] = getReturn(assetIdx, returnIdx);
+        });
+    }
+    else
+    {
+        returnsPanel.returns.assign(numOfStoredReturns, NAN);
+        double *storedReturns = returnsPanel.returns.data();
+
+        visitInBlocks(numOfAssets, numOfReturns, [&](int assetIdx, int returnIdx) {
+            storedReturns[calculateStoredReturnIdx(layout, tileSize, numOfAssets, numOfReturns, assetIdx, returnIdx)] = getReturn(assetIdx, returnIdx);
+        });
+    }
+
+    return returnsPanel;
+}
+
+/**
+ * Gives every asset and return its default ID and date.
+ **/
+void ReturnsPanel::createDefaultIndex()
+{
+    assetIds.resize(numOfAssets);
+    dateIndex.resize(numOfReturns);
+
+    for (int i = 0; i < numOfAssets; i++)
+    {
+        assetIds[i] = "asset_" + to_string(i);
+    }
+
+    for (int t = 0; t < numOfReturns; t++)
+    {
+        dateIndex[t] = t;
+    }
+}
+
+/***************** Explicit Instantiations for double and float32 panels *****************/
+
+template const double *ReturnsPanel::getAssetReturns<double>(int assetIdx) const;
+template const float *ReturnsPanel::getAssetReturns<float>(int assetIdx) const;
+template const double *ReturnsPanel::getDayReturns<double>(int returnIdx) const;
+template const float *ReturnsPanel::getDayReturns<float>(int returnIdx) const;
+template const double *ReturnsPanel::getTileReturns<double>(int assetTileIdx, int returnTileIdx) const;
+template const float *ReturnsPanel::getTileReturns<float>(int assetTileIdx, int returnTileIdx) const;
@@ -0,0 +1,317 @@
+#ifndef ReturnsPanel_h
+#define ReturnsPanel_h
+
+#include <algorithm>
+#include <iostream>
+#include <math.h>
+#include <memory>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string>
+#include <vector>
+#include "mapped_file.h"
+#include "returns_view.h"
+
+using namespace std;
+
+/**
+ * The order in which a returns panel stores its returns.
+ *
+ * ASSET_MAJOR stores each asset's returns contiguously, which suits kernels
+ * that read whole assets, e.g. covariance estimation. TIME_MAJOR stores each
+ * day's returns contiguously, which suits kernels that read whole days, e.g.
+ * portfolio evaluation (w . R_t) and appending new days. TILED stores square
+ * tiles of `tileSize` assets x `tileSize` returns contiguously, asset major
+ * within a tile and ordered by return then asset, so that a block of assets
+ * over a window of days stays in cache. Partial tiles are padded with NaN.
+ **/
+enum ReturnsLayout
+{
+    ASSET_MAJOR,
+    TIME_MAJOR,
+    TILED
+};
+
+/**
+ * A panel of time-indexed asset returns that carries its own shape, so that
+ * universes of any size can be loaded without knowing their dimensions up
+ * front. The returns are held as a (no_of_assets x no_of_returns) matrix,
+ * with missing returns stored as NaN. Each asset has an ID, and each return
+ * a date in the panel's date index.
+ *
+ * A panel either owns its returns, or reads them in place from a mapped
+ * binary panel file, in which case it is read only. Its returns are stored
+ * in one of the layouts of `ReturnsLayout`, and kernels that prefer another
+ * layout are given a copy transposed with `toLayout`. They are stored as
+ * doubles or, see `toPrecision`, as floats. Kernels over the assets read an
+ * asset major or time major panel in place, through `getView`.
+ **/
+class ReturnsPanel
+{
+public:
+    /**
+     * Constructs an empty panel.
+     **/
+    ReturnsPanel();
+
+    /**
+     * Constructs an asset major panel of the given shape, with every return missing.
+     *
+     * @param numOfAssets - The number of assets.
+     * @param numOfReturns - The number of returns per asset.
+     **/
+    ReturnsPanel(int numOfAssets, int numOfReturns);
+
+    /**
+     * Constructs an asset major panel from a matrix of returns, taking its
+     * contents. Every asset must have the same number of returns.
+     *
+     * @param returnsMatrix - The matrix of time-indexed returns, which is moved from.
+     **/
+    ReturnsPanel(vector<vector<double> > &&returnsMatrix);
+
+    /**
+     * Constructs a read only panel over returns held in a mapped file, which
+     * the panel keeps mapped for as long as it, or any copy of it, exists.
+     *
+     * @param mappedFile - The mapped file.
+     * @param returns - The returns within the mapping, in the given layout.
+     * @param layout - The layout of the returns.
+     * @param tileSize - The size of a tile, if the layout is tiled.
+     * @param precision - The type of the returns.
+     * @param numOfAssets - The number of assets.
+     * @param numOfReturns - The number of returns per asset.
+     * @param assetIds - The ID of each asset.
+     * @param dateIndex - The date of each return.
+     **/
+    ReturnsPanel(shared_ptr<const MappedFile> mappedFile, const void *returns, ReturnsLayout layout, int tileSize, ReturnsPrecision precision, int numOfAssets, int numOfReturns, const vector<string> &assetIds, const vector<int64_t> &dateIndex);
+
+    /**
+     * Returns the number of assets.
+     *
+     * @return The number of assets.
+     **/
+    int getNumOfAssets() const;
+
+    /**
+     * Returns the number of returns per asset.
+     *
+     * @return The number of returns.
+     **/
+    int getNumOfReturns() const;
+
+    /**
+     * Returns the ID of each asset. Unless given otherwise, an asset's ID is
+     * "asset_" followed by its index.
+     *
+     * @return The asset IDs.
+     **/
+    const vector<string> &getAssetIds() const;
+
+    /**
+     * Returns the date of each return. Unless given otherwise, a return's
+     * date is its index.
+     *
+     * @return The date index.
+     **/
+    const vector<int64_t> &getDateIndex() const;
+
+    /**
+     * Returns whether the returns are read in place from a mapped file.
+     *
+     * @return True if the panel is mapped.
+     **/
+    bool isMapped() const;
+
+    /**
+     * Returns the layout the returns are stored in.
+     *
+     * @return The layout.
+     **/
+    ReturnsLayout getLayout() const;
+
+    /**
+     * Returns the size of a tile of a tiled panel.
+     *
+     * @return The number of assets, and of returns, in a tile, or 0 if the panel is not tiled.
+     **/
+    int getTileSize() const;
+
+    /**
+     * Returns the type the returns are stored as.
+     *
+     * @return The precision.
+     **/
+    ReturnsPrecision getPrecision() const;
+
+    /**
+     * Returns a single return, in any layout.
+     *
+     * @param assetIdx - The index of the asset.
+     * @param returnIdx - The index of the return.
+     * @return The return.
+     **/
+    double getReturn(int assetIdx, int returnIdx) const;
+
+    /**
+     * Returns the contiguous returns of the given asset of an asset major
+     * panel, without any copy. `Real` must be the type the returns are
+     * stored as: double, or float for a float32 panel.
+     *
+     * @param assetIdx - The index of the asset.
+     * @return The asset's `numOfReturns` returns.
+     **/
+    template <typename Real = double>
+    const Real *getAssetReturns(int assetIdx) const;
+
+    /**
+     * Returns the contiguous returns of every asset on the given day of a
+     * time major panel, without any copy. `Real` must be the type the
+     * returns are stored as.
+     *
+     * @param returnIdx - The index of the return.
+     * @return The day's `numOfAssets` returns.
+     **/
+    template <typename Real = double>
+    const Real *getDayReturns(int returnIdx) const;
+
+    /**
+     * Returns the contiguous returns of the given tile of a tiled panel,
+     * without any copy. `Real` must be the type the returns are stored as.
+     *
+     * @param assetTileIdx - The index of the tile's first asset, divided by the tile size.
+     * @param returnTileIdx - The index of the tile's first return, divided by the tile size.
+     * @return The tile's `tileSize x tileSize` returns, asset major.
+     **/
+    template <typename Real = double>
+    const Real *getTileReturns(int assetTileIdx, int returnTileIdx) const;
+
+    /**
+     * Returns a view of the returns, in place, as a matrix with a row per
+     * asset. Only asset major and time major panels, of either precision,
+     * have a fixed stride between an asset's returns, so a tiled panel
+     * must be transposed first. The view is invalidated along with any
+     * pointers to the panel's returns.
+     *
+     * @return The view of the returns.
+     **/
+    ReturnsView getView() const;
+
+    /**
+     * Returns the returns in their layout and type as one contiguous array,
+     * as stored in a returns panel file.
+     *
+     * @return The stored returns, or NULL for an unmapped asset major
+     *         panel of doubles, whose assets are stored separately.
+     **/
+    const void *getStoredReturns() const;
+
+    /**
+     * Returns the number of values a panel of the given shape and layout
+     * stores, including the padding of partial tiles.
+     *
+     * @param layout - The layout.
+     * @param tileSize - The size of a tile, if the layout is tiled.
+     * @param numOfAssets - The number of assets.
+     * @param numOfReturns - The number of returns per asset.
+     * @return The number of stored values.
+     **/
+    static size_t calculateNumOfStoredReturns(ReturnsLayout layout, int tileSize, int numOfAssets, int numOfReturns);
+
+    /**
+     * Returns a copy of the panel in the given layout. The transposition is
+     * done a block at a time, so that both panels are read and written
+     * within the cache.
+     *
+     * @param layout - The layout of the copy.
+     * @param tileSize - The size of a tile, if the layout is tiled.
+     * @return The panel in the given layout.
+     **/
+    ReturnsPanel toLayout(ReturnsLayout layout, int tileSize = 32) const;
+
+    /**
+     * Returns a copy of the panel, in the same layout, with its returns
+     * stored as the given type. Returns narrowed to floats are rounded to
+     * the nearest float.
+     *
+     * @param precision - The type of the copy's returns.
+     * @return The panel of the given precision.
+     **/
+    ReturnsPanel toPrecision(ReturnsPrecision precision) const;
+
+    /**
+     * Returns the matrix of returns, with a row per asset. The returns of
+     * any panel other than an unmapped asset major panel of doubles are
+     * copied into the matrix, as doubles, on the first call.
+     *
+     * @return The matrix of time-indexed returns.
+     **/
+    const vector<vector<double> > &getReturnsMatrix() const;
+
+    /**
+     * Returns the matrix of returns, with a row per asset, for populating.
+     * The shape of the matrix may not be changed, and only an unmapped
+     * asset major panel of doubles may be populated.
+     *
+     * @return The matrix of time-indexed returns.
+     **/
+    vector<vector<double> > &getWritableReturnsMatrix();
+
+    /**
+     * Appends a day of returns to an unmapped time major panel. Appending
+     * costs O(no_of_assets), amortised, and invalidates any pointers to the
+     * panel's returns.
+     *
+     * @param dayReturns - The return of every asset on the day, with missing returns as NaN.
+     * @param date - The date of the day.
+     **/
+    void appendReturns(const vector<double> &dayReturns, int64_t date);
+
+private:
+    // The returns of an unmapped asset major panel of doubles, or the copy
+    // of any other panel's.
+    mutable vector<vector<double> > returnsMatrix;
+    int numOfAssets;
+    int numOfReturns;
+
+    ReturnsLayout layout;
+    int tileSize;
+    ReturnsPrecision precision;
+
+    // The returns of any other unmapped panel, by precision.
+    vector<double> returns;
+    vector<float> singleReturns;
+
+    vector<string> assetIds;
+    vector<int64_t> dateIndex;
+
+    // The mapping that a mapped panel's returns live in.
+    shared_ptr<const MappedFile> mappedFile;
+    const void *mappedReturns;
+
+    /**
+     * Exits unless the panel is stored in the given layout, with values of
+     * the given size.
+     *
+     * @param layout - The layout needed.
+     * @param valueSize - The size of the values needed, in bytes.
+     **/
+    void checkStorage(ReturnsLayout layout, size_t valueSize) const;
+
+    /**
+     * Returns a copy of the panel in the given layout and precision.
+     *
+     * @param layout - The layout of the copy.
+     * @param tileSize - The size of a tile, if the layout is tiled.
+     * @param precision - The type of the copy's returns.
+     * @return The converted panel.
+     **/
+    ReturnsPanel convert(ReturnsLayout layout, int tileSize, ReturnsPrecision precision) const;
+
+    /**
+     * Gives every asset and return its default ID and date.
+     **/
+    void createDefaultIndex();
+};
+
+#endif
@@ -0,0 +1,235 @@
+#include "returns_panel_file.h"
+
+// Identifies returns panel files.
+static const char returnsPanelMagic[8] = {'M', 'K', 'W', 'P', 'A', 'N', 'E', 'L'};
+static const int returnsPanelVersion = 1;
+
+// The header is 64 bytes, and every section starts on a 64 byte boundary,
+// i.e. a cache line.
+static const int blockSize = 64;
+
+/**
+ * The header of a returns panel file, as laid out in the file.
+ **/
+struct ReturnsPanelHeader
+{
+    char magic[8];
+    int32_t version;
+    int32_t layout;
+    int32_t numOfAssets;
+    int32_t numOfReturns;
+    char dtype[8];
+    int32_t assetIdLength;
+    int32_t tileSize;
+    int64_t assetIdsOffset;
+    int64_t dateIndexOffset;
+    int64_t returnsOffset;
+};
+
+static_assert(sizeof(ReturnsPanelHeader) == blockSize, "The returns panel header must fill one block.");
+
+/**
+ * Returns the numpy dtype string of returns of the given precision.
+ *
+ * @param precision - The precision.
+ * @return The dtype string.
+ **/
+static const char *getDtype(ReturnsPrecision precision)
+{
+    return precision == FLOAT32_RETURNS ? "<f4" : "<f8";
+}
+
+/**
+ * Returns the size of a return of the given precision.
+ *
+ * @param precision - The precision.
+ * @return The number of bytes in a return.
+ **/
+static int64_t getValueSize(ReturnsPrecision precision)
+{
+    return precision == FLOAT32_RETURNS ? sizeof(float) : sizeof(double);
+}
+
+/**
+ * Rounds the given number of bytes up to a multiple of the block size.
+ *
+ * @param numOfBytes - The number of bytes.
+ * @return The aligned number of bytes.
+ **/
+static int64_t alignToBlock(int64_t numOfBytes)
+{
+    return (numOfBytes + blockSize - 1) / blockSize * blockSize;
+}
+
+/**
+ * Pads the given file with zeros up to the given offset.
+ *
+ * @param file - The file, positioned at or before `offset`.
+ * @param offset - The offset to pad to.
+ **/
+static void padTo(ofstream &file, int64_t offset)
+{
+    static const char zeros[blockSize] = {};
+
+    for (int64_t position = file.tellp(); position < offset; position += blockSize)
+    {
+        file.write(zeros, min<int64_t>(blockSize, offset - position));
+    }
+}
+
+/**
+ * Returns whether the given file is a returns panel file, by its magic.
+ *
+ * @param fileName - The name of the file.
+ * @return True if the file is a returns panel file.
+ **/
+bool isReturnsPanelFile(const string &fileName)
+{
+    ifstream file(fileName.c_str(), ios::binary);
+    char magic[sizeof(returnsPanelMagic)];
+
+    return file.read(magic, sizeof(magic)) && memcmp(magic, returnsPanelMagic, sizeof(magic)) == 0;
+}
+
+/**
+ * Writes the given panel to a returns panel file, replacing any existing file.
+ *
+ * @param returnsPanel - The panel.
+ * @param fileName - The name of the file.
+ **/
+void writeReturnsPanelFile(const ReturnsPanel &returnsPanel, const string &fileName)
+{
+    int numOfAssets = returnsPanel.getNumOfAssets();
+    int numOfReturns = returnsPanel.getNumOfReturns();
+    const vector<string> &assetIds = returnsPanel.getAssetIds();
+
+    // Every ID is padded to the length of the longest, with at least one
+    // NUL, rounded up to 8 bytes.
+    int assetIdLength = 8;
+
+    for (int i = 0; i < numOfAssets; i++)
+    {
+        assetIdLength = max<int>(assetIdLength, (assetIds[i].size() + 8) / 8 * 8);
+    }
+
+    ReturnsPanelHeader header = {};
+    memcpy(header.magic, returnsPanelMagic, sizeof(header.magic));
+    strncpy(header.dtype, getDtype(returnsPanel.getPrecision()), sizeof(header.dtype));
+    header.version = returnsPanelVersion;
+    header.layout = returnsPanel.getLayout();
+    header.tileSize = returnsPanel.getTileSize();
+    header.numOfAssets = numOfAssets;
+    header.numOfReturns = numOfReturns;
+    header.assetIdLength = assetIdLength;
+    header.assetIdsOffset = blockSize;
+    header.dateIndexOffset = alignToBlock(header.assetIdsOffset + (int64_t)numOfAssets * assetIdLength);
+    header.returnsOffset = alignToBlock(header.dateIndexOffset + (int64_t)numOfReturns * sizeof(int64_t));
+
+    ofstream file(fileName.c_str(), ios::binary | ios::trunc);
+
+    if (!file.is_open())
+    {
+        cout << "Could not open " << fileName << " to write the returns panel." << endl;
+        exit(EXIT_FAILURE);
+    }
+
+    file.write((const char *)&header, sizeof(header));
+
+    vector<char> assetId(assetIdLength);
+
+    for (int i = 0; i < numOfAssets; i++)
+    {
+        fill(assetId.begin(), assetId.end(), 0);
+        memcpy(assetId.data(), assetIds[i].data(), assetIds[i].size());
+        file.write(assetId.data(), assetIdLength);
+    }
+
+    padTo(file, header.dateIndexOffset);
+    file.write((const char *)returnsPanel.getDateIndex().data(), (int64_t)numOfReturns * sizeof(int64_t));
+
+    padTo(file, header.returnsOffset);
+
+    // An unmapped asset major panel of doubles stores each asset separately.
+    if (returnsPanel.getStoredReturns() == NULL)
+    {
+        for (int i = 0; i < numOfAssets; i++)
+        {
+            file.write((const char *)returnsPanel.getAssetReturns(i), (int64_t)numOfReturns * sizeof(double));
+        }
+    }
+    else
+    {
+        file.write((const char *)returnsPanel.getStoredReturns(), ReturnsPanel::calculateNumOfStoredReturns(returnsPanel.getLayout(), returnsPanel.getTileSize(), numOfAssets, numOfReturns) * getValueSize(returnsPanel.getPrecision()));
+    }
+
+    file.close();
+
+    if (file.fail())
+    {
+        cout << "Could not write the returns panel to " << fileName << "." << endl;
+        exit(EXIT_FAILURE);
+    }
+}
+
+/**
+ * Maps a returns panel file into memory, exiting if it is malformed. The
+ * returned panel reads the returns in place, without copying them.
+ *
+ * @param fileName - The name of the file.
+ * @return The read only panel of returns.
+ **/
+ReturnsPanel mapReturnsPanelFile(const string &fileName)
+{
+    shared_ptr<const MappedFile> mappedFile = make_shared<const MappedFile>(fileName);
+    const char *data = mappedFile->getData();
+    int64_t size = mappedFile->getSize();
+
+    ReturnsPanelHeader header;
+
+    if (size < sizeof(header) || memcmp(data, returnsPanelMagic, sizeof(returnsPanelMagic)) != 0)
+    {
+        cout << fileName << " is not a returns panel file." << endl;
+        exit(EXIT_FAILURE);
+    }
+
+    memcpy(&header, data, sizeof(header));
+
+    bool isLayoutValid = header.layout == ASSET_MAJOR || header.layout == TIME_MAJOR || (header.layout == TILED && header.tileSize > 0);
+    bool isDtypeValid = strncmp(header.dtype, getDtype(FLOAT64_RETURNS), sizeof(header.dtype)) == 0 || strncmp(header.dtype, getDtype(FLOAT32_RETURNS), sizeof(header.dtype)) == 0;
+
+    if (header.version != returnsPanelVersion || !isLayoutValid || !isDtypeValid)
+    {
+        cout << fileName << " is a version " << header.version << " returns panel file with layout " << header.layout << " and dtype " << string(header.dtype, strnlen(header.dtype, sizeof(header.dtype))) << ", which cannot be read." << endl;
+        exit(EXIT_FAILURE);
+    }
+
+    ReturnsPrecision precision = strncmp(header.dtype, getDtype(FLOAT32_RETURNS), sizeof(header.dtype)) == 0 ? FLOAT32_RETURNS : FLOAT64_RETURNS;
+    int numOfAssets = header.numOfAssets;
+    int numOfReturns = header.numOfReturns;
+
+    // Every section must be aligned, in order, and within the file.
+    bool isValid = numOfAssets >= 0 && numOfReturns >= 0 && header.assetIdLength > 0;
+    isValid = isValid && header.assetIdsOffset >= blockSize && header.assetIdsOffset % blockSize == 0;
+    isValid = isValid && header.dateIndexOffset >= header.assetIdsOffset + (int64_t)numOfAssets * header.assetIdLength && header.dateIndexOffset % blockSize == 0;
+    isValid = isValid && header.returnsOffset >= header.dateIndexOffset + (int64_t)numOfReturns * sizeof(int64_t) && header.returnsOffset % blockSize == 0;
+    isValid = isValid && header.returnsOffset + ReturnsPanel::calculateNumOfStoredReturns((ReturnsLayout)header.layout, header.tileSize, numOfAssets, numOfReturns) * getValueSize(precision) <= size;
+
+    if (!isValid)
+    {
+        cout << fileName << " is a malformed returns panel file." << endl;
+        exit(EXIT_FAILURE);
+    }
+
+    vector<string> assetIds(numOfAssets);
+    vector<int64_t> dateIndex(numOfReturns);
+
+    for (int i = 0; i < numOfAssets; i++)
+    {
+        const char *assetId = data + header.assetIdsOffset + (int64_t)i * header.assetIdLength;
+        assetIds[i].assign(assetId, strnlen(assetId, header.assetIdLength));
+    }
+
+    memcpy(dateIndex.data(), data + header.dateIndexOffset, (int64_t)numOfReturns * sizeof(int64_t));
+
+    return ReturnsPanel(mappedFile, data + header.returnsOffset, (ReturnsLayout)header.layout, header.tileSize, precision, numOfAssets, numOfReturns, assetIds, dateIndex);
+}
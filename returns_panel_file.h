@@ -0,0 +1,58 @@
+#ifndef returns_panel_file_h
+#define returns_panel_file_h
+
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include "mapped_file.h"
+#include "returns_panel.h"
+
+using namespace std;
+
+/**
+ * Returns panel files are a binary form of a returns panel that loads by
+ * mapping it into memory, with no parsing, so that a backtest starts in the
+ * same time whatever the length of its history, and processes on the same
+ * machine share one copy of the returns in the page cache.
+ *
+ * The file starts with a 64 byte header (magic, version, `ReturnsLayout`,
+ * number of assets, number of returns, numpy dtype string of the returns,
+ * asset ID length, tile size, and the byte offsets of the asset IDs, date
+ * index and returns). The asset IDs follow as NUL padded strings of the
+ * asset ID length, then the date index as an int64 per return, then the
+ * returns as the panel stores them in its layout, as "<f8" doubles or "<f4"
+ * floats. Each section starts on a 64 byte boundary. Values are little
+ * endian.
+ **/
+
+/**
+ * Returns whether the given file is a returns panel file, by its magic.
+ *
+ * @param fileName - The name of the file.
+ * @return True if the file is a returns panel file.
+ **/
+bool isReturnsPanelFile(const string &fileName);
+
+/**
+ * Writes the given panel to a returns panel file, replacing any existing file.
+ *
+ * @param returnsPanel - The panel.
+ * @param fileName - The name of the file.
+ **/
+void writeReturnsPanelFile(const ReturnsPanel &returnsPanel, const string &fileName);
+
+/**
+ * Maps a returns panel file into memory, exiting if it is malformed. The
+ * returned panel reads the returns in place, without copying them.
+ *
+ * @param fileName - The name of the file.
+ * @return The read only panel of returns.
+ **/
+ReturnsPanel mapReturnsPanelFile(const string &fileName);
+
+#endif
@@ -0,0 +1,322 @@
+#include "returns_prefix_sums.h"
+
+/**
+ * Computes prefix sums of the given values with Neumaier's compensated
+ * summation, writing the sums and their compensation terms. Missing (NaN)
+ * values are summed as zero.
+ *
+ * @param values - The values to be summed.
+ * @param numOfValues - The number of values.
+ * @param sums - Populated with `numOfValues + 1` prefix sums.
+ * @param compensations - Populated with the `numOfValues + 1` compensation terms.
+ **/
+static void calculateCompensatedPrefixSums(const double *values, int numOfValues, vector<double> &sums, vector<double> &compensations)
+{
+    sums.resize(numOfValues + 1);
+    compensations.resize(numOfValues + 1);
+
+    double sum = 0;
+    double compensation = 0;
+
+    sums[0] = 0;
+    compensations[0] = 0;
+
+    for (int t = 0; t < numOfValues; t++)
+    {
+        // Missing (NaN) values are summed as zero.
+        double value = values[t] == values[t] ? values[t] : 0;
+        double total = sum + value;
+
+        // Recover the low order bits lost in the addition.
+        if (fabs(sum) >= fabs(value))
+        {
+            compensation += (sum - total) + value;
+        }
+        else
+        {
+            compensation += (value - total) + sum;
+        }
+
+        sum = total;
+        sums[t + 1] = sum;
+        compensations[t + 1] = compensation;
+    }
+}
+
+/**
+ * Builds the prefix sums over the given matrix of returns.
+ *
+ * @param returnsMatrix - A view of the matrix of time-indexed returns. The returns must outlive the index.
+ * @param storeCrossProducts - Whether to also store cross product prefix sums.
+ *                             Ignored if they would take more than `maxNumOfCrossProductBytes`.
+ **/
+ReturnsPrefixSums::ReturnsPrefixSums(const ReturnsView &returnsMatrix, bool storeCrossProducts)
+{
+    this->returnsMatrix = returnsMatrix;
+    this->numOfAssets = returnsMatrix.getNumOfAssets();
+    this->numOfReturns = returnsMatrix.getNumOfReturns();
+
+    prefixSums.resize(numOfAssets);
+    prefixCompensations.resize(numOfAssets);
+    prefixValidCounts.resize(numOfAssets);
+
+    // Space for the returns of assets i and j, widened to doubles, unless
+    // they can be read in place.
+    vector<double> assetReturnsI;
+    vector<double> assetReturnsJ;
+
+    for (int i = 0; i < numOfAssets; i++)
+    {
+        const double *returns = returnsMatrix.readAssetReturns(i, 0, numOfReturns - 1, assetReturnsI);
+
+        calculateCompensatedPrefixSums(returns, numOfReturns, prefixSums[i], prefixCompensations[i]);
+
+        prefixValidCounts[i].resize(numOfReturns + 1);
+        prefixValidCounts[i][0] = 0;
+
+        for (int t = 0; t < numOfReturns; t++)
+        {
+            prefixValidCounts[i][t + 1] = prefixValidCounts[i][t] + (returns[t] == returns[t]);
+        }
+    }
+
+    if (!storeCrossProducts || calculateNumOfCrossProductBytes(numOfAssets, numOfReturns) > maxNumOfCrossProductBytes)
+    {
+        return;
+    }
+
+    centres.resize(numOfAssets);
+
+    for (int i = 0; i < numOfAssets; i++)
+    {
+        int numOfValidReturns = prefixValidCounts[i][numOfReturns];
+
+        centres[i] = numOfValidReturns > 0 ? (prefixSums[i][numOfReturns] + prefixCompensations[i][numOfReturns]) / numOfValidReturns : 0;
+    }
+
+    int numOfPairs = numOfAssets * (numOfAssets + 1) / 2;
+    vector<double> crossProducts;
+    crossProducts.resize(numOfReturns);
+
+    crossProductPrefixSums.resize(numOfPairs);
+    crossProductPrefixCompensations.resize(numOfPairs);
+
+    for (int i = 0; i < numOfAssets; i++)
+    {
+        const double *returnsI = returnsMatrix.readAssetReturns(i, 0, numOfReturns - 1, assetReturnsI);
+
+        for (int j = i; j < numOfAssets; j++)
+        {
+            const double *returnsJ = returnsMatrix.readAssetReturns(j, 0, numOfReturns - 1, assetReturnsJ);
+
+            for (int t = 0; t < numOfReturns; t++)
+            {
+                crossProducts[t] = (returnsI[t] - centres[i]) * (returnsJ[t] - centres[j]);
+            }
+
+            int pairIdx = getCrossProductIdx(i, j);
+            calculateCompensatedPrefixSums(&crossProducts[0], numOfReturns, crossProductPrefixSums[pairIdx], crossProductPrefixCompensations[pairIdx]);
+        }
+    }
+}
+
+/**
+ * Returns the memory that cross product prefix sums over the given
+ * shape of returns would take.
+ *
+ * @param numOfAssets - The number of assets.
+ * @param numOfReturns - The number of returns per asset.
+ * @return The size of the cross product prefix sums, in bytes.
+ **/
+size_t ReturnsPrefixSums::calculateNumOfCrossProductBytes(int numOfAssets, int numOfReturns)
+{
+    size_t numOfPairs = (size_t)numOfAssets * (numOfAssets + 1) / 2;
+
+    // A sum and a compensation term per pair and prefix.
+    return numOfPairs * (numOfReturns + 1) * 2 * sizeof(double);
+}
+
+/**
+ * Checks whether this index was built over the given matrix of returns.
+ *
+ * @param returnsMatrix - A view of the matrix of time-indexed returns.
+ * @return True if the index can answer queries about `returnsMatrix`.
+ **/
+bool ReturnsPrefixSums::isIndexOf(const ReturnsView &returnsMatrix) const
+{
+    return this->returnsMatrix.isViewOfSameReturns(returnsMatrix);
+}
+
+/**
+ * Checks whether cross product prefix sums are stored.
+ *
+ * @return True if `estimateCovarianceMatrix` may be called.
+ **/
+bool ReturnsPrefixSums::hasCrossProducts() const
+{
+    return !crossProductPrefixSums.empty();
+}
+
+/**
+ * Checks whether any return in the (inclusive) range bounded by
+ * `returnsStartIdx` and `returnsEndIdx` is missing.
+ *
+ * @param returnsStartIdx - The start index of the returns.
+ * @param returnsEndIdx - The end index of the returns.
+ * @return True if there are missing returns.
+ **/
+bool ReturnsPrefixSums::hasMissingReturns(int returnsStartIdx, int returnsEndIdx) const
+{
+    checkRange(returnsStartIdx, returnsEndIdx);
+
+    int numOfDays = returnsEndIdx + 1 - returnsStartIdx;
+
+    for (int i = 0; i < numOfAssets; i++)
+    {
+        if (prefixValidCounts[i][returnsEndIdx + 1] - prefixValidCounts[i][returnsStartIdx] != numOfDays)
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/**
+ * Returns the average return of the given asset over the (inclusive)
+ * range of returns bounded by `returnsStartIdx` and `returnsEndIdx`.
+ *
+ * @param assetIdx - The index of the asset.
+ * @param returnsStartIdx - The start index of the returns.
+ * @param returnsEndIdx - The end index of the returns.
+ * @return The average return.
+ **/
+double ReturnsPrefixSums::calculateMeanReturn(int assetIdx, int returnsStartIdx, int returnsEndIdx) const
+{
+    checkRange(returnsStartIdx, returnsEndIdx);
+
+    double numOfDays = prefixValidCounts[assetIdx][returnsEndIdx + 1] - prefixValidCounts[assetIdx][returnsStartIdx];
+
+    return sumRange(prefixSums[assetIdx], prefixCompensations[assetIdx], returnsStartIdx, returnsEndIdx) / numOfDays;
+}
+
+/**
+ * Returns a column vector of mean returns corresponding to the time period.
+ *
+ * @param returnsStartIdx - The "first day" of the sample of returns.
+ * @param returnsEndIdx - The "last day" of the sample of returns.
+ * @return The column vector of mean returns.
+ **/
+vector<vector<double> > ReturnsPrefixSums::calculateMeanReturns(int returnsStartIdx, int returnsEndIdx) const
+{
+    vector<vector<double> > meanReturns;
+    meanReturns.resize(numOfAssets);
+
+    for (int i = 0; i < numOfAssets; i++)
+    {
+        meanReturns[i].resize(1);
+        meanReturns[i][0] = calculateMeanReturn(i, returnsStartIdx, returnsEndIdx);
+    }
+
+    return meanReturns;
+}
+
+/**
+ * Returns the covariance matrix of returns corresponding to the time period.
+ * Requires cross product prefix sums, and no missing returns in the period.
+ *
+ * Uses cov(i, j) = (sum(d_i * d_j) - sum(d_i) * sum(d_j) / n) / (n - 1), where
+ * d_i = r_i - c_i are the returns centred on the asset's mean over every day.
+ * Both terms are then of the order of the covariance, whereas with the raw
+ * returns they are of the order of the means' products, and cancel.
+ *
+ * @param returnsStartIdx - The "first day" of the sample of returns.
+ * @param returnsEndIdx - The "last day" of the sample of returns.
+ * @return The covariance matrix.
+ **/
+vector<vector<double> > ReturnsPrefixSums::estimateCovarianceMatrix(int returnsStartIdx, int returnsEndIdx) const
+{
+    if (!hasCrossProducts())
+    {
+        cout << "Cross product prefix sums were not stored for this returns matrix." << endl;
+        exit(EXIT_FAILURE);
+    }
+
+    checkRange(returnsStartIdx, returnsEndIdx);
+
+    double numberOfDays = returnsEndIdx + 1 - returnsStartIdx;
+
+    // The sums of the centred returns over the period.
+    vector<double> sumsOfReturns;
+    sumsOfReturns.resize(numOfAssets);
+
+    for (int i = 0; i < numOfAssets; i++)
+    {
+        sumsOfReturns[i] = sumRange(prefixSums[i], prefixCompensations[i], returnsStartIdx, returnsEndIdx) - numberOfDays * centres[i];
+    }
+
+    vector<vector<double> > covarianceMatrix;
+    covarianceMatrix.resize(numOfAssets);
+
+    for (int i = 0; i < numOfAssets; i++)
+    {
+        covarianceMatrix[i].resize(numOfAssets);
+    }
+
+    for (int i = 0; i < numOfAssets; i++)
+    {
+        for (int j = i; j < numOfAssets; j++)
+        {
+            int pairIdx = getCrossProductIdx(i, j);
+            double sumOfProducts = sumRange(crossProductPrefixSums[pairIdx], crossProductPrefixCompensations[pairIdx], returnsStartIdx, returnsEndIdx);
+
+            covarianceMatrix[i][j] = (sumOfProducts - sumsOfReturns[i] * sumsOfReturns[j] / numberOfDays) / (numberOfDays - 1);
+            covarianceMatrix[j][i] = covarianceMatrix[i][j];
+        }
+    }
+
+    return covarianceMatrix;
+}
+
+/**
+ * Returns the (compensated) sum of the given prefix sums over the
+ * (inclusive) range of returns bounded by `returnsStartIdx` and `returnsEndIdx`.
+ *
+ * @param sums - The prefix sums.
+ * @param compensations - The compensation terms of the prefix sums.
+ * @param returnsStartIdx - The start index of the returns.
+ * @param returnsEndIdx - The end index of the returns.
+ * @return The sum over the range.
+ **/
+double ReturnsPrefixSums::sumRange(const vector<double> &sums, const vector<double> &compensations, int returnsStartIdx, int returnsEndIdx) const
+{
+    return (sums[returnsEndIdx + 1] - sums[returnsStartIdx]) + (compensations[returnsEndIdx + 1] - compensations[returnsStartIdx]);
+}
+
+/**
+ * Returns the row of the cross product prefix sums of assets i and j.
+ *
+ * @param i - The index of the first asset.
+ * @param j - The index of the second asset, which must be >= i.
+ * @return The row index.
+ **/
+int ReturnsPrefixSums::getCrossProductIdx(int i, int j) const
+{
+    // Rows 0..i-1 of the upper triangle hold (numOfAssets - k) pairs each.
+    return i * numOfAssets - i * (i - 1) / 2 + (j - i);
+}
+
+/**
+ * Validates the given range of returns, exiting if it is out of bounds.
+ *
+ * @param returnsStartIdx - The start index of the returns.
+ * @param returnsEndIdx - The end index of the returns.
+ **/
+void ReturnsPrefixSums::checkRange(int returnsStartIdx, int returnsEndIdx) const
+{
+    if (returnsStartIdx < 0 || returnsEndIdx >= numOfReturns || returnsStartIdx > returnsEndIdx)
+    {
+        cout << "Returns range [" << returnsStartIdx << ", " << returnsEndIdx << "] is out of bounds." << endl;
+        exit(EXIT_FAILURE);
+    }
+}
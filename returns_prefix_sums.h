@@ -0,0 +1,173 @@
+#ifndef ReturnsPrefixSums_h
+#define ReturnsPrefixSums_h
+
+#include <iostream>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+#include "matrix.h"
+#include "returns_view.h"
+
+using namespace std;
+
+/**
+ * An index of prefix sums over a matrix of returns, built once when the
+ * returns are loaded. Returns stored as floats are widened as they are
+ * read, and every sum is accumulated in double precision. The mean return
+ * of any asset over any (inclusive) range of days is then available in
+ * O(1), rather than O(no_of_days).
+ *
+ * When they fit within `maxNumOfCrossProductBytes`, the prefix sums of the
+ * cross products of every pair of assets can also be stored, which gives
+ * the covariance matrix of any range of days in O(no_of_assets^2). The
+ * cross products are of returns centred on each asset's mean over every
+ * day, so that the covariance is a difference of sums of the size of the
+ * covariance itself, rather than of the squared returns' much larger sums.
+ *
+ * The prefix sums are accumulated with compensated (Neumaier) summation, and
+ * the compensation terms are kept alongside the sums, so that the difference
+ * of two prefix sums does not lose the accuracy of a long running total.
+ *
+ * Missing (NaN) returns are counted as zero in the sums and excluded from
+ * prefix counts of the days with returns, so means skip them.
+ **/
+class ReturnsPrefixSums
+{
+public:
+    // The most memory that cross product prefix sums may take, in bytes.
+    // They take (no_of_assets * (no_of_assets + 1) / 2) x (no_of_days + 1)
+    // sums and as many compensation terms, i.e. 39 MB for 83 assets x 700
+    // days but 660 MB for 128 assets x 5000 days.
+    static const size_t maxNumOfCrossProductBytes = 256 << 20;
+
+    /**
+     * Builds the prefix sums over the given matrix of returns.
+     *
+     * @param returnsMatrix - A view of the matrix of time-indexed returns. The returns must outlive the index.
+     * @param storeCrossProducts - Whether to also store cross product prefix sums.
+     *                             Ignored if they would take more than `maxNumOfCrossProductBytes`.
+     **/
+    ReturnsPrefixSums(const ReturnsView &returnsMatrix, bool storeCrossProducts = false);
+
+    /**
+     * Returns the memory that cross product prefix sums over the given
+     * shape of returns would take.
+     *
+     * @param numOfAssets - The number of assets.
+     * @param numOfReturns - The number of returns per asset.
+     * @return The size of the cross product prefix sums, in bytes.
+     **/
+    static size_t calculateNumOfCrossProductBytes(int numOfAssets, int numOfReturns);
+
+    /**
+     * Checks whether this index was built over the given matrix of returns.
+     *
+     * @param returnsMatrix - A view of the matrix of time-indexed returns.
+     * @return True if the index can answer queries about `returnsMatrix`.
+     **/
+    bool isIndexOf(const ReturnsView &returnsMatrix) const;
+
+    /**
+     * Checks whether cross product prefix sums are stored.
+     *
+     * @return True if `estimateCovarianceMatrix` may be called.
+     **/
+    bool hasCrossProducts() const;
+
+    /**
+     * Checks whether any return in the (inclusive) range bounded by
+     * `returnsStartIdx` and `returnsEndIdx` is missing.
+     *
+     * @param returnsStartIdx - The start index of the returns.
+     * @param returnsEndIdx - The end index of the returns.
+     * @return True if there are missing returns.
+     **/
+    bool hasMissingReturns(int returnsStartIdx, int returnsEndIdx) const;
+
+    /**
+     * Returns the average return of the given asset over the (inclusive)
+     * range of returns bounded by `returnsStartIdx` and `returnsEndIdx`.
+     *
+     * @param assetIdx - The index of the asset.
+     * @param returnsStartIdx - The start index of the returns.
+     * @param returnsEndIdx - The end index of the returns.
+     * @return The average return.
+     **/
+    double calculateMeanReturn(int assetIdx, int returnsStartIdx, int returnsEndIdx) const;
+
+    /**
+     * Returns a column vector of mean returns corresponding to the time period.
+     *
+     * @param returnsStartIdx - The "first day" of the sample of returns.
+     * @param returnsEndIdx - The "last day" of the sample of returns.
+     * @return The column vector of mean returns.
+     **/
+    vector<vector<double> > calculateMeanReturns(int returnsStartIdx, int returnsEndIdx) const;
+
+    /**
+     * Returns the covariance matrix of returns corresponding to the time period.
+     * Requires cross product prefix sums, and no missing returns in the period.
+     *
+     * @param returnsStartIdx - The "first day" of the sample of returns.
+     * @param returnsEndIdx - The "last day" of the sample of returns.
+     * @return The covariance matrix.
+     **/
+    vector<vector<double> > estimateCovarianceMatrix(int returnsStartIdx, int returnsEndIdx) const;
+
+private:
+    // The matrix of returns the index was built over.
+    ReturnsView returnsMatrix;
+
+    int numOfAssets;
+    int numOfReturns;
+
+    // prefixSums[i][t] (plus prefixCompensations[i][t]) is the sum of the
+    // first t returns of asset i. Each row has `numOfReturns + 1` entries.
+    vector<vector<double> > prefixSums;
+    vector<vector<double> > prefixCompensations;
+
+    // prefixValidCounts[i][t] is the number of the first t returns of
+    // asset i that are not missing.
+    vector<vector<int> > prefixValidCounts;
+
+    // The mean of every return of each asset, which the returns are
+    // centred on before their cross products are summed.
+    vector<double> centres;
+
+    // Prefix sums of the products of the centred returns of assets i and
+    // j >= i, with the pair stored at row `getCrossProductIdx(i, j)`.
+    vector<vector<double> > crossProductPrefixSums;
+    vector<vector<double> > crossProductPrefixCompensations;
+
+    /**
+     * Returns the (compensated) sum of the given prefix sums over the
+     * (inclusive) range of returns bounded by `returnsStartIdx` and `returnsEndIdx`.
+     *
+     * @param sums - The prefix sums.
+     * @param compensations - The compensation terms of the prefix sums.
+     * @param returnsStartIdx - The start index of the returns.
+     * @param returnsEndIdx - The end index of the returns.
+     * @return The sum over the range.
+     **/
+    double sumRange(const vector<double> &sums, const vector<double> &compensations, int returnsStartIdx, int returnsEndIdx) const;
+
+    /**
+     * Returns the row of the cross product prefix sums of assets i and j.
+     *
+     * @param i - The index of the first asset.
+     * @param j - The index of the second asset, which must be >= i.
+     * @return The row index.
+     **/
+    int getCrossProductIdx(int i, int j) const;
+
+    /**
+     * Validates the given range of returns, exiting if it is out of bounds.
+     *
+     * @param returnsStartIdx - The start index of the returns.
+     * @param returnsEndIdx - The end index of the returns.
+     **/
+    void checkRange(int returnsStartIdx, int returnsEndIdx) const;
+};
+
+#endif
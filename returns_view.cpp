@@ -0,0 +1,150 @@
+#include "returns_view.h"
+
+/**
+ * Constructs a view of no returns.
+ **/
+ReturnsView::ReturnsView()
+{
+    this->numOfReturns = 0;
+    this->returnStride = 1;
+    this->precision = FLOAT64_RETURNS;
+}
+
+/**
+ * Constructs a view of a matrix of returns, with a row per asset, so that
+ * a matrix may be passed wherever a view is taken.
+ *
+ * @param returnsMatrix - The matrix of time-indexed returns. Must outlive the view.
+ **/
+ReturnsView::ReturnsView(const vector<vector<double> > &returnsMatrix)
+{
+    this->numOfReturns = returnsMatrix.empty() ? 0 : returnsMatrix[0].size();
+    this->returnStride = 1;
+    this->precision = FLOAT64_RETURNS;
+
+    assetReturns.resize(returnsMatrix.size());
+
+    for (int i = 0; i < returnsMatrix.size(); i++)
+    {
+        assetReturns[i] = returnsMatrix[i].data();
+    }
+}
+
+/**
+ * Constructs a view of returns stored with a fixed stride.
+ *
+ * @param assetReturns - A pointer to the first return of each asset.
+ * @param numOfReturns - The number of returns per asset.
+ * @param returnStride - The number of stored values between an asset's consecutive returns.
+ * @param precision - The type of the returns.
+ **/
+ReturnsView::ReturnsView(const vector<const void *> &assetReturns, int numOfReturns, int returnStride, ReturnsPrecision precision)
+{
+    this->assetReturns = assetReturns;
+    this->numOfReturns = numOfReturns;
+    this->returnStride = returnStride;
+    this->precision = precision;
+}
+
+/**
+ * Returns the number of assets.
+ *
+ * @return The number of assets.
+ **/
+int ReturnsView::getNumOfAssets() const
+{
+    return assetReturns.size();
+}
+
+/**
+ * Returns the number of returns per asset.
+ *
+ * @return The number of returns.
+ **/
+int ReturnsView::getNumOfReturns() const
+{
+    return numOfReturns;
+}
+
+/**
+ * Returns the type the returns are stored as.
+ *
+ * @return The precision.
+ **/
+ReturnsPrecision ReturnsView::getPrecision() const
+{
+    return precision;
+}
+
+/**
+ * Returns a single return.
+ *
+ * @param assetIdx - The index of the asset.
+ * @param returnIdx - The index of the return.
+ * @return The return.
+ **/
+double ReturnsView::getReturn(int assetIdx, int returnIdx) const
+{
+    size_t storedReturnIdx = (size_t)returnIdx * returnStride;
+
+    return precision == FLOAT32_RETURNS ? ((const float *)assetReturns[assetIdx])[storedReturnIdx] : ((const double *)assetReturns[assetIdx])[storedReturnIdx];
+}
+
+/**
+ * Returns the given asset's returns over the (inclusive) range bounded by
+ * `returnsStartIdx` and `returnsEndIdx` as contiguous doubles: in place, if
+ * they are stored so, or else gathered and widened into `buffer`.
+ *
+ * @param assetIdx - The index of the asset.
+ * @param returnsStartIdx - The start index of the returns.
+ * @param returnsEndIdx - The end index of the returns.
+ * @param buffer - Space for the returns, used unless they are stored contiguously as doubles.
+ * @return The returns, valid until `buffer` or the viewed returns change.
+ **/
+const double *ReturnsView::readAssetReturns(int assetIdx, int returnsStartIdx, int returnsEndIdx, vector<double> &buffer) const
+{
+    if (precision == FLOAT64_RETURNS && returnStride == 1)
+    {
+        return (const double *)assetReturns[assetIdx] + returnsStartIdx;
+    }
+
+    int numOfRangeReturns = returnsEndIdx + 1 - returnsStartIdx;
+
+    if (buffer.size() < numOfRangeReturns)
+    {
+        buffer.resize(numOfRangeReturns);
+    }
+
+    // The precision is resolved once per asset, rather than per return.
+    if (precision == FLOAT32_RETURNS)
+    {
+        const float *returns = (const float *)assetReturns[assetIdx] + (size_t)returnsStartIdx * returnStride;
+
+        for (int t = 0; t < numOfRangeReturns; t++)
+        {
+            buffer[t] = returns[(size_t)t * returnStride];
+        }
+    }
+    else
+    {
+        const double *returns = (const double *)assetReturns[assetIdx] + (size_t)returnsStartIdx * returnStride;
+
+        for (int t = 0; t < numOfRangeReturns; t++)
+        {
+            buffer[t] = returns[(size_t)t * returnStride];
+        }
+    }
+
+    return buffer.data();
+}
+
+/**
+ * Checks whether both views read the same returns, in place.
+ *
+ * @param other - The other view.
+ * @return True if the views read the same stored returns.
+ **/
+bool ReturnsView::isViewOfSameReturns(const ReturnsView &other) const
+{
+    return assetReturns == other.assetReturns && numOfReturns == other.numOfReturns && returnStride == other.returnStride && precision == other.precision;
+}
@@ -0,0 +1,118 @@
+#ifndef ReturnsView_h
+#define ReturnsView_h
+
+#include <iostream>
+#include <stdlib.h>
+#include <vector>
+
+using namespace std;
+
+/**
+ * The type that a returns panel stores its returns as. Returns have far
+ * fewer significant digits than a float32 holds, so FLOAT32_RETURNS halves
+ * the memory and bandwidth of a panel at no cost in accuracy of the data,
+ * while kernels still accumulate in double precision.
+ **/
+enum ReturnsPrecision
+{
+    FLOAT64_RETURNS,
+    FLOAT32_RETURNS
+};
+
+/**
+ * A read only view of a (no_of_assets x no_of_returns) matrix of returns
+ * that it does not own: a pointer to each asset's first return, and the
+ * stride between an asset's consecutive returns. It reads a matrix of
+ * returns, or an asset major or time major returns panel of either
+ * precision, in place, so that the estimators and the evaluator need no
+ * copy of a panel, e.g. of one mapped from a file. The returned doubles are
+ * widened from floats as they are read, and kernels accumulate in double.
+ *
+ * A view is only valid for as long as the returns it reads.
+ **/
+class ReturnsView
+{
+public:
+    /**
+     * Constructs a view of no returns.
+     **/
+    ReturnsView();
+
+    /**
+     * Constructs a view of a matrix of returns, with a row per asset, so that
+     * a matrix may be passed wherever a view is taken.
+     *
+     * @param returnsMatrix - The matrix of time-indexed returns. Must outlive the view.
+     **/
+    ReturnsView(const vector<vector<double> > &returnsMatrix);
+
+    /**
+     * Constructs a view of returns stored with a fixed stride.
+     *
+     * @param assetReturns - A pointer to the first return of each asset.
+     * @param numOfReturns - The number of returns per asset.
+     * @param returnStride - The number of stored values between an asset's consecutive returns.
+     * @param precision - The type of the returns.
+     **/
+    ReturnsView(const vector<const void *> &assetReturns, int numOfReturns, int returnStride, ReturnsPrecision precision);
+
+    /**
+     * Returns the number of assets.
+     *
+     * @return The number of assets.
+     **/
+    int getNumOfAssets() const;
+
+    /**
+     * Returns the number of returns per asset.
+     *
+     * @return The number of returns.
+     **/
+    int getNumOfReturns() const;
+
+    /**
+     * Returns the type the returns are stored as.
+     *
+     * @return The precision.
+     **/
+    ReturnsPrecision getPrecision() const;
+
+    /**
+     * Returns a single return.
+     *
+     * @param assetIdx - The index of the asset.
+     * @param returnIdx - The index of the return.
+     * @return The return.
+     **/
+    double getReturn(int assetIdx, int returnIdx) const;
+
+    /**
+     * Returns the given asset's returns over the (inclusive) range bounded by
+     * `returnsStartIdx` and `returnsEndIdx` as contiguous doubles: in place, if
+     * they are stored so, or else gathered and widened into `buffer`.
+     *
+     * @param assetIdx - The index of the asset.
+     * @param returnsStartIdx - The start index of the returns.
+     * @param returnsEndIdx - The end index of the returns.
+     * @param buffer - Space for the returns, used unless they are stored contiguously as doubles.
+     * @return The returns, valid until `buffer` or the viewed returns change.
+     **/
+    const double *readAssetReturns(int assetIdx, int returnsStartIdx, int returnsEndIdx, vector<double> &buffer) const;
+
+    /**
+     * Checks whether both views read the same returns, in place.
+     *
+     * @param other - The other view.
+     * @return True if the views read the same stored returns.
+     **/
+    bool isViewOfSameReturns(const ReturnsView &other) const;
+
+private:
+    // A pointer to the first return of each asset.
+    vector<const void *> assetReturns;
+    int numOfReturns;
+    int returnStride;
+    ReturnsPrecision precision;
+};
+
+#endif
@@ -0,0 +1,76 @@
+#include "shard_launcher.h"
+
+/**
+ * Runs every shard of a backtest as a separate local process of the given
+ * executable, invoked as `executable --shard i/n [arguments...]`, and waits
+ * for them all to exit. The shards coordinate only through the files they
+ * write, so on a cluster each of these command lines can be submitted to
+ * the scheduler instead.
+ *
+ * @param executable - The path of the executable.
+ * @param numOfShards - The number of shards.
+ * @param arguments - Further arguments passed to every shard.
+ * @return True if every shard exited successfully.
+ **/
+bool runShardProcesses(const string &executable, int numOfShards, const vector<string> &arguments)
+{
+    vector<pid_t> processIds;
+
+    // Flush before forking, so buffered output is not written by every child.
+    cout.flush();
+
+    for (int shardIdx = 0; shardIdx < numOfShards; shardIdx++)
+    {
+        string shard = to_string(shardIdx) + "/" + to_string(numOfShards);
+
+        vector<string> commandLine;
+        commandLine.push_back(executable);
+        commandLine.push_back("--shard");
+        commandLine.push_back(shard);
+        commandLine.insert(commandLine.end(), arguments.begin(), arguments.end());
+
+        vector<char *> argv;
+
+        for (int i = 0; i < commandLine.size(); i++)
+        {
+            argv.push_back((char *)commandLine[i].c_str());
+        }
+
+        argv.push_back(NULL);
+
+        pid_t processId = fork();
+
+        if (processId < 0)
+        {
+            cout << "Could not start shard " << shard << "." << endl;
+            exit(EXIT_FAILURE);
+        }
+
+        if (processId == 0)
+        {
+            execv(executable.c_str(), &argv[0]);
+
+            // Only reached if the executable could not be run.
+            cout << "Could not run " << executable << " for shard " << shard << "." << endl;
+            _exit(EXIT_FAILURE);
+        }
+
+        processIds.push_back(processId);
+    }
+
+    bool isSuccessful = true;
+
+    for (int shardIdx = 0; shardIdx < numOfShards; shardIdx++)
+    {
+        int status = 0;
+        waitpid(processIds[shardIdx], &status, 0);
+
+        if (!WIFEXITED(status) || WEXITSTATUS(status) != EXIT_SUCCESS)
+        {
+            cout << "Shard " << shardIdx << "/" << numOfShards << " failed." << endl;
+            isSuccessful = false;
+        }
+    }
+
+    return isSuccessful;
+}
@@ -0,0 +1,29 @@
+#ifndef shard_launcher_h
+#define shard_launcher_h
+
+#include <iostream>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <vector>
+
+using namespace std;
+
+/**
+ * Runs every shard of a backtest as a separate local process of the given
+ * executable, invoked as `executable --shard i/n [arguments...]`, and waits
+ * for them all to exit. The shards coordinate only through the files they
+ * write, so on a cluster each of these command lines can be submitted to
+ * the scheduler instead.
+ *
+ * @param executable - The path of the executable.
+ * @param numOfShards - The number of shards.
+ * @param arguments - Further arguments passed to every shard.
+ * @return True if every shard exited successfully.
+ **/
+bool runShardProcesses(const string &executable, int numOfShards, const vector<string> &arguments);
+
+#endif
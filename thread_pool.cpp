@@ -0,0 +1,257 @@
+#include "thread_pool.h"
+
+// The pool and index of the worker running on the current thread, if any.
+static thread_local const ThreadPool *currentPool = NULL;
+static thread_local int currentWorkerIdx = -1;
+
+/**
+ * Starts the worker threads.
+ *
+ * @param numOfThreads - The number of worker threads. Non-positive values
+ *                       mean one thread per hardware thread.
+ **/
+ThreadPool::ThreadPool(int numOfThreads) : numOfQueuedTasks(0), numOfUnfinishedTasks(0), nextQueueIdx(0), isStopping(false)
+{
+    numOfThreads = resolveNumOfThreads(numOfThreads);
+
+    for (int i = 0; i < numOfThreads; i++)
+    {
+        taskQueues.push_back(new TaskQueue());
+    }
+
+    for (int i = 0; i < numOfThreads; i++)
+    {
+        workers.push_back(thread(&ThreadPool::runWorker, this, i));
+    }
+}
+
+/**
+ * Waits for any outstanding tasks, then stops the worker threads.
+ **/
+ThreadPool::~ThreadPool()
+{
+    wait();
+
+    {
+        lock_guard<mutex> lock(poolMutex);
+        isStopping = true;
+    }
+
+    taskAvailable.notify_all();
+
+    // Every worker must have stopped before any queue is freed, as a
+    // worker scans the other queues when looking for work to steal.
+    for (int i = 0; i < workers.size(); i++)
+    {
+        workers[i].join();
+    }
+
+    for (int i = 0; i < taskQueues.size(); i++)
+    {
+        delete taskQueues[i];
+    }
+}
+
+/**
+ * Queues a task for execution. Tasks submitted from a worker thread go to
+ * that worker's own queue; others are spread over the workers in turn.
+ *
+ * @param task - The task to be executed.
+ **/
+void ThreadPool::submit(function<void()> task)
+{
+    int queueIdx = getWorkerIdx();
+
+    if (queueIdx < 0)
+    {
+        queueIdx = nextQueueIdx++ % taskQueues.size();
+    }
+
+    numOfUnfinishedTasks++;
+
+    {
+        lock_guard<mutex> lock(taskQueues[queueIdx]->queueMutex);
+        taskQueues[queueIdx]->tasks.push_back(task);
+    }
+
+    {
+        // Publish under the pool mutex so a worker about to sleep sees it.
+        lock_guard<mutex> lock(poolMutex);
+        numOfQueuedTasks++;
+    }
+
+    taskAvailable.notify_one();
+}
+
+/**
+ * Blocks until every submitted task has finished. Must not be called
+ * from one of the pool's workers, whose own task would never finish.
+ **/
+void ThreadPool::wait()
+{
+    if (getWorkerIdx() >= 0)
+    {
+        cout << "A thread pool cannot be waited on from one of its own workers." << endl;
+        exit(EXIT_FAILURE);
+    }
+
+    unique_lock<mutex> lock(poolMutex);
+
+    while (numOfUnfinishedTasks > 0)
+    {
+        tasksFinished.wait(lock);
+    }
+}
+
+/**
+ * Runs `task(i)` for every i in [0, numOfTasks) on the pool and blocks
+ * until they have all finished. Like `wait`, must not be called from
+ * one of the pool's workers.
+ *
+ * @param numOfTasks - The number of tasks.
+ * @param task - The task, taking the index of the task.
+ **/
+void ThreadPool::parallelFor(int numOfTasks, function<void(int)> task)
+{
+    for (int i = 0; i < numOfTasks; i++)
+    {
+        submit(bind(task, i));
+    }
+
+    wait();
+}
+
+/**
+ * Returns the number of worker threads.
+ *
+ * @return The number of worker threads.
+ **/
+int ThreadPool::getNumOfThreads() const
+{
+    return workers.size();
+}
+
+/**
+ * Returns the index of the worker thread calling this method, in
+ * [0, getNumOfThreads()), or -1 when called from outside the pool.
+ *
+ * @return The index of the calling worker.
+ **/
+int ThreadPool::getWorkerIdx() const
+{
+    return currentPool == this ? currentWorkerIdx : -1;
+}
+
+/**
+ * Resolves a requested number of threads, mapping non-positive values
+ * to the number of hardware threads.
+ *
+ * @param numOfThreads - The requested number of threads.
+ * @return The number of threads to use.
+ **/
+int ThreadPool::resolveNumOfThreads(int numOfThreads)
+{
+    if (numOfThreads > 0)
+    {
+        return numOfThreads;
+    }
+
+    int numOfHardwareThreads = thread::hardware_concurrency();
+
+    return numOfHardwareThreads > 0 ? numOfHardwareThreads : 1;
+}
+
+/**
+ * The loop run by each worker thread.
+ *
+ * @param workerIdx - The index of the worker.
+ **/
+void ThreadPool::runWorker(int workerIdx)
+{
+    currentPool = this;
+    currentWorkerIdx = workerIdx;
+
+    function<void()> task;
+
+    while (true)
+    {
+        if (takeTask(workerIdx, task))
+        {
+            task();
+            task = NULL;
+
+            if (--numOfUnfinishedTasks == 0)
+            {
+                lock_guard<mutex> lock(poolMutex);
+                tasksFinished.notify_all();
+            }
+
+            continue;
+        }
+
+        unique_lock<mutex> lock(poolMutex);
+
+        // A task taken before its submission was counted leaves the count
+        // negative until then, and its submission wakes a worker anyway.
+        while (numOfQueuedTasks <= 0 && !isStopping)
+        {
+            taskAvailable.wait(lock);
+        }
+
+        if (numOfQueuedTasks <= 0 && isStopping)
+        {
+            return;
+        }
+    }
+}
+
+/**
+ * Takes a task for the given worker, from its own queue or by stealing.
+ *
+ * @param workerIdx - The index of the worker.
+ * @param task - Populated with the task taken.
+ * @return True if a task was taken.
+ **/
+bool ThreadPool::takeTask(int workerIdx, function<void()> &task)
+{
+    int numOfQueues = taskQueues.size();
+
+    bool isTaken = false;
+
+    for (int i = 0; i < numOfQueues && !isTaken; i++)
+    {
+        int queueIdx = (workerIdx + i) % numOfQueues;
+        TaskQueue *taskQueue = taskQueues[queueIdx];
+
+        lock_guard<mutex> lock(taskQueue->queueMutex);
+
+        if (taskQueue->tasks.empty())
+        {
+            continue;
+        }
+
+        // The owner works from the back of its queue (most recently submitted,
+        // likely still in cache); thieves take the oldest task from the front.
+        if (i == 0)
+        {
+            task = taskQueue->tasks.back();
+            taskQueue->tasks.pop_back();
+        }
+        else
+        {
+            task = taskQueue->tasks.front();
+            taskQueue->tasks.pop_front();
+        }
+
+        isTaken = true;
+    }
+
+    if (isTaken)
+    {
+        // Counted under the pool mutex, as the workers decide to sleep on it.
+        lock_guard<mutex> lock(poolMutex);
+        numOfQueuedTasks--;
+    }
+
+    return isTaken;
+}
@@ -0,0 +1,128 @@
+#ifndef ThreadPool_h
+#define ThreadPool_h
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <iostream>
+#include <mutex>
+#include <stdlib.h>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+/**
+ * A fixed size pool of worker threads with work stealing. Every worker owns
+ * a double-ended queue of tasks. A worker takes its newest task first, and
+ * when its own queue is empty it steals the oldest task from another worker,
+ * so that uneven tasks are balanced across the pool.
+ **/
+class ThreadPool
+{
+public:
+    /**
+     * Starts the worker threads.
+     *
+     * @param numOfThreads - The number of worker threads. Non-positive values
+     *                       mean one thread per hardware thread.
+     **/
+    ThreadPool(int numOfThreads = 0);
+
+    /**
+     * Waits for any outstanding tasks, then stops the worker threads.
+     **/
+    ~ThreadPool();
+
+    /**
+     * Queues a task for execution. Tasks submitted from a worker thread go to
+     * that worker's own queue; others are spread over the workers in turn.
+     *
+     * @param task - The task to be executed.
+     **/
+    void submit(function<void()> task);
+
+    /**
+     * Blocks until every submitted task has finished. Must not be called
+     * from one of the pool's workers, whose own task would never finish.
+     **/
+    void wait();
+
+    /**
+     * Runs `task(i)` for every i in [0, numOfTasks) on the pool and blocks
+     * until they have all finished. Like `wait`, must not be called from
+     * one of the pool's workers.
+     *
+     * @param numOfTasks - The number of tasks.
+     * @param task - The task, taking the index of the task.
+     **/
+    void parallelFor(int numOfTasks, function<void(int)> task);
+
+    /**
+     * Returns the number of worker threads.
+     *
+     * @return The number of worker threads.
+     **/
+    int getNumOfThreads() const;
+
+    /**
+     * Returns the index of the worker thread calling this method, in
+     * [0, getNumOfThreads()), or -1 when called from outside the pool.
+     *
+     * @return The index of the calling worker.
+     **/
+    int getWorkerIdx() const;
+
+    /**
+     * Resolves a requested number of threads, mapping non-positive values
+     * to the number of hardware threads.
+     *
+     * @param numOfThreads - The requested number of threads.
+     * @return The number of threads to use.
+     **/
+    static int resolveNumOfThreads(int numOfThreads);
+
+private:
+    // A worker's queue of tasks.
+    struct TaskQueue
+    {
+        mutex queueMutex;
+        deque<function<void()> > tasks;
+    };
+
+    vector<thread> workers;
+    vector<TaskQueue *> taskQueues;
+
+    // Guards sleeping and waking of the workers and of `wait`.
+    mutex poolMutex;
+    condition_variable taskAvailable;
+    condition_variable tasksFinished;
+
+    // Tasks queued but not yet taken, guarded by `poolMutex`. A task may be
+    // taken before its submission is counted, so this may briefly be negative.
+    int numOfQueuedTasks;
+
+    // Tasks submitted but not yet finished.
+    atomic<int> numOfUnfinishedTasks;
+    atomic<unsigned int> nextQueueIdx;
+    bool isStopping;
+
+    /**
+     * The loop run by each worker thread.
+     *
+     * @param workerIdx - The index of the worker.
+     **/
+    void runWorker(int workerIdx);
+
+    /**
+     * Takes a task for the given worker, from its own queue or by stealing.
+     *
+     * @param workerIdx - The index of the worker.
+     * @param task - Populated with the task taken.
+     * @return True if a task was taken.
+     **/
+    bool takeTask(int workerIdx, function<void()> &task);
+};
+
+#endif
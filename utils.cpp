@@ -10,30 +10,119 @@
  * @param returnsEndIdx - The end index of the returns.
  * @return The covariance matrix.
  **/
-vector<vector<double> > estimateCovarianceMatrix(const vector<vector<double> > &returnsMatrix, int returnsStartIdx, int returnsEndIdx)
+vector<vector<double> > estimateCovarianceMatrix(const ReturnsView &returnsMatrix, int returnsStartIdx, int returnsEndIdx)
 {
-    // The number of days in the sample period (inclusive bounds - `returnsStartIdx` and `returnsEndIdx`)
-    // that the covariance of returns matrix is being calculated for.
-    double numberOfDays = returnsEndIdx + 1 - returnsStartIdx;
+    vector<vector<double> > meanReturns;
+    vector<vector<double> > covarianceMatrix;
 
-    // Number of rows and columns respectively.
-    int numOfAssets = returnsMatrix.size();
+    estimateMeanReturnsAndCovarianceMatrix(returnsMatrix, returnsStartIdx, returnsEndIdx, meanReturns, covarianceMatrix);
 
-    // A matrix to store the return data. The mean return at index i corresponds to
-    // the average of the returns bounded by `returnsStartIdx` and `returnsEndIdx`.
-    vector<double> meanReturns;
-    meanReturns.resize(numOfAssets);
+    return covarianceMatrix;
+}
 
-    // Populate mean returns vector. The entry at index `assetIdx`
-    // in the vector corresponds to the average return of the returns
-    // bounded by the indices `returnsStartIdx` and `returnsEndIdx`;
-    for (int assetIdx = 0; assetIdx < numOfAssets; assetIdx++)
+/**
+ * Estimates both the mean returns and the covariance matrix of returns in a
+ * single sweep over the (inclusive) range of returns bounded by `returnsStartIdx`
+ * and `returnsEndIdx`.
+ * 
+ * The returns are consumed in blocks of days. Each block is centred on its own
+ * mean and its co-moments are merged into the running totals with the pairwise
+ * update of Chan, Golub and LeVeque - the block generalisation of Welford's
+ * algorithm - which avoids the cancellation of the naive sum of products.
+ * 
+ * Samples with missing (NaN) returns are handed to the pairwise-complete
+ * estimator instead.
+ * 
+ * @param returnsMatrix - The matrix of returns.
+ * @param returnsStartIdx - The start index of the returns.
+ * @param returnsEndIdx - The end index of the returns.
+ * @param meanReturns - Populated with the column vector of mean returns.
+ * @param covarianceMatrix - Populated with the covariance matrix.
+ **/
+void estimateMeanReturnsAndCovarianceMatrix(const ReturnsView &returnsMatrix, int returnsStartIdx, int returnsEndIdx, vector<vector<double> > &meanReturns, vector<vector<double> > &covarianceMatrix)
+{
+    if (hasMissingReturns(returnsMatrix, returnsStartIdx, returnsEndIdx))
     {
-        meanReturns[assetIdx] = calculateMeanReturn(returnsMatrix, assetIdx, returnsStartIdx, returnsEndIdx);
+        estimatePairwiseMeanReturnsAndCovarianceMatrix(returnsMatrix, returnsStartIdx, returnsEndIdx, meanReturns, covarianceMatrix);
+        return;
     }
 
-    // A matrix to store the covariance data.
-    vector<vector<double> > covarianceMatrix;
+    // The number of days consumed per block. A block of centred returns
+    // for every asset should comfortably fit in cache.
+    const int blockSize = 64;
+
+    int numOfAssets = returnsMatrix.getNumOfAssets();
+
+    // Running means and the upper triangle of the running sums of
+    // products of mean deviations (the co-moments).
+    vector<double> runningMeans(numOfAssets, 0);
+    vector<vector<double> > coMoments(numOfAssets, vector<double>(numOfAssets, 0));
+
+    // Block of returns centred on the block means, stored asset by asset.
+    vector<double> centredBlock(numOfAssets * blockSize);
+    vector<double> meanDeltas(numOfAssets);
+
+    // Space for a block of an asset's returns, widened to doubles, unless
+    // they can be read in place.
+    vector<double> blockReturns(blockSize);
+
+    double numOfDays = 0;
+
+    for (int blockStartIdx = returnsStartIdx; blockStartIdx <= returnsEndIdx; blockStartIdx += blockSize)
+    {
+        int blockEndIdx = min(returnsEndIdx, blockStartIdx + blockSize - 1);
+        int numOfBlockDays = blockEndIdx + 1 - blockStartIdx;
+
+        double totalNumOfDays = numOfDays + numOfBlockDays;
+
+        for (int i = 0; i < numOfAssets; i++)
+        {
+            const double *returns = returnsMatrix.readAssetReturns(i, blockStartIdx, blockEndIdx, blockReturns);
+            double *centredReturns = &centredBlock[i * blockSize];
+            double blockMean = 0;
+
+            for (int k = 0; k < numOfBlockDays; k++)
+            {
+                blockMean += returns[k];
+            }
+
+            blockMean /= numOfBlockDays;
+
+            for (int k = 0; k < numOfBlockDays; k++)
+            {
+                centredReturns[k] = returns[k] - blockMean;
+            }
+
+            meanDeltas[i] = blockMean - runningMeans[i];
+            runningMeans[i] += meanDeltas[i] * numOfBlockDays / totalNumOfDays;
+        }
+
+        // Weight of the correction for the shift between the running and block means.
+        double mergeFactor = numOfDays * numOfBlockDays / totalNumOfDays;
+
+        for (int i = 0; i < numOfAssets; i++)
+        {
+            const double *centredReturnsI = &centredBlock[i * blockSize];
+            double *coMomentsRow = &coMoments[i][0];
+
+            for (int j = i; j < numOfAssets; j++)
+            {
+                const double *centredReturnsJ = &centredBlock[j * blockSize];
+                double sumOfMeanDeviationProducts = 0;
+
+                for (int k = 0; k < numOfBlockDays; k++)
+                {
+                    sumOfMeanDeviationProducts += centredReturnsI[k] * centredReturnsJ[k];
+                }
+
+                coMomentsRow[j] += sumOfMeanDeviationProducts + mergeFactor * meanDeltas[i] * meanDeltas[j];
+            }
+        }
+
+        numOfDays = totalNumOfDays;
+    }
+
+    meanReturns = convertFromRowToColumnVector(runningMeans);
 
     // Allocate memory for covariance data.
     covarianceMatrix.resize(numOfAssets);
@@ -43,50 +132,202 @@ vector<vector<double> > estimateCovarianceMatrix(const vector<vector<double> > &
         covarianceMatrix[i].resize(numOfAssets);
     }
 
-    // Temporary variables used in covariance calculation.
-    double sumOfMeanDeviationProducts, productOfMeanDeviations;
+    // Populate covariance matrix from the upper triangle of co-moments.
+    for (int i = 0; i < numOfAssets; i++)
+    {
+        for (int j = i; j < numOfAssets; j++)
+        {
+            covarianceMatrix[i][j] = coMoments[i][j] / (numOfDays - 1);
+            covarianceMatrix[j][i] = covarianceMatrix[i][j];
+        }
+    }
+}
+
+/**
+ * Estimates the mean returns and the pairwise-complete covariance matrix of returns
+ * over the (inclusive) range of returns bounded by `returnsStartIdx` and `returnsEndIdx`,
+ * where missing returns are NaN. Each mean uses the days on which the asset has a
+ * return, and each covariance uses the days on which both assets have a return.
+ * 
+ * The window is first densified: missing returns are replaced by zero and
+ * each asset gets a bitmask of the days it has a return on, along with the
+ * same indicator as 0/1 doubles. The sums over the days common to a pair of
+ * assets are then plain, branch-free dot products over the zero-filled
+ * returns and indicators, and the number of common days is the popcount of
+ * the AND of the two bitmasks, 64 days at a time.
+ * 
+ * @param returnsMatrix - The matrix of returns.
+ * @param returnsStartIdx - The start index of the returns.
+ * @param returnsEndIdx - The end index of the returns.
+ * @param meanReturns - Populated with the column vector of mean returns.
+ * @param covarianceMatrix - Populated with the covariance matrix.
+ **/
+void estimatePairwiseMeanReturnsAndCovarianceMatrix(const ReturnsView &returnsMatrix, int returnsStartIdx, int returnsEndIdx, vector<vector<double> > &meanReturns, vector<vector<double> > &covarianceMatrix)
+{
+    int numOfAssets = returnsMatrix.getNumOfAssets();
+    int numOfDays = returnsEndIdx + 1 - returnsStartIdx;
+    int numOfMaskWords = (numOfDays + 63) / 64;
+
+    // Zero-filled returns, centred on the asset's mean, and indicators
+    // of the days with returns. Stored asset by asset.
+    vector<double> centredReturns(numOfAssets * numOfDays);
+    vector<double> indicators(numOfAssets * numOfDays);
+    vector<uint64_t> masks(numOfAssets * numOfMaskWords, 0);
+    vector<double> windowReturns(numOfDays);
+
+    meanReturns.resize(numOfAssets);
+
+    for (int i = 0; i < numOfAssets; i++)
+    {
+        const double *returns = returnsMatrix.readAssetReturns(i, returnsStartIdx, returnsEndIdx, windowReturns);
+        double *assetReturns = &centredReturns[i * numOfDays];
+        double *assetIndicators = &indicators[i * numOfDays];
+        uint64_t *assetMasks = &masks[i * numOfMaskWords];
+
+        double sumOfReturns = 0;
+        int numOfValidDays = 0;
+
+        for (int k = 0; k < numOfDays; k++)
+        {
+            bool isValid = returns[k] == returns[k];
+
+            assetReturns[k] = isValid ? returns[k] : 0;
+            assetIndicators[k] = isValid;
+            assetMasks[k / 64] |= (uint64_t)isValid << (k % 64);
+            sumOfReturns += assetReturns[k];
+        }
+
+        for (int w = 0; w < numOfMaskWords; w++)
+        {
+            numOfValidDays += __builtin_popcountll(assetMasks[w]);
+        }
+
+        double meanReturn = numOfValidDays > 0 ? sumOfReturns / numOfValidDays : NAN;
+
+        meanReturns[i].resize(1);
+        meanReturns[i][0] = meanReturn;
+
+        // Centre the valid returns; the missing ones stay at zero.
+        double centre = numOfValidDays > 0 ? meanReturn : 0;
+
+        for (int k = 0; k < numOfDays; k++)
+        {
+            assetReturns[k] -= assetIndicators[k] * centre;
+        }
+    }
+
+    covarianceMatrix.resize(numOfAssets);
 
-    // Populate covariance matrix.
     for (int i = 0; i < numOfAssets; i++)
     {
-        for (int j = 0; j < numOfAssets; j++)
+        covarianceMatrix[i].resize(numOfAssets);
+    }
+
+    for (int i = 0; i < numOfAssets; i++)
+    {
+        const double *returnsI = &centredReturns[i * numOfDays];
+        const double *indicatorsI = &indicators[i * numOfDays];
+        const uint64_t *masksI = &masks[i * numOfMaskWords];
+
+        for (int j = i; j < numOfAssets; j++)
         {
-            sumOfMeanDeviationProducts = 0;
+            const double *returnsJ = &centredReturns[j * numOfDays];
+            const double *indicatorsJ = &indicators[j * numOfDays];
+            const uint64_t *masksJ = &masks[j * numOfMaskWords];
+
+            int numOfCommonDays = 0;
+
+            for (int w = 0; w < numOfMaskWords; w++)
+            {
+                numOfCommonDays += __builtin_popcountll(masksI[w] & masksJ[w]);
+            }
 
-            for (int k = returnsStartIdx; k <= returnsEndIdx; k++)
+            // Sums over the common days. A missing return is zero, so it
+            // removes its day from the sum of products on its own.
+            double sumOfProducts = 0;
+            double sumOfReturnsI = 0;
+            double sumOfReturnsJ = 0;
+
+            for (int k = 0; k < numOfDays; k++)
             {
-                productOfMeanDeviations = (returnsMatrix[i][k] - meanReturns[i]) * (returnsMatrix[j][k] - meanReturns[j]);
+                sumOfProducts += returnsI[k] * returnsJ[k];
+                sumOfReturnsI += returnsI[k] * indicatorsJ[k];
+                sumOfReturnsJ += returnsJ[k] * indicatorsI[k];
+            }
+
+            double covariance = NAN;
 
-                sumOfMeanDeviationProducts += productOfMeanDeviations;
+            if (numOfCommonDays > 1)
+            {
+                covariance = (sumOfProducts - sumOfReturnsI * sumOfReturnsJ / numOfCommonDays) / (numOfCommonDays - 1);
             }
 
-            // Assign calculated covariance value into covariance matrix.
-            covarianceMatrix[i][j] = sumOfMeanDeviationProducts / (numberOfDays - 1);
+            covarianceMatrix[i][j] = covariance;
+            covarianceMatrix[j][i] = covariance;
         }
     }
+}
 
-    return covarianceMatrix;
+/**
+ * Checks whether any return in the (inclusive) range bounded by `returnsStartIdx`
+ * and `returnsEndIdx` is missing, i.e. NaN.
+ * 
+ * @param returnsMatrix - The matrix of returns.
+ * @param returnsStartIdx - The start index of the returns.
+ * @param returnsEndIdx - The end index of the returns.
+ * @return True if there are missing returns.
+ **/
+bool hasMissingReturns(const ReturnsView &returnsMatrix, int returnsStartIdx, int returnsEndIdx)
+{
+    int numOfDays = returnsEndIdx + 1 - returnsStartIdx;
+    vector<double> windowReturns;
+
+    for (int assetIdx = 0; assetIdx < returnsMatrix.getNumOfAssets(); assetIdx++)
+    {
+        const double *returns = returnsMatrix.readAssetReturns(assetIdx, returnsStartIdx, returnsEndIdx, windowReturns);
+        bool isMissing = false;
+
+        // Accumulate without branching so that the scan vectorises.
+        for (int k = 0; k < numOfDays; k++)
+        {
+            isMissing |= returns[k] != returns[k];
+        }
+
+        if (isMissing)
+        {
+            return true;
+        }
+    }
+
+    return false;
 }
 
 /**
  * Given a vector of returns, this function calculates and returns the average return.
  * The start and end index parameters denote the (inclusive) range of returns
- * to calculate the returns for.
+ * to calculate the returns for. Missing (NaN) returns are skipped.
  * 
  * @param returnsMatrix - The matrix of returns.
  * @param returnsStartIdx - The start index of the returns.
  * @param returnsEndIdx - The end index of the returns.
  * @return The average return.
  **/
-double calculateMeanReturn(const vector<vector<double> > &returnsMatrix, int assetIdx, int returnsStartIdx, int returnsEndIdx)
+double calculateMeanReturn(const ReturnsView &returnsMatrix, int assetIdx, int returnsStartIdx, int returnsEndIdx)
 {
     double meanReturn = 0;
     double numOfReturns = 0;
 
-    for (int returnsIdx = returnsStartIdx; returnsIdx <= returnsEndIdx; returnsIdx++)
+    vector<double> windowReturns;
+    const double *returns = returnsMatrix.readAssetReturns(assetIdx, returnsStartIdx, returnsEndIdx, windowReturns);
+
+    // Missing (NaN) returns contribute neither to the sum nor the count.
+    for (int k = 0; k <= returnsEndIdx - returnsStartIdx; k++)
     {
-        meanReturn += returnsMatrix[assetIdx][returnsIdx];
-        numOfReturns += 1;
+        double value = returns[k];
+        bool isValid = value == value;
+
+        meanReturn += isValid ? value : 0;
+        numOfReturns += isValid;
     }
 
     return meanReturn / numOfReturns;
@@ -102,9 +343,9 @@ double calculateMeanReturn(const vector<vector<double> > &returnsMatrix, int ass
  * @param returnsEndIdx - The "last day" of the sample of returns.
  * @return The column vector of mean returns.
  **/
-vector<vector<double> > calculateMeanReturns(const vector<vector<double> > &returnsMatrix, int returnsStartIdx, int returnsEndIdx)
+vector<vector<double> > calculateMeanReturns(const ReturnsView &returnsMatrix, int returnsStartIdx, int returnsEndIdx)
 {
-    int numOfAssets = returnsMatrix.size();
+    int numOfAssets = returnsMatrix.getNumOfAssets();
 
     vector<vector<double> > meanReturns;
     meanReturns.resize(numOfAssets);
@@ -119,3 +360,69 @@ vector<vector<double> > calculateMeanReturns(const vector<vector<double> > &retu
 
     return meanReturns;
 }
+
+/**
+ * Splits `numOfTasks` tasks into `numOfShards` contiguous ranges of nearly
+ * equal size, and returns the (half open) range of the given shard. The
+ * split depends only on its arguments, so every process agrees on it.
+ * 
+ * @param numOfTasks - The number of tasks.
+ * @param shardIdx - The index of the shard, in [0, numOfShards).
+ * @param numOfShards - The number of shards.
+ * @param firstTaskIdx - Populated with the index of the first task of the shard.
+ * @param endTaskIdx - Populated with the index one past the last task of the shard.
+ **/
+void getShardRange(int numOfTasks, int shardIdx, int numOfShards, int &firstTaskIdx, int &endTaskIdx)
+{
+    if (numOfShards < 1 || shardIdx < 0 || shardIdx >= numOfShards)
+    {
+        cout << "Shard " << shardIdx << " of " << numOfShards << " does not exist." << endl;
+        exit(EXIT_FAILURE);
+    }
+
+    firstTaskIdx = (int)((long long)numOfTasks * shardIdx / numOfShards);
+    endTaskIdx = (int)((long long)numOfTasks * (shardIdx + 1) / numOfShards);
+}
+
+/**
+ * Returns the 64 bit FNV-1a hash of the given bytes. Hashes of several
+ * buffers can be chained by passing the previous hash as `hash`.
+ * 
+ * @param data - The bytes to be hashed.
+ * @param numOfBytes - The number of bytes.
+ * @param hash - The hash to continue from.
+ * @return The hash.
+ **/
+uint64_t calculateFnv1aHash(const void *data, size_t numOfBytes, uint64_t hash)
+{
+    const unsigned char *bytes = (const unsigned char *)data;
+
+    for (size_t i = 0; i < numOfBytes; i++)
+    {
+        hash = (hash ^ bytes[i]) * 1099511628211ULL;
+    }
+
+    return hash;
+}
+
+/**
+ * Returns the 64 bit FNV-1a hash of every return in the given matrix. The
+ * returns are hashed as doubles, asset by asset, so the hash of a panel
+ * does not depend on its layout.
+ * 
+ * @param returnsMatrix - The matrix of returns.
+ * @param hash - The hash to continue from.
+ * @return The hash.
+ **/
+uint64_t calculateFnv1aHash(const ReturnsView &returnsMatrix, uint64_t hash)
+{
+    int numOfReturns = returnsMatrix.getNumOfReturns();
+    vector<double> assetReturns;
+
+    for (int i = 0; i < returnsMatrix.getNumOfAssets(); i++)
+    {
+        hash = calculateFnv1aHash(returnsMatrix.readAssetReturns(i, 0, numOfReturns - 1, assetReturns), numOfReturns * sizeof(double), hash);
+    }
+
+    return hash;
+}
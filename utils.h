@@ -3,7 +3,13 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <algorithm>
+#include <iostream>
+#include <math.h>
+#include <stdint.h>
 #include <vector>
+#include "matrix.h"
+#include "returns_view.h"
 
 using namespace std;
 
@@ -17,19 +23,57 @@ using namespace std;
  * @param returnsEndIdx - The end index of the returns.
  * @return The covariance matrix.
  **/
-vector<vector<double> > estimateCovarianceMatrix(const vector<vector<double> > &returnsMatrix, int returnsStartIdx, int returnsEndIdx);
+vector<vector<double> > estimateCovarianceMatrix(const ReturnsView &returnsMatrix, int returnsStartIdx, int returnsEndIdx);
+
+/**
+ * Estimates both the mean returns and the covariance matrix of returns in a
+ * single sweep over the (inclusive) range of returns bounded by `returnsStartIdx`
+ * and `returnsEndIdx`.
+ * 
+ * @param returnsMatrix - The matrix of returns.
+ * @param returnsStartIdx - The start index of the returns.
+ * @param returnsEndIdx - The end index of the returns.
+ * @param meanReturns - Populated with the column vector of mean returns.
+ * @param covarianceMatrix - Populated with the covariance matrix.
+ **/
+void estimateMeanReturnsAndCovarianceMatrix(const ReturnsView &returnsMatrix, int returnsStartIdx, int returnsEndIdx, vector<vector<double> > &meanReturns, vector<vector<double> > &covarianceMatrix);
+
+/**
+ * Estimates the mean returns and the pairwise-complete covariance matrix of returns
+ * over the (inclusive) range of returns bounded by `returnsStartIdx` and `returnsEndIdx`,
+ * where missing returns are NaN. Each mean uses the days on which the asset has a
+ * return, and each covariance uses the days on which both assets have a return.
+ * 
+ * @param returnsMatrix - The matrix of returns.
+ * @param returnsStartIdx - The start index of the returns.
+ * @param returnsEndIdx - The end index of the returns.
+ * @param meanReturns - Populated with the column vector of mean returns.
+ * @param covarianceMatrix - Populated with the covariance matrix.
+ **/
+void estimatePairwiseMeanReturnsAndCovarianceMatrix(const ReturnsView &returnsMatrix, int returnsStartIdx, int returnsEndIdx, vector<vector<double> > &meanReturns, vector<vector<double> > &covarianceMatrix);
+
+/**
+ * Checks whether any return in the (inclusive) range bounded by `returnsStartIdx`
+ * and `returnsEndIdx` is missing, i.e. NaN.
+ * 
+ * @param returnsMatrix - The matrix of returns.
+ * @param returnsStartIdx - The start index of the returns.
+ * @param returnsEndIdx - The end index of the returns.
+ * @return True if there are missing returns.
+ **/
+bool hasMissingReturns(const ReturnsView &returnsMatrix, int returnsStartIdx, int returnsEndIdx);
 
 /**
  * Given a vector of returns, this function calculates and returns the average return.
  * The start and end index parameters denote the (inclusive) range of returns
- * to calculate the returns for.
+ * to calculate the returns for. Missing (NaN) returns are skipped.
  * 
  * @param returnsMatrix - The matrix of returns.
  * @param returnsStartIdx - The start index of the returns.
  * @param returnsEndIdx - The end index of the returns.
  * @return The average return.
  **/
-double calculateMeanReturn(const vector<vector<double> > &returnsMatrix, int assetIdx, int returnsStartIdx, int returnsEndIdx);
+double calculateMeanReturn(const ReturnsView &returnsMatrix, int assetIdx, int returnsStartIdx, int returnsEndIdx);
 
 /**
  * Returns a column vector of mean returns corresponding to the time period.
@@ -39,6 +83,39 @@ double calculateMeanReturn(const vector<vector<double> > &returnsMatrix, int ass
  * @param returnsEndIdx - The "last day" of the sample of returns.
  * @return The column vector of mean returns.
  **/
-vector<vector<double> > calculateMeanReturns(const vector<vector<double> > &returnsMatrix, int returnsStartIdx, int returnsEndIdx);
+vector<vector<double> > calculateMeanReturns(const ReturnsView &returnsMatrix, int returnsStartIdx, int returnsEndIdx);
+
+/**
+ * Splits `numOfTasks` tasks into `numOfShards` contiguous ranges of nearly
+ * equal size, and returns the (half open) range of the given shard. The
+ * split depends only on its arguments, so every process agrees on it.
+ * 
+ * @param numOfTasks - The number of tasks.
+ * @param shardIdx - The index of the shard, in [0, numOfShards).
+ * @param numOfShards - The number of shards.
+ * @param firstTaskIdx - Populated with the index of the first task of the shard.
+ * @param endTaskIdx - Populated with the index one past the last task of the shard.
+ **/
+void getShardRange(int numOfTasks, int shardIdx, int numOfShards, int &firstTaskIdx, int &endTaskIdx);
+
+/**
+ * Returns the 64 bit FNV-1a hash of the given bytes. Hashes of several
+ * buffers can be chained by passing the previous hash as `hash`.
+ * 
+ * @param data - The bytes to be hashed.
+ * @param numOfBytes - The number of bytes.
+ * @param hash - The hash to continue from.
+ * @return The hash.
+ **/
+uint64_t calculateFnv1aHash(const void *data, size_t numOfBytes, uint64_t hash = 14695981039346656037ULL);
+
+/**
+ * Returns the 64 bit FNV-1a hash of every return in the given matrix.
+ * 
+ * @param returnsMatrix - The matrix of returns.
+ * @param hash - The hash to continue from.
+ * @return The hash.
+ **/
+uint64_t calculateFnv1aHash(const ReturnsView &returnsMatrix, uint64_t hash = 14695981039346656037ULL);
 
 #endif
\ No newline at end of file
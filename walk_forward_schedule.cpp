@@ -0,0 +1,132 @@
+#include "walk_forward_schedule.h"
+
+/**
+ * Constructs a schedule.
+ *
+ * @param numOfReturns - The number of returns in the data.
+ * @param inSampleSize - The window size of the insample (the initial size when expanding).
+ * @param outOfSampleSize - The window size of the out of sample.
+ * @param scheme - How the in sample period moves between windows.
+ * @param stepSize - The number of days between consecutive windows.
+ *                   Non-positive values mean `outOfSampleSize`.
+ **/
+WalkForwardSchedule::WalkForwardSchedule(int numOfReturns, int inSampleSize, int outOfSampleSize, WalkForwardScheme scheme, int stepSize)
+{
+    // Sample standard deviations need at least two days.
+    if (inSampleSize < 2 || outOfSampleSize < 2)
+    {
+        cout << "The in sample and out of sample sizes must each be at least 2 days." << endl;
+        exit(EXIT_FAILURE);
+    }
+
+    this->numOfReturns = numOfReturns;
+    this->inSampleSize = inSampleSize;
+    this->outOfSampleSize = outOfSampleSize;
+    this->scheme = scheme;
+    this->stepSize = stepSize > 0 ? stepSize : outOfSampleSize;
+
+    // Under every scheme the last out of sample day of window k is
+    // inSampleSize + outOfSampleSize - 1 + k * stepSize, which must be in the data.
+    int numOfSpareReturns = numOfReturns - inSampleSize - outOfSampleSize;
+    this->numOfWindows = numOfSpareReturns >= 0 ? numOfSpareReturns / this->stepSize + 1 : 0;
+    this->firstWindowIdx = 0;
+    this->endWindowIdx = numOfWindows;
+    this->nextWindowIdx = 0;
+}
+
+/**
+ * Populates `window` with the next window of the schedule, if any.
+ *
+ * @param window - Populated with the next window.
+ * @return False once every window has been produced.
+ **/
+bool WalkForwardSchedule::next(BacktestWindow &window)
+{
+    if (nextWindowIdx >= endWindowIdx)
+    {
+        return false;
+    }
+
+    window = getWindow(nextWindowIdx++);
+
+    return true;
+}
+
+/**
+ * Restricts the schedule to the windows of one shard. The windows are
+ * split into `numOfShards` contiguous ranges, identically in every process.
+ *
+ * @param shardIdx - The index of the shard, in [0, numOfShards).
+ * @param numOfShards - The number of shards.
+ **/
+void WalkForwardSchedule::selectShard(int shardIdx, int numOfShards)
+{
+    getShardRange(numOfWindows, shardIdx, numOfShards, firstWindowIdx, endWindowIdx);
+    nextWindowIdx = firstWindowIdx;
+}
+
+/**
+ * Returns the index of the first window of the schedule.
+ *
+ * @return The index of the first window.
+ **/
+int WalkForwardSchedule::getFirstWindowIdx() const
+{
+    return firstWindowIdx;
+}
+
+/**
+ * Returns the index one past the last window of the schedule.
+ *
+ * @return The end index of the windows.
+ **/
+int WalkForwardSchedule::getEndWindowIdx() const
+{
+    return endWindowIdx;
+}
+
+/**
+ * Returns the window with the given index.
+ *
+ * @param windowIdx - The index of the window, in [0, getNumOfWindows()).
+ * @return The window.
+ **/
+BacktestWindow WalkForwardSchedule::getWindow(int windowIdx) const
+{
+    if (windowIdx < 0 || windowIdx >= numOfWindows)
+    {
+        cout << "Window " << windowIdx << " is out of bounds." << endl;
+        exit(EXIT_FAILURE);
+    }
+
+    int offset = windowIdx * stepSize;
+
+    BacktestWindow window;
+    window.windowIdx = windowIdx;
+    window.firstOutOfSampleDay = inSampleSize + offset;
+    window.lastOutOfSampleDay = window.firstOutOfSampleDay + outOfSampleSize - 1;
+    window.lastInSampleDay = scheme == ANCHORED ? inSampleSize - 1 : window.firstOutOfSampleDay - 1;
+    window.firstInSampleDay = scheme == ROLLING ? offset : 0;
+
+    return window;
+}
+
+/**
+ * Returns the number of windows that fit in the data, in every shard.
+ *
+ * @return The number of windows.
+ **/
+int WalkForwardSchedule::getNumOfWindows() const
+{
+    return numOfWindows;
+}
+
+/**
+ * Checks whether every window shares the same in sample period.
+ *
+ * @return True if the model needs to be fitted only once.
+ **/
+bool WalkForwardSchedule::hasFixedInSample() const
+{
+    return scheme == ANCHORED;
+}
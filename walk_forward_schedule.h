@@ -0,0 +1,124 @@
+#ifndef WalkForwardSchedule_h
+#define WalkForwardSchedule_h
+
+#include <iostream>
+#include <stdlib.h>
+#include "utils.h"
+
+using namespace std;
+
+/**
+ * How the in sample period of a walk forward backtest moves between windows.
+ *
+ * ROLLING - A fixed size in sample period that slides forward with the out of sample.
+ * EXPANDING - The in sample period starts on the first day and grows with the out of sample.
+ * ANCHORED - The in sample period is fixed to the first `inSampleSize` days, so the model
+ *            is fitted once and only the out of sample period moves.
+ **/
+enum WalkForwardScheme
+{
+    ROLLING,
+    EXPANDING,
+    ANCHORED
+};
+
+/**
+ * The (inclusive) day ranges of one window of a walk forward backtest.
+ **/
+struct BacktestWindow
+{
+    int windowIdx;
+    int firstInSampleDay;
+    int lastInSampleDay;
+    int firstOutOfSampleDay;
+    int lastOutOfSampleDay;
+};
+
+/**
+ * Generates the windows of a walk forward backtest. The number of windows is
+ * derived from the length of the data, so that no window reads past the last
+ * return, and windows are produced one at a time rather than all up front.
+ **/
+class WalkForwardSchedule
+{
+public:
+    /**
+     * Constructs a schedule.
+     *
+     * @param numOfReturns - The number of returns in the data.
+     * @param inSampleSize - The window size of the insample (the initial size when expanding).
+     * @param outOfSampleSize - The window size of the out of sample.
+     * @param scheme - How the in sample period moves between windows.
+     * @param stepSize - The number of days between consecutive windows.
+     *                   Non-positive values mean `outOfSampleSize`.
+     **/
+    WalkForwardSchedule(int numOfReturns, int inSampleSize, int outOfSampleSize, WalkForwardScheme scheme = ROLLING, int stepSize = 0);
+
+    /**
+     * Populates `window` with the next window of the schedule, if any.
+     *
+     * @param window - Populated with the next window.
+     * @return False once every window has been produced.
+     **/
+    bool next(BacktestWindow &window);
+
+    /**
+     * Restricts the schedule to the windows of one shard. The windows are
+     * split into `numOfShards` contiguous ranges, identically in every process.
+     *
+     * @param shardIdx - The index of the shard, in [0, numOfShards).
+     * @param numOfShards - The number of shards.
+     **/
+    void selectShard(int shardIdx, int numOfShards);
+
+    /**
+     * Returns the index of the first window of the schedule.
+     *
+     * @return The index of the first window.
+     **/
+    int getFirstWindowIdx() const;
+
+    /**
+     * Returns the index one past the last window of the schedule.
+     *
+     * @return The end index of the windows.
+     **/
+    int getEndWindowIdx() const;
+
+    /**
+     * Returns the window with the given index.
+     *
+     * @param windowIdx - The index of the window, in [0, getNumOfWindows()).
+     * @return The window.
+     **/
+    BacktestWindow getWindow(int windowIdx) const;
+
+    /**
+     * Returns the number of windows that fit in the data, in every shard.
+     *
+     * @return The number of windows.
+     **/
+    int getNumOfWindows() const;
+
+    /**
+     * Checks whether every window shares the same in sample period.
+     *
+     * @return True if the model needs to be fitted only once.
+     **/
+    bool hasFixedInSample() const;
+
+private:
+    int numOfReturns;
+    int inSampleSize;
+    int outOfSampleSize;
+    WalkForwardScheme scheme;
+    int stepSize;
+    int numOfWindows;
+
+    // The (half open) range of windows produced by `next`, and the next of them.
+    int firstWindowIdx;
+    int endWindowIdx;
+    int nextWindowIdx;
+};
+
+#endif